@@ -0,0 +1,61 @@
+//! Compare the time taken by each [AssemblyMode] to fill the system matrices of increasingly refined Domains
+//!
+//! run with: cargo run --release --example assembly_modes -- [num_h_refinements] [num_runs]
+//!
+//! The number of threads can be set with the `RAYON_NUM_THREADS` environment variable.
+
+use fem_2d::prelude::*;
+use std::time::{Duration, Instant};
+
+fn main() {
+    let mut args = std::env::args().skip(1);
+    let num_h_refinements: usize = args.next().map_or(3, |arg| arg.parse().unwrap());
+    let num_runs: usize = args.next().map_or(5, |arg| arg.parse().unwrap());
+
+    println!("{} threads", rayon::current_num_threads());
+
+    let mut mesh = Mesh::from_file("./test_input/test_mesh_b.json").unwrap();
+    mesh.global_p_refinement(PRef::from(3, 3));
+
+    for _ in 0..num_h_refinements {
+        mesh.global_h_refinement(HRef::T);
+        let domain = Domain::from_mesh(mesh.clone(), ContinuityCondition::HCurl);
+        let plan = AssemblyPlan::new(&domain);
+
+        println!(
+            "{} Elems, {} DoFs, {} non-zeros, {} colors:",
+            domain.mesh.elems.len(),
+            domain.dofs.len(),
+            plan.pattern().num_entries(),
+            plan.colors().len()
+        );
+
+        for mode in [
+            AssemblyMode::Channel,
+            AssemblyMode::Colored,
+            AssemblyMode::Reduction,
+            AssemblyMode::Batched {
+                memory_budget: 1 << 26,
+            },
+        ] {
+            let mut times: Vec<Duration> = (0..num_runs)
+                .map(|_| {
+                    let start = Instant::now();
+                    galerkin_sample_gep_hcurl_with_plan::<HierPoly, CurlCurl, L2Inner>(
+                        &domain, &plan, None, mode,
+                    )
+                    .unwrap();
+                    start.elapsed()
+                })
+                .collect();
+            times.sort();
+
+            println!(
+                "\t{:<40} min {:>10.2?}  median {:>10.2?}",
+                format!("{:?}", mode),
+                times[0],
+                times[times.len() / 2]
+            );
+        }
+    }
+}
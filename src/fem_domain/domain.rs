@@ -4,6 +4,8 @@ pub mod dof;
 pub mod fields;
 /// The internal geometric structure of a Domain. This is modified by hp-refinements.
 pub mod mesh;
+/// Bandwidth and fill reducing DoF orderings
+pub mod renumbering;
 
 use dof::{
     basis_spec::{BSAddress, BasisDir, BasisLoc, BasisSpec},
@@ -0,0 +1,465 @@
+use super::Domain;
+use rayon::prelude::*;
+
+/// Maximum number of DoFs in a sub-graph that will be ordered directly (rather than dissected further) by [DoFOrdering::NestedDissection]
+const ND_LEAF_SIZE: usize = 64;
+
+/// Maximum number of restarts used when searching for a pseudo-peripheral DoF
+const MAX_PERIPHERAL_SEARCH_ITERS: usize = 8;
+
+/// Strategies for renumbering the DoFs in a [Domain] (see: [Domain::renumber_dofs])
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub enum DoFOrdering {
+    /// Reverse Cuthill–McKee: a breadth-first ordering starting from a pseudo-peripheral DoF. Keeps coupled DoFs close together, reducing the bandwidth and profile of the system matrices
+    ReverseCuthillMcKee,
+    /// Nested Dissection: the DoF graph is recursively split in two by level-set separators, which are ordered after both halves. Reduces fill-in during direct factorization
+    NestedDissection,
+}
+
+/// A permutation of a [Domain]'s DoF IDs
+///
+/// Returned by [Domain::renumber_dofs]. It can be used to map vectors (such as eigenvectors) between the original and the new DoF numbering.
+#[derive(Clone, Debug)]
+pub struct DoFPermutation {
+    new_ids: Vec<usize>,
+    old_ids: Vec<usize>,
+}
+
+impl DoFPermutation {
+    // Construct a permutation from a list of old IDs in their new order
+    fn from_order(old_ids: Vec<usize>) -> Self {
+        let mut new_ids = vec![usize::MAX; old_ids.len()];
+        for (new_id, &old_id) in old_ids.iter().enumerate() {
+            assert!(
+                new_ids[old_id] == usize::MAX,
+                "DoF {} appears twice in the ordering; cannot construct DoFPermutation!",
+                old_id
+            );
+            new_ids[old_id] = new_id;
+        }
+
+        Self { new_ids, old_ids }
+    }
+
+    /// Number of DoFs
+    pub fn len(&self) -> usize {
+        self.new_ids.len()
+    }
+
+    /// Whether the permutation is empty
+    pub fn is_empty(&self) -> bool {
+        self.new_ids.is_empty()
+    }
+
+    /// The new ID of each DoF, indexed by its original ID
+    pub fn new_ids(&self) -> &[usize] {
+        &self.new_ids
+    }
+
+    /// The original ID of each DoF, indexed by its new ID
+    pub fn old_ids(&self) -> &[usize] {
+        &self.old_ids
+    }
+
+    /// Map a vector indexed by the original DoF IDs onto the new DoF IDs
+    pub fn permute_vector(&self, vector: &[f64]) -> Vec<f64> {
+        assert_eq!(
+            vector.len(),
+            self.len(),
+            "Vector length does not match the number of DoFs; cannot permute vector!"
+        );
+        self.old_ids.iter().map(|old_id| vector[*old_id]).collect()
+    }
+
+    /// Map a vector indexed by the new DoF IDs (such as an eigenvector computed over a renumbered `Domain`) back onto the original DoF IDs
+    pub fn unpermute_vector(&self, vector: &[f64]) -> Vec<f64> {
+        assert_eq!(
+            vector.len(),
+            self.len(),
+            "Vector length does not match the number of DoFs; cannot un-permute vector!"
+        );
+        self.new_ids.iter().map(|new_id| vector[*new_id]).collect()
+    }
+}
+
+impl Domain {
+    /// Renumber the Domain's DoFs according to a [DoFOrdering]
+    ///
+    /// The IDs of the `dofs` and the `dof_id`s of all [BasisSpec](super::dof::basis_spec::BasisSpec)s are updated consistently.
+    /// This should be done before any system matrices are constructed from the `Domain`.
+    /// Any [AssemblyPlan](crate::fem_problem::galerkin::assembly_plan::AssemblyPlan) computed beforehand is invalidated (and will be rejected by Galerkin Sampling).
+    ///
+    /// # Returns
+    /// A [DoFPermutation] relating the original and new DoF IDs
+    ///
+    /// # Example
+    /// ```
+    /// use fem_2d::prelude::*;
+    ///
+    /// let mut mesh = Mesh::from_file("./test_input/test_mesh_b.json").unwrap();
+    /// mesh.global_p_refinement(PRef::from(2, 2));
+    /// mesh.global_h_refinement(HRef::T);
+    ///
+    /// let mut domain = Domain::from_mesh(mesh, ContinuityCondition::HCurl);
+    /// let original_bandwidth = domain.dof_bandwidth();
+    ///
+    /// let permutation = domain.renumber_dofs(DoFOrdering::ReverseCuthillMcKee);
+    /// assert!(domain.dof_bandwidth() < original_bandwidth);
+    ///
+    /// // solutions over the renumbered Domain can be mapped back onto the original DoF IDs
+    /// let solution = vec![1.0; domain.dofs.len()];
+    /// let original_solution = permutation.unpermute_vector(&solution);
+    /// ```
+    pub fn renumber_dofs(&mut self, ordering: DoFOrdering) -> DoFPermutation {
+        let order = graph_ordering(&self.dof_adjacency(), ordering);
+        let permutation = DoFPermutation::from_order(order);
+        self.apply_dof_permutation(&permutation);
+        permutation
+    }
+
+    /// The maximum difference between the IDs of any two coupled DoFs (i.e. the bandwidth of the system matrices)
+    pub fn dof_bandwidth(&self) -> usize {
+        self.dof_adjacency()
+            .iter()
+            .enumerate()
+            .flat_map(|(p, adj)| adj.iter().map(move |q| if *q > p { q - p } else { p - q }))
+            .max()
+            .unwrap_or(0)
+    }
+
+    // The DoFs coupled with each DoF (via an Elem's local BasisSpecs or its descendants' BasisSpecs)
+    fn dof_adjacency(&self) -> Vec<Vec<usize>> {
+        let elem_couplings: Vec<(Vec<usize>, Vec<usize>)> = self
+            .mesh
+            .elems
+            .par_iter()
+            .filter(|elem| !self.basis_specs[elem.id].is_empty())
+            .map(|elem| {
+                let local: Vec<usize> = self.basis_specs[elem.id]
+                    .iter()
+                    .map(|bs| bs.dof_id.unwrap())
+                    .collect();
+                let desc: Vec<usize> = self
+                    .mesh
+                    .descendant_elems(elem.id, false)
+                    .unwrap()
+                    .iter()
+                    .flat_map(|desc_id| self.basis_specs[*desc_id].iter())
+                    .map(|bs| bs.dof_id.unwrap())
+                    .collect();
+                (local, desc)
+            })
+            .collect();
+
+        let mut adjacency = vec![Vec::new(); self.dofs.len()];
+        for (local, desc) in elem_couplings.iter() {
+            for &p in local.iter() {
+                for &q in local.iter().chain(desc.iter()) {
+                    if p != q {
+                        adjacency[p].push(q);
+                        adjacency[q].push(p);
+                    }
+                }
+            }
+        }
+
+        adjacency.par_iter_mut().for_each(|adj| {
+            adj.sort_unstable();
+            adj.dedup();
+        });
+        adjacency
+    }
+
+    fn apply_dof_permutation(&mut self, permutation: &DoFPermutation) {
+        for bs in self.basis_specs.iter_mut().flatten() {
+            if let Some(old_id) = bs.dof_id {
+                bs.dof_id = Some(permutation.new_ids[old_id]);
+            }
+        }
+
+        let mut old_dofs: Vec<_> = std::mem::take(&mut self.dofs)
+            .into_iter()
+            .map(Some)
+            .collect();
+        self.dofs = permutation
+            .old_ids
+            .iter()
+            .enumerate()
+            .map(|(new_id, old_id)| {
+                let mut dof = old_dofs[*old_id].take().unwrap();
+                dof.id = new_id;
+                dof
+            })
+            .collect();
+    }
+}
+
+/// Order the vertices of a symmetric adjacency graph (such as the DoF graph, or the graph of a sparse matrix) according to a [DoFOrdering]
+///
+/// Returns the original index of the vertex placed at each position
+pub(crate) fn graph_ordering(adjacency: &[Vec<usize>], ordering: DoFOrdering) -> Vec<usize> {
+    let mut graph = DoFGraph::new(adjacency);
+
+    match ordering {
+        DoFOrdering::ReverseCuthillMcKee => {
+            let all_dofs: Vec<usize> = (0..adjacency.len()).collect();
+            graph.reverse_cuthill_mckee(&all_dofs)
+        }
+        DoFOrdering::NestedDissection => {
+            let mut order = Vec::with_capacity(adjacency.len());
+            graph.nested_dissection((0..adjacency.len()).collect(), &mut order);
+            order
+        }
+    }
+}
+
+// Traversal of the DoF adjacency graph restricted to subsets of DoFs
+struct DoFGraph<'a> {
+    adjacency: &'a [Vec<usize>],
+    // the subset that each DoF currently belongs to
+    subsets: Vec<usize>,
+    next_subset: usize,
+    // breadth-first-search markers
+    visited: Vec<usize>,
+    visit_stamp: usize,
+}
+
+impl<'a> DoFGraph<'a> {
+    fn new(adjacency: &'a [Vec<usize>]) -> Self {
+        Self {
+            adjacency,
+            subsets: vec![0; adjacency.len()],
+            next_subset: 1,
+            visited: vec![0; adjacency.len()],
+            visit_stamp: 0,
+        }
+    }
+
+    fn degree(&self, dof: usize) -> usize {
+        self.adjacency[dof].len()
+    }
+
+    // Breadth-first level sets starting from `start`, restricted to `start`'s subset
+    fn level_sets(&mut self, start: usize) -> Vec<Vec<usize>> {
+        self.visit_stamp += 1;
+        let subset = self.subsets[start];
+        self.visited[start] = self.visit_stamp;
+
+        let mut levels = vec![vec![start]];
+        loop {
+            let mut next_level = Vec::new();
+            for &p in levels.last().unwrap().iter() {
+                for &q in self.adjacency[p].iter() {
+                    if self.subsets[q] == subset && self.visited[q] != self.visit_stamp {
+                        self.visited[q] = self.visit_stamp;
+                        next_level.push(q);
+                    }
+                }
+            }
+
+            if next_level.is_empty() {
+                return levels;
+            }
+            levels.push(next_level);
+        }
+    }
+
+    // Find a DoF whose level structure is (approximately) as deep as possible, along with that level structure
+    fn pseudo_peripheral_dof(&mut self, mut start: usize) -> (usize, Vec<Vec<usize>>) {
+        let mut levels = self.level_sets(start);
+
+        for _ in 0..MAX_PERIPHERAL_SEARCH_ITERS {
+            let candidate = *levels
+                .last()
+                .unwrap()
+                .iter()
+                .min_by_key(|dof| self.degree(**dof))
+                .unwrap();
+            let candidate_levels = self.level_sets(candidate);
+
+            if candidate_levels.len() > levels.len() {
+                start = candidate;
+                levels = candidate_levels;
+            } else {
+                break;
+            }
+        }
+
+        (start, levels)
+    }
+
+    // Reverse Cuthill-McKee ordering of a set of DoFs (all in the same subset)
+    fn reverse_cuthill_mckee(&mut self, dofs: &[usize]) -> Vec<usize> {
+        if dofs.is_empty() {
+            return Vec::new();
+        }
+        let mut seeds = dofs.to_vec();
+        seeds.sort_by_key(|dof| self.degree(*dof));
+
+        let source_subset = self.subsets[dofs[0]];
+        let subset = self.next_subset;
+        self.next_subset += 1;
+        let mut order = Vec::with_capacity(dofs.len());
+
+        // each component is ordered starting from a pseudo-peripheral DoF
+        for seed in seeds {
+            if self.subsets[seed] == subset {
+                continue;
+            }
+            let (start, _) = self.pseudo_peripheral_dof(seed);
+
+            let mut head = order.len();
+            self.subsets[start] = subset;
+            order.push(start);
+
+            while head < order.len() {
+                let p = order[head];
+                head += 1;
+
+                let first_new = order.len();
+                for &q in self.adjacency[p].iter() {
+                    if self.subsets[q] == source_subset {
+                        self.subsets[q] = subset;
+                        order.push(q);
+                    }
+                }
+                order[first_new..].sort_by_key(|dof| self.adjacency[*dof].len());
+            }
+        }
+
+        order.reverse();
+        order
+    }
+
+    // Nested Dissection ordering of a set of DoFs (all in the same subset), appended to `order`
+    fn nested_dissection(&mut self, dofs: Vec<usize>, order: &mut Vec<usize>) {
+        if dofs.len() <= ND_LEAF_SIZE {
+            order.extend(self.reverse_cuthill_mckee(&dofs));
+            return;
+        }
+
+        let start = *dofs.iter().min_by_key(|dof| self.degree(**dof)).unwrap();
+        let (_, mut levels) = self.pseudo_peripheral_dof(start);
+        let num_reached: usize = levels.iter().map(|level| level.len()).sum();
+
+        // disconnected sets are split into the reached component and the remainder
+        if num_reached < dofs.len() {
+            let component: Vec<usize> = levels.drain(0..).flatten().collect();
+            let rest: Vec<usize> = dofs
+                .into_iter()
+                .filter(|dof| self.visited[*dof] != self.visit_stamp)
+                .collect();
+
+            self.split_subset(&component);
+            self.split_subset(&rest);
+            self.nested_dissection(component, order);
+            self.nested_dissection(rest, order);
+            return;
+        }
+
+        if levels.len() < 3 {
+            order.extend(self.reverse_cuthill_mckee(&dofs));
+            return;
+        }
+
+        // the middle level separates the levels above it from the levels below it
+        let mid = levels.len() / 2;
+        let mut part_a: Vec<usize> = levels[0..mid].iter().flatten().copied().collect();
+        let part_b: Vec<usize> = levels[mid + 1..].iter().flatten().copied().collect();
+
+        // separator DoFs that aren't coupled to the lower part can be moved into the upper part
+        self.split_subset(&part_b);
+        let part_b_subset = self.subsets[part_b[0]];
+        let mut separator = Vec::with_capacity(levels[mid].len());
+        for &dof in levels[mid].iter() {
+            if self.adjacency[dof]
+                .iter()
+                .any(|q| self.subsets[*q] == part_b_subset)
+            {
+                separator.push(dof);
+            } else {
+                part_a.push(dof);
+            }
+        }
+
+        self.split_subset(&part_a);
+        self.split_subset(&separator);
+        self.nested_dissection(part_a, order);
+        self.nested_dissection(part_b, order);
+        order.extend(separator);
+    }
+
+    // Move a set of DoFs into a new subset
+    fn split_subset(&mut self, dofs: &[usize]) {
+        for &dof in dofs {
+            self.subsets[dof] = self.next_subset;
+        }
+        self.next_subset += 1;
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::fem_domain::domain::{
+        mesh::{h_refinement::HRef, p_refinement::PRef, Mesh},
+        ContinuityCondition,
+    };
+
+    fn test_domain() -> Domain {
+        let mut mesh = Mesh::from_file("./test_input/test_mesh_b.json").unwrap();
+        mesh.global_p_refinement(PRef::from(2, 2));
+        mesh.global_h_refinement(HRef::T);
+        mesh.global_h_refinement(HRef::T);
+        mesh.h_refine_elems(vec![22, 25, 28], HRef::T).unwrap();
+        Domain::from_mesh(mesh, ContinuityCondition::HCurl)
+    }
+
+    fn assert_consistent(domain: &Domain) {
+        for (id, dof) in domain.dofs.iter().enumerate() {
+            assert_eq!(dof.id, id);
+            for address in dof.get_basis_specs() {
+                assert_eq!(domain.get_basis_spec(address).unwrap().dof_id, Some(dof.id));
+            }
+        }
+    }
+
+    #[test]
+    fn reverse_cuthill_mckee() {
+        let mut domain = test_domain();
+        let original_bandwidth = domain.dof_bandwidth();
+        let original_adjacency = domain.dof_adjacency();
+
+        let permutation = domain.renumber_dofs(DoFOrdering::ReverseCuthillMcKee);
+        assert_consistent(&domain);
+        assert!(domain.dof_bandwidth() < original_bandwidth);
+
+        // the coupling structure is unchanged under the permutation
+        let adjacency = domain.dof_adjacency();
+        for (old_p, adj) in original_adjacency.iter().enumerate() {
+            let mut new_adj: Vec<usize> = adj.iter().map(|q| permutation.new_ids()[*q]).collect();
+            new_adj.sort_unstable();
+            assert_eq!(new_adj, adjacency[permutation.new_ids()[old_p]]);
+        }
+
+        let vector: Vec<f64> = (0..permutation.len()).map(|i| i as f64).collect();
+        assert_eq!(
+            permutation.unpermute_vector(&permutation.permute_vector(&vector)),
+            vector
+        );
+    }
+
+    #[test]
+    fn nested_dissection() {
+        let mut domain = test_domain();
+        let num_dofs = domain.dofs.len();
+        assert!(num_dofs > ND_LEAF_SIZE);
+
+        let permutation = domain.renumber_dofs(DoFOrdering::NestedDissection);
+        assert_consistent(&domain);
+
+        let mut old_ids = permutation.old_ids().to_vec();
+        old_ids.sort_unstable();
+        assert!(old_ids.into_iter().eq(0..num_dofs));
+    }
+}
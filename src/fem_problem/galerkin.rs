@@ -1,10 +1,14 @@
 use super::{
     integration::HierCurlIntegral,
-    linalg::{sparse_matrix::SparseMatrix, GEP},
+    linalg::{
+        coo_matrix::{CooEntries, DropReport, DropTolerance},
+        elem_matrix::ElemMatrix,
+        SlotGroups, GEP,
+    },
 };
 use crate::fem_domain::{
     basis::{BasisFnSampler, HierCurlBasisFn, HierCurlBasisFnSpace},
-    domain::{ContinuityCondition, Domain},
+    domain::{mesh::elem::Elem, ContinuityCondition, Domain},
 };
 use rayon::prelude::*;
 use std::fmt;
@@ -12,10 +16,56 @@ use std::fmt;
 /// Minimum number of Gauss Legendre Quadrature Points Allowed for Galerkin Sampling
 pub const MIN_GLQ_ORDER: usize = 4;
 
+/// Sparsity Patterns and Scatter Maps for repeated Galerkin Sampling over the same `Domain`
+pub mod assembly_plan;
+
+/// On-disk storage of assembled GEPs, keyed by a hash of the Galerkin Sampling inputs
+pub mod gep_cache;
+
+/// Application of the system matrices to vectors without assembling them
+pub mod matrix_free;
+
+/// Assembly of system matrices directly to disk, for problems whose matrices don't fit in memory
+pub mod out_of_core;
+
+/// Mapping of solutions onto refined Domains, for use as initial vectors in iterative solvers
+pub mod prolongation;
+
+use assembly_plan::AssemblyPlan;
+
+/// Strategies for adding the values computed over each `Elem` into the system matrices
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub enum AssemblyMode {
+    /// Values from each `Elem` are sent over a channel and added into the matrices by a single thread
+    ///
+    /// The channel is unbounded, so values can be computed faster than they are added, and any number of them can be buffered at once (see: [AssemblyMode::Batched])
+    Channel,
+    /// `Elem`s are processed one color at a time (see: [AssemblyPlan::colors]). `Elem`s of the same color don't share any DoFs, so their values are added directly into the matrices from many threads without locks
+    Colored,
+    /// The `Elem`s are split into one contiguous chunk per thread, and each chunk adds its values into its own copy of the matrices' storage. The copies are then summed pairwise in a tree
+    ///
+    /// With `P` threads, this holds `P` copies of the `A` and `B` values at once (`2 * P * nnz` floats on top of the matrices themselves)
+    Reduction,
+    /// `Elem`s are processed in consecutive batches. The values from each batch are computed in parallel and added into the matrices before the next batch starts.
+    ///
+    /// Batches are sized such that their [ElemMatrix]s occupy at most `memory_budget` bytes (each batch holds at least one `Elem`),
+    /// so memory usage beyond the matrices themselves stays bounded regardless of the size of the `Domain`.
+    Batched { memory_budget: usize },
+}
+
+impl Default for AssemblyMode {
+    fn default() -> Self {
+        Self::Colored
+    }
+}
+
 /// Fill two system matrices using a [Domain]'s Basis Space as the Testing Space. Return a Generalized Eigenproblem ([GEP])
 ///
 /// All pairs of overlapping Shape Functions will be integrated and stored in the matrices by their associated DoF IDs
 ///
+/// An [AssemblyPlan] (containing the [SparsityPattern](crate::fem_problem::linalg::csr_matrix::SparsityPattern) of the matrices) is computed from the `Domain` before integration, such that values are added into preallocated storage.
+/// When sampling the same `Domain` multiple times, the plan should be computed once and passed to [galerkin_sample_gep_hcurl_with_plan] instead.
+///
 /// Computations are parallelized over the Rayon Global Threadpool
 ///
 /// # Arguments
@@ -38,65 +88,345 @@ pub fn galerkin_sample_gep_hcurl<
     domain: &Domain,
     glq_grid_dim: Option<[usize; 2]>,
 ) -> Result<GEP, GalerkinSamplingError> {
-    // check for errors
-    if domain.cc != ContinuityCondition::HCurl {
-        return Err(GalerkinSamplingError::WrongContinuityCondition(
-            ContinuityCondition::HCurl,
-            domain.cc,
-        ));
-    }
-    if domain.dofs.is_empty() {
-        return Err(GalerkinSamplingError::EmptyDOFSet);
+    check_domain(domain)?;
+    let plan = AssemblyPlan::new(domain);
+    galerkin_sample_gep_hcurl_with_plan::<BSpace, AI, BI>(
+        domain,
+        &plan,
+        glq_grid_dim,
+        AssemblyMode::default(),
+    )
+}
+
+/// Fill two system matrices using a [Domain]'s Basis Space as the Testing Space without computing their [SparsityPattern](crate::fem_problem::linalg::csr_matrix::SparsityPattern) ahead of time. Return a Generalized Eigenproblem ([GEP])
+///
+/// Each thread accumulates the values it computes into its own list of unordered [CooEntries]. The lists are then concatenated, radix sorted, reduced, and converted into compressed-row form.
+/// This avoids the symbolic phase of [galerkin_sample_gep_hcurl] entirely, which is preferable for one-off sampling of a freshly refined `Domain`.
+///
+/// Accepts the same arguments (and returns the same errors) as [galerkin_sample_gep_hcurl]. The resulting matrices are identical.
+pub fn galerkin_sample_gep_hcurl_coo<
+    BSpace: HierCurlBasisFnSpace,
+    AI: HierCurlIntegral,
+    BI: HierCurlIntegral,
+>(
+    domain: &Domain,
+    glq_grid_dim: Option<[usize; 2]>,
+) -> Result<GEP, GalerkinSamplingError> {
+    Ok(sample_coo_entries::<BSpace, AI, BI>(domain, glq_grid_dim, false)?.into_gep())
+}
+
+/// Fill two system matrices using a [Domain]'s Basis Space as the Testing Space, leaving negligible entries out of their [SparsityPattern](crate::fem_problem::linalg::csr_matrix::SparsityPattern). Return a Generalized Eigenproblem ([GEP]) along with a [DropReport]
+///
+/// Integrals that are known to be zero (see: [HierCurlIntegral::is_structurally_zero]) are never computed, and `Elem`-wise contributions that are exactly zero in both matrices are never inserted.
+/// After summation, off-diagonal entries that are negligible in both matrices according to the `tolerance` are dropped before the matrices are compressed.
+///
+/// Otherwise, this behaves like [galerkin_sample_gep_hcurl_coo]. With the default [DropTolerance], only entries that are exactly zero are omitted, so the resulting matrices act identically on any vector.
+pub fn galerkin_sample_gep_hcurl_pruned<
+    BSpace: HierCurlBasisFnSpace,
+    AI: HierCurlIntegral,
+    BI: HierCurlIntegral,
+>(
+    domain: &Domain,
+    glq_grid_dim: Option<[usize; 2]>,
+    tolerance: DropTolerance,
+) -> Result<(GEP, DropReport), GalerkinSamplingError> {
+    Ok(
+        sample_coo_entries::<BSpace, AI, BI>(domain, glq_grid_dim, true)?
+            .into_gep_pruned(tolerance),
+    )
+}
+
+// Compute the values over each Elem in parallel, accumulating them into unordered CooEntries. Optionally skip entries that are zero in both matrices.
+fn sample_coo_entries<BSpace, AI, BI>(
+    domain: &Domain,
+    glq_grid_dim: Option<[usize; 2]>,
+    skip_zeros: bool,
+) -> Result<CooEntries, GalerkinSamplingError>
+where
+    BSpace: HierCurlBasisFnSpace,
+    AI: HierCurlIntegral,
+    BI: HierCurlIntegral,
+{
+    check_domain(domain)?;
+    let (bs_sampler, a_integrator, b_integrator) =
+        setup_integration::<BSpace, AI, BI>(domain, glq_grid_dim)?;
+    let elem_descendants = assembly_plan::elem_descendants(domain);
+    let num_dofs = domain.dofs.len();
+
+    let thread_entries: Vec<CooEntries> = domain
+        .mesh
+        .elems
+        .par_iter()
+        .fold(
+            || {
+                (
+                    bs_sampler.clone(),
+                    [ElemMatrix::default(), ElemMatrix::default()],
+                    CooEntries::new(num_dofs),
+                )
+            },
+            |(mut bf_sampler_elem, mut elem_matrices, mut entries), elem| {
+                let [a_matrix, b_matrix] = &mut elem_matrices;
+                sample_elem(
+                    domain,
+                    &elem_descendants[elem.id],
+                    elem,
+                    &mut bf_sampler_elem,
+                    &a_integrator,
+                    &b_integrator,
+                    [Some(a_matrix), Some(b_matrix)],
+                );
+                if skip_zeros {
+                    entries.push_elem_matrices_nonzero(a_matrix, b_matrix);
+                } else {
+                    entries.push_elem_matrices(a_matrix, b_matrix);
+                }
+
+                (bf_sampler_elem, elem_matrices, entries)
+            },
+        )
+        .map(|(_, _, entries)| entries)
+        .collect();
+
+    Ok(CooEntries::concat(thread_entries))
+}
+
+/// Fill two system matrices using a [Domain]'s Basis Space as the Testing Space and a precomputed [AssemblyPlan]. Return a Generalized Eigenproblem ([GEP])
+///
+/// This is the numeric phase of [galerkin_sample_gep_hcurl]. No index structures are computed here; values are integrated over each `Elem` and scattered directly into the storage slots given by the `plan`.
+///
+/// # Arguments
+/// * `domain`: The [Domain] over which the Galerkin Sampling is to be performed
+/// * `plan`: An [AssemblyPlan] computed from the same `domain`
+/// * `glq_grid_dim`: The number of Gauss Legendre Quadrature Points in to use for integration along each direction. If `None`, the default values are used.
+/// * `mode`: The [AssemblyMode] used to add values into the matrices
+/// * Generic Arguments: `BSpace`, `AI`, and `BI` (see: [galerkin_sample_gep_hcurl])
+///
+/// # Returns
+/// * An `Err` if the `Domain` was not constructed with an `H(Curl)` [ContinuityCondition]
+/// * An `Err` if the `Domain` doesn't have any Degrees of Freedom
+/// * An `Err` if the `plan` was not computed from a `Domain` with the same dimensions
+/// * An `Err` if the specified number of Gauss Legendre Points is too small
+/// * A [GEP], otherwise
+///
+pub fn galerkin_sample_gep_hcurl_with_plan<
+    BSpace: HierCurlBasisFnSpace,
+    AI: HierCurlIntegral,
+    BI: HierCurlIntegral,
+>(
+    domain: &Domain,
+    plan: &AssemblyPlan,
+    glq_grid_dim: Option<[usize; 2]>,
+    mode: AssemblyMode,
+) -> Result<GEP, GalerkinSamplingError> {
+    check_domain(domain)?;
+    if !plan.matches(domain) {
+        return Err(GalerkinSamplingError::MismatchedPlan);
     }
-    let [num_glq_u, num_glq_v] = match glq_grid_dim {
-        Some([u_dim, v_dim]) => {
-            if u_dim < MIN_GLQ_ORDER || v_dim < MIN_GLQ_ORDER {
-                return Err(GalerkinSamplingError::InvalidGLQSettings);
-            }
-            [Some(u_dim), Some(v_dim)]
+    let (bs_sampler, a_integrator, b_integrator) =
+        setup_integration::<BSpace, AI, BI>(domain, glq_grid_dim)?;
+
+    // construct an eigenproblem with a and b matrices
+    let mut gep = GEP::new(plan.shared_pattern());
+
+    let elem_slot_groups = |bf_sampler_elem: &mut BasisFnSampler<HierCurlBasisFn<BSpace>>,
+                            elem: &Elem| {
+        let mut elem_matrices = [ElemMatrix::default(), ElemMatrix::default()];
+        let [a_matrix, b_matrix] = &mut elem_matrices;
+        sample_elem(
+            domain,
+            plan.descendants(elem.id),
+            elem,
+            bf_sampler_elem,
+            &a_integrator,
+            &b_integrator,
+            [Some(a_matrix), Some(b_matrix)],
+        );
+
+        SlotGroups {
+            slots: plan.elem_slots(elem.id),
+            matrices: elem_matrices,
         }
-        None => [None; 2],
     };
 
-    // construct an eigenproblem with a and b matrices
-    let mut gep = GEP::new(domain.dofs.len());
+    match mode {
+        AssemblyMode::Channel => {
+            gep.par_extend(
+                domain
+                    .mesh
+                    .elems
+                    .par_iter()
+                    .map_with(bs_sampler.clone(), elem_slot_groups),
+            );
+        }
+        AssemblyMode::Batched { memory_budget } => {
+            for batch in elem_batches(domain, plan, memory_budget) {
+                let batch_slot_groups: Vec<SlotGroups> = domain.mesh.elems[batch]
+                    .par_iter()
+                    .map_with(bs_sampler.clone(), elem_slot_groups)
+                    .collect();
 
-    // construct basis sampler
-    let [i_max, j_max] = domain.mesh.max_expansion_orders();
-    let (bs_sampler, [u_weights, v_weights]): (BasisFnSampler<HierCurlBasisFn<BSpace>>, _) =
-        BasisFnSampler::with(i_max as usize, j_max as usize, num_glq_u, num_glq_v, false);
+                for slot_groups in batch_slot_groups.iter() {
+                    gep.scatter_to_slots(&slot_groups.matrices, slot_groups.slots);
+                }
+            }
+        }
+        AssemblyMode::Colored => {
+            let a_slots = gep.a.shared_slots();
+            let b_slots = gep.b.shared_slots();
 
-    // setup integration
-    let a_integrator = AI::with_weights(&u_weights, &v_weights);
-    let b_integrator = BI::with_weights(&u_weights, &v_weights);
+            for color in plan.colors() {
+                color.par_iter().for_each_with(
+                    (
+                        bs_sampler.clone(),
+                        [ElemMatrix::default(), ElemMatrix::default()],
+                    ),
+                    |(bf_sampler_elem, elem_matrices), &elem_id| {
+                        let [a_matrix, b_matrix] = elem_matrices;
+                        sample_elem(
+                            domain,
+                            plan.descendants(elem_id),
+                            &domain.mesh.elems[elem_id],
+                            bf_sampler_elem,
+                            &a_integrator,
+                            &b_integrator,
+                            [Some(&mut *a_matrix), Some(&mut *b_matrix)],
+                        );
+
+                        let elem_slots = plan.elem_slots(elem_id);
+                        let [a_matrix, b_matrix] = &elem_matrices;
+                        for (&slot, (a, b)) in elem_slots
+                            .iter()
+                            .zip(a_matrix.upper_values().zip(b_matrix.upper_values()))
+                        {
+                            // Safety: Elems of the same color never share a DoF, so no other thread can be adding to this slot
+                            unsafe {
+                                a_slots.add_to_slot(slot, a);
+                                b_slots.add_to_slot(slot, b);
+                            }
+                        }
+                    },
+                );
+            }
+        }
+        AssemblyMode::Reduction => {
+            let num_slots = plan.pattern().num_upper_entries();
+
+            // one contiguous chunk of Elems (and one pair of accumulators) per thread
+            let num_threads = rayon::current_num_threads().max(1);
+            let chunk_size = ((domain.mesh.elems.len() + num_threads - 1) / num_threads).max(1);
+
+            let summed_values = domain
+                .mesh
+                .elems
+                .par_chunks(chunk_size)
+                .map_with(
+                    (
+                        bs_sampler.clone(),
+                        [ElemMatrix::default(), ElemMatrix::default()],
+                    ),
+                    |(bf_sampler_elem, elem_matrices), elems| {
+                        let mut a_values = vec![0.0; num_slots];
+                        let mut b_values = vec![0.0; num_slots];
+
+                        for elem in elems {
+                            let [a_matrix, b_matrix] = elem_matrices;
+                            sample_elem(
+                                domain,
+                                plan.descendants(elem.id),
+                                elem,
+                                bf_sampler_elem,
+                                &a_integrator,
+                                &b_integrator,
+                                [Some(&mut *a_matrix), Some(&mut *b_matrix)],
+                            );
+
+                            let elem_slots = plan.elem_slots(elem.id);
+                            let [a_matrix, b_matrix] = &*elem_matrices;
+                            for (&slot, (a, b)) in elem_slots
+                                .iter()
+                                .zip(a_matrix.upper_values().zip(b_matrix.upper_values()))
+                            {
+                                a_values[slot] += a;
+                                b_values[slot] += b;
+                            }
+                        }
 
-    gep.par_extend(domain.mesh.elems.par_iter().map(|elem| {
-        let mut local_a = SparseMatrix::new(domain.dofs.len());
-        let mut local_b = SparseMatrix::new(domain.dofs.len());
+                        [a_values, b_values]
+                    },
+                )
+                .reduce_with(|[mut a_x, mut b_x], [a_y, b_y]| {
+                    add_values(&mut a_x, &a_y);
+                    add_values(&mut b_x, &b_y);
+                    [a_x, b_x]
+                });
 
-        let mut bf_sampler_elem = bs_sampler.clone();
-        let elem_materials = elem.get_materials();
+            if let Some([a_values, b_values]) = summed_values {
+                gep.a.values_mut().copy_from_slice(&a_values);
+                gep.b.values_mut().copy_from_slice(&b_values);
+            }
+        }
+    }
+
+    Ok(gep)
+}
+
+// Integrate all overlapping pairs of BasisSpecs associated with an Elem into a pair of ElemMatrices (A and B)
+//
+// The matrices are reset over the Elem's local DoFs and the DoFs on `desc_elem_ids`. If either matrix is `None`, its integrals are skipped.
+fn sample_elem<BSpace, AI, BI>(
+    domain: &Domain,
+    desc_elem_ids: &[usize],
+    elem: &Elem,
+    bf_sampler: &mut BasisFnSampler<HierCurlBasisFn<BSpace>>,
+    a_integrator: &AI,
+    b_integrator: &BI,
+    [mut a_matrix, mut b_matrix]: [Option<&mut ElemMatrix>; 2],
+) where
+    BSpace: HierCurlBasisFnSpace,
+    AI: HierCurlIntegral,
+    BI: HierCurlIntegral,
+{
+    let elem_materials = elem.get_materials();
+
+    // get relevant data for this Elem
+    let local_basis_specs = &domain.basis_specs[elem.id];
+
+    for elem_matrix in [a_matrix.as_deref_mut(), b_matrix.as_deref_mut()]
+        .into_iter()
+        .flatten()
+    {
+        elem_matrix.reset(
+            local_basis_specs.iter().map(|bs| bs.dof_id.unwrap()),
+            desc_elem_ids
+                .iter()
+                .flat_map(|desc_id| domain.basis_specs[*desc_id].iter())
+                .map(|bs| bs.dof_id.unwrap()),
+        );
+    }
+    if local_basis_specs.is_empty() {
+        return;
+    }
 
-        // get relevant data for this Elem
-        let bs_local = bf_sampler_elem.sample_basis_fn(elem, None);
-        let local_basis_specs = domain.local_basis_specs(elem.id).unwrap();
-        let desc_basis_specs = domain.descendant_basis_specs(elem.id).unwrap();
+    let bs_local = bf_sampler.sample_basis_fn(elem, None);
 
-        let mut local_a_entries: Vec<([usize; 2], f64)> =
-            Vec::with_capacity(local_basis_specs.len() * local_basis_specs.len() / 2);
-        let mut local_b_entries: Vec<([usize; 2], f64)> =
-            Vec::with_capacity(local_basis_specs.len() * local_basis_specs.len() / 2);
+    // Note: integrals that are structurally zero are skipped (leaving the zeros set by `reset`)
 
-        // local - local
-        for (i, (p_orders, p_dir, p_dof_id)) in local_basis_specs
+    // local - local
+    for (i, (p_orders, p_dir, _)) in local_basis_specs
+        .iter()
+        .map(|bs_p| bs_p.integration_data())
+        .enumerate()
+    {
+        for (j, (q_orders, q_dir, _)) in local_basis_specs
             .iter()
-            .map(|bs_p| bs_p.integration_data())
+            .map(|bs_q| bs_q.integration_data())
             .enumerate()
+            .skip(i)
         {
-            for (q_orders, q_dir, q_dof_id) in local_basis_specs
-                .iter()
-                .skip(i)
-                .map(|bs_q| bs_q.integration_data())
+            if let Some(a_matrix) = a_matrix
+                .as_deref_mut()
+                .filter(|_| !a_integrator.is_structurally_zero(p_dir, q_dir))
             {
                 let a = a_integrator
                     .integrate(
@@ -109,6 +439,12 @@ pub fn galerkin_sample_gep_hcurl<
                         elem_materials,
                     )
                     .full_solution();
+                a_matrix.set_symmetric([i, j], a);
+            }
+            if let Some(b_matrix) = b_matrix
+                .as_deref_mut()
+                .filter(|_| !b_integrator.is_structurally_zero(p_dir, q_dir))
+            {
                 let b = b_integrator
                     .integrate(
                         p_dir,
@@ -120,33 +456,30 @@ pub fn galerkin_sample_gep_hcurl<
                         elem_materials,
                     )
                     .full_solution();
-
-                local_a_entries.push(([p_dof_id, q_dof_id], a));
-                local_b_entries.push(([p_dof_id, q_dof_id], b));
+                b_matrix.set_symmetric([i, j], b);
             }
         }
+    }
 
-        local_a.insert_group(local_a_entries);
-        local_b.insert_group(local_b_entries);
-
-        let mut desc_a_entries: Vec<([usize; 2], f64)> =
-            Vec::with_capacity(local_basis_specs.len() * desc_basis_specs.len());
-        let mut desc_b_entries: Vec<([usize; 2], f64)> =
-            Vec::with_capacity(local_basis_specs.len() * desc_basis_specs.len());
+    // local - desc
+    let mut col_offset = local_basis_specs.len();
+    for &q_elem_id in desc_elem_ids {
+        let bs_p_sampled = bf_sampler.sample_basis_fn(elem, Some(&domain.mesh.elems[q_elem_id]));
+        let bs_q_local = bf_sampler.sample_basis_fn(&domain.mesh.elems[q_elem_id], None);
 
-        // local - desc
-        for (p_orders, p_dir, p_dof_id) in
-            local_basis_specs.iter().map(|bs_p| bs_p.integration_data())
+        for (i, (p_orders, p_dir, _)) in local_basis_specs
+            .iter()
+            .map(|bs_p| bs_p.integration_data())
+            .enumerate()
         {
-            for &(q_elem_id, q_elem_basis_specs) in desc_basis_specs.iter() {
-                let bs_p_sampled =
-                    bf_sampler_elem.sample_basis_fn(elem, Some(&domain.mesh.elems[q_elem_id]));
-                let bs_q_local =
-                    bf_sampler_elem.sample_basis_fn(&domain.mesh.elems[q_elem_id], None);
-
-                for (q_orders, q_dir, q_dof_id) in q_elem_basis_specs
-                    .iter()
-                    .map(|bs_q| bs_q.integration_data())
+            for (j, (q_orders, q_dir, _)) in domain.basis_specs[q_elem_id]
+                .iter()
+                .map(|bs_q| bs_q.integration_data())
+                .enumerate()
+            {
+                if let Some(a_matrix) = a_matrix
+                    .as_deref_mut()
+                    .filter(|_| !a_integrator.is_structurally_zero(p_dir, q_dir))
                 {
                     let a = a_integrator
                         .integrate(
@@ -159,6 +492,12 @@ pub fn galerkin_sample_gep_hcurl<
                             elem_materials,
                         )
                         .full_solution();
+                    a_matrix.set([i, col_offset + j], a);
+                }
+                if let Some(b_matrix) = b_matrix
+                    .as_deref_mut()
+                    .filter(|_| !b_integrator.is_structurally_zero(p_dir, q_dir))
+                {
                     let b = b_integrator
                         .integrate(
                             p_dir,
@@ -170,20 +509,111 @@ pub fn galerkin_sample_gep_hcurl<
                             elem_materials,
                         )
                         .full_solution();
-
-                    desc_a_entries.push(([p_dof_id, q_dof_id], a));
-                    desc_b_entries.push(([p_dof_id, q_dof_id], b));
+                    b_matrix.set([i, col_offset + j], b);
                 }
             }
         }
 
-        local_a.insert_group(desc_a_entries);
-        local_b.insert_group(desc_b_entries);
+        col_offset += domain.basis_specs[q_elem_id].len();
+    }
+}
 
-        [local_a, local_b]
-    }));
+// Construct a BasisFnSampler and a pair of integrators with matching quadrature settings
+fn setup_integration<BSpace, AI, BI>(
+    domain: &Domain,
+    glq_grid_dim: Option<[usize; 2]>,
+) -> Result<(BasisFnSampler<HierCurlBasisFn<BSpace>>, AI, BI), GalerkinSamplingError>
+where
+    BSpace: HierCurlBasisFnSpace,
+    AI: HierCurlIntegral,
+    BI: HierCurlIntegral,
+{
+    let [num_glq_u, num_glq_v] = parse_glq_grid_dim(glq_grid_dim)?;
 
-    Ok(gep)
+    // construct basis sampler
+    let [i_max, j_max] = domain.mesh.max_expansion_orders();
+    let (bs_sampler, [u_weights, v_weights]) =
+        BasisFnSampler::with(i_max as usize, j_max as usize, num_glq_u, num_glq_v, false);
+
+    // setup integration
+    let a_integrator = AI::with_weights(&u_weights, &v_weights);
+    let b_integrator = BI::with_weights(&u_weights, &v_weights);
+
+    Ok((bs_sampler, a_integrator, b_integrator))
+}
+
+// Split the Elems into contiguous batches, such that the pair of ElemMatrices computed over each batch occupies at most `memory_budget` bytes
+// Every batch contains at least one Elem
+fn elem_batches(
+    domain: &Domain,
+    plan: &AssemblyPlan,
+    memory_budget: usize,
+) -> Vec<std::ops::Range<usize>> {
+    let elem_matrix_bytes = |elem_id: usize| {
+        let num_rows = domain.basis_specs[elem_id].len();
+        let num_cols = num_rows
+            + plan
+                .descendants(elem_id)
+                .iter()
+                .map(|desc_id| domain.basis_specs[*desc_id].len())
+                .sum::<usize>();
+        let one_matrix = std::mem::size_of::<ElemMatrix>()
+            + num_cols * std::mem::size_of::<usize>()
+            + num_rows * num_cols * std::mem::size_of::<f64>();
+        2 * one_matrix
+    };
+
+    let mut batches = Vec::new();
+    let mut batch_start = 0;
+    let mut batch_bytes = 0;
+    for elem_id in 0..domain.mesh.elems.len() {
+        let bytes = elem_matrix_bytes(elem_id);
+        if batch_bytes + bytes > memory_budget && elem_id > batch_start {
+            batches.push(batch_start..elem_id);
+            batch_start = elem_id;
+            batch_bytes = 0;
+        }
+        batch_bytes += bytes;
+    }
+    if batch_start < domain.mesh.elems.len() {
+        batches.push(batch_start..domain.mesh.elems.len());
+    }
+    batches
+}
+
+// Element-wise addition of two equally sized value arrays
+fn add_values(into: &mut [f64], from: &[f64]) {
+    into.par_iter_mut()
+        .zip(from.par_iter())
+        .for_each(|(x, y)| *x += y);
+}
+
+fn check_domain(domain: &Domain) -> Result<(), GalerkinSamplingError> {
+    if domain.cc != ContinuityCondition::HCurl {
+        return Err(GalerkinSamplingError::WrongContinuityCondition(
+            ContinuityCondition::HCurl,
+            domain.cc,
+        ));
+    }
+    if domain.dofs.is_empty() {
+        return Err(GalerkinSamplingError::EmptyDOFSet);
+    }
+    Ok(())
+}
+
+fn parse_glq_grid_dim(
+    glq_grid_dim: Option<[usize; 2]>,
+) -> Result<[Option<usize>; 2], GalerkinSamplingError> {
+    match glq_grid_dim {
+        Some([u_dim, v_dim]) => {
+            if u_dim < MIN_GLQ_ORDER || v_dim < MIN_GLQ_ORDER {
+                Err(GalerkinSamplingError::InvalidGLQSettings)
+            } else {
+                Ok([Some(u_dim), Some(v_dim)])
+            }
+        }
+        None => Ok([None; 2]),
+    }
 }
 
 /// Error Type for Galerkin Sampling Functions
@@ -192,6 +622,7 @@ pub enum GalerkinSamplingError {
     WrongContinuityCondition(ContinuityCondition, ContinuityCondition),
     EmptyDOFSet,
     InvalidGLQSettings,
+    MismatchedPlan,
 }
 
 impl std::error::Error for GalerkinSamplingError {}
@@ -209,6 +640,207 @@ impl fmt::Display for GalerkinSamplingError {
             Self::InvalidGLQSettings => {
                 write!(f, "Invalid GLQ Settings (the number of GLQ points must be at least {}); Cannot execute Galerkin Sampling!", MIN_GLQ_ORDER)
             }
+            Self::MismatchedPlan => write!(
+                f,
+                "AssemblyPlan does not match the Domain; Cannot execute Galerkin Sampling!"
+            ),
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::fem_domain::basis::hierarchical_basis_fns::poly::HierPoly;
+    use crate::fem_domain::domain::mesh::{h_refinement::HRef, p_refinement::PRef, Mesh};
+    use crate::fem_domain::domain::renumbering::DoFOrdering;
+    use crate::fem_problem::integration::integrals::{curl_curl::CurlCurl, inner::L2Inner};
+
+    fn test_domain() -> Domain {
+        let mut mesh = Mesh::from_file("./test_input/test_mesh_b.json").unwrap();
+        mesh.global_p_refinement(PRef::from(2, 2));
+        mesh.global_h_refinement(HRef::T);
+        mesh.h_refine_elems(vec![6, 9, 12], HRef::T).unwrap();
+        Domain::from_mesh(mesh, ContinuityCondition::HCurl)
+    }
+
+    #[test]
+    fn reuse_assembly_plan() {
+        let domain = test_domain();
+        let plan = AssemblyPlan::new(&domain);
+
+        let gep = galerkin_sample_gep_hcurl::<HierPoly, CurlCurl, L2Inner>(&domain, Some([8, 8]))
+            .unwrap();
+
+        for _ in 0..2 {
+            let gep_planned = galerkin_sample_gep_hcurl_with_plan::<HierPoly, CurlCurl, L2Inner>(
+                &domain,
+                &plan,
+                Some([8, 8]),
+                AssemblyMode::default(),
+            )
+            .unwrap();
+
+            // the A and B matrices (from every pass) share the plan's SparsityPattern
+            assert!(gep_planned.a.shares_pattern_with(&gep_planned.b));
+            assert!(std::sync::Arc::ptr_eq(
+                &gep_planned.a.shared_pattern(),
+                &plan.shared_pattern()
+            ));
+
+            for (x, y) in gep.a.values().iter().zip(gep_planned.a.values()) {
+                assert!((x - y).abs() < 1e-12);
+            }
+            for (x, y) in gep.b.values().iter().zip(gep_planned.b.values()) {
+                assert!((x - y).abs() < 1e-12);
+            }
+        }
+
+        // the same plan can be used with different quadrature settings
+        galerkin_sample_gep_hcurl_with_plan::<HierPoly, L2Inner, L2Inner>(
+            &domain,
+            &plan,
+            None,
+            AssemblyMode::default(),
+        )
+        .unwrap();
+    }
+
+    #[test]
+    fn assembly_modes() {
+        let domain = test_domain();
+        let plan = AssemblyPlan::new(&domain);
+        assert!(plan.colors().len() > 1);
+
+        let [gep_channel, gep_colored, gep_reduction, gep_batched] = [
+            AssemblyMode::Channel,
+            AssemblyMode::Colored,
+            AssemblyMode::Reduction,
+            AssemblyMode::Batched {
+                memory_budget: 1 << 16,
+            },
+        ]
+        .map(|mode| {
+            galerkin_sample_gep_hcurl_with_plan::<HierPoly, CurlCurl, L2Inner>(
+                &domain,
+                &plan,
+                Some([8, 8]),
+                mode,
+            )
+            .unwrap()
+        });
+
+        assert!(elem_batches(&domain, &plan, 1 << 16).len() > 1);
+        assert_eq!(
+            elem_batches(&domain, &plan, 0).len(),
+            domain.mesh.elems.len()
+        );
+
+        for gep in [gep_colored, gep_reduction, gep_batched] {
+            for (x, y) in gep_channel.a.values().iter().zip(gep.a.values()) {
+                assert!((x - y).abs() < 1e-12);
+            }
+            for (x, y) in gep_channel.b.values().iter().zip(gep.b.values()) {
+                assert!((x - y).abs() < 1e-12);
+            }
+        }
+    }
+
+    #[test]
+    fn coo_assembly() {
+        let domain = test_domain();
+
+        let gep = galerkin_sample_gep_hcurl::<HierPoly, CurlCurl, L2Inner>(&domain, Some([8, 8]))
+            .unwrap();
+        let gep_coo =
+            galerkin_sample_gep_hcurl_coo::<HierPoly, CurlCurl, L2Inner>(&domain, Some([8, 8]))
+                .unwrap();
+
+        assert_eq!(gep.pattern(), gep_coo.pattern());
+        assert!(gep_coo.a.shares_pattern_with(&gep_coo.b));
+        for (x, y) in gep.a.values().iter().zip(gep_coo.a.values()) {
+            assert!((x - y).abs() < 1e-12);
+        }
+        for (x, y) in gep.b.values().iter().zip(gep_coo.b.values()) {
+            assert!((x - y).abs() < 1e-12);
+        }
+    }
+
+    #[test]
+    fn pruned_assembly() {
+        let domain = test_domain();
+
+        let gep = galerkin_sample_gep_hcurl::<HierPoly, CurlCurl, L2Inner>(&domain, Some([8, 8]))
+            .unwrap();
+        let (gep_exact, report_exact) = galerkin_sample_gep_hcurl_pruned::<
+            HierPoly,
+            CurlCurl,
+            L2Inner,
+        >(&domain, Some([8, 8]), DropTolerance::default())
+        .unwrap();
+        let (gep_pruned, report_pruned) =
+            galerkin_sample_gep_hcurl_pruned::<HierPoly, CurlCurl, L2Inner>(
+                &domain,
+                Some([8, 8]),
+                DropTolerance::relative(1e-3),
+            )
+            .unwrap();
+
+        assert!(report_exact.skipped_zeros + report_exact.below_tolerance > 0);
+        assert_eq!(
+            report_exact.retained,
+            gep_exact.pattern().num_upper_entries()
+        );
+        assert_eq!(
+            report_pruned.retained,
+            gep_pruned.pattern().num_upper_entries()
+        );
+        assert!(report_pruned.retained < report_exact.retained);
+
+        // dropping exact zeros doesn't change the action of the matrices
+        let x: Vec<f64> = (0..gep.dimension())
+            .map(|i| ((i * 7) % 13) as f64 - 6.0)
+            .collect();
+        let [ax, bx] = gep.mul_vec(&x);
+        let [ax_exact, bx_exact] = gep_exact.mul_vec(&x);
+        for (expected, computed) in [(&ax, &ax_exact), (&bx, &bx_exact)] {
+            for (e, c) in expected.iter().zip(computed.iter()) {
+                assert!((e - c).abs() < 1e-10 * (1.0 + e.abs()));
+            }
         }
     }
+
+    #[test]
+    fn mismatched_assembly_plan() {
+        let domain = test_domain();
+        let plan = AssemblyPlan::new(&Domain::unit(ContinuityCondition::HCurl));
+
+        assert!(matches!(
+            galerkin_sample_gep_hcurl_with_plan::<HierPoly, CurlCurl, L2Inner>(
+                &domain,
+                &plan,
+                Some([8, 8]),
+                AssemblyMode::default()
+            ),
+            Err(GalerkinSamplingError::MismatchedPlan)
+        ));
+    }
+
+    #[test]
+    fn renumbering_invalidates_assembly_plan() {
+        let mut domain = test_domain();
+        let plan = AssemblyPlan::new(&domain);
+        domain.renumber_dofs(DoFOrdering::ReverseCuthillMcKee);
+
+        assert!(matches!(
+            galerkin_sample_gep_hcurl_with_plan::<HierPoly, CurlCurl, L2Inner>(
+                &domain,
+                &plan,
+                Some([8, 8]),
+                AssemblyMode::default()
+            ),
+            Err(GalerkinSamplingError::MismatchedPlan)
+        ));
+        assert!(AssemblyPlan::new(&domain).matches(&domain));
+    }
 }
@@ -0,0 +1,334 @@
+use super::gep_cache::Fnv1a;
+use crate::fem_domain::domain::Domain;
+use crate::fem_problem::linalg::csr_matrix::SparsityPattern;
+use rayon::prelude::*;
+use std::sync::Arc;
+
+/// The symbolic phase of Galerkin Sampling over a [Domain]
+///
+/// This struct holds all of the index information needed to fill a pair of system matrices:
+/// * The global [SparsityPattern] of the matrices
+/// * The IDs of each `Elem`'s descendants (with [BasisSpec](crate::fem_domain::domain::dof::basis_spec::BasisSpec)s)
+/// * A scatter map: the storage slot of each value computed over each `Elem`
+/// * A coloring of the `Elem`s, such that no two `Elem`s of the same color contribute to any of the same DoFs (including the DoFs on their descendants)
+///
+/// A plan can be computed once and reused for any number of numeric passes over the same `Domain` (with different Integrals, materials, or quadrature settings)
+/// via [galerkin_sample_gep_hcurl_with_plan](super::galerkin_sample_gep_hcurl_with_plan). Renumbering the `Domain`'s DoFs invalidates the plan.
+///
+/// The values over each `Elem` are computed into an [ElemMatrix](crate::fem_problem::linalg::elem_matrix::ElemMatrix) whose rows are the `Elem`'s local DoFs,
+/// and whose columns are the local DoFs followed by the DoFs on each descendant `Elem` (in the order given by [AssemblyPlan::descendants]).
+/// The slots are listed in the order of [ElemMatrix::upper_values](crate::fem_problem::linalg::elem_matrix::ElemMatrix::upper_values)
+pub struct AssemblyPlan {
+    pattern: Arc<SparsityPattern>,
+    num_elems: usize,
+    numbering: u64,
+    desc_offsets: Vec<usize>,
+    desc_elem_ids: Vec<usize>,
+    slot_offsets: Vec<usize>,
+    slots: Vec<usize>,
+    colors: Vec<Vec<usize>>,
+}
+
+impl AssemblyPlan {
+    /// Compute the [SparsityPattern] and scatter map for a [Domain]
+    pub fn new(domain: &Domain) -> Self {
+        let pattern = SparsityPattern::from_domain(domain);
+
+        let elem_descendants = elem_descendants(domain);
+
+        let elem_slots: Vec<Vec<usize>> = domain
+            .basis_specs
+            .par_iter()
+            .zip(elem_descendants.par_iter())
+            .map(|(local_bs, desc_ids)| {
+                let num_desc_bs: usize = desc_ids
+                    .iter()
+                    .map(|desc_id| domain.basis_specs[*desc_id].len())
+                    .sum();
+                let mut slots = Vec::with_capacity(
+                    local_bs.len() * (local_bs.len() + 1) / 2 + local_bs.len() * num_desc_bs,
+                );
+                let slot_of = |p: usize, q: usize| {
+                    pattern
+                        .slot([p, q])
+                        .expect("DoF pair is missing from the SparsityPattern; cannot construct AssemblyPlan!")
+                };
+
+                // each local row: local columns from the diagonal onward, then all descendant columns
+                for (i, bs_p) in local_bs.iter().enumerate() {
+                    let p = bs_p.dof_id.unwrap();
+                    for bs_q in local_bs.iter().skip(i) {
+                        slots.push(slot_of(p, bs_q.dof_id.unwrap()));
+                    }
+                    for desc_id in desc_ids.iter() {
+                        for bs_q in domain.basis_specs[*desc_id].iter() {
+                            slots.push(slot_of(p, bs_q.dof_id.unwrap()));
+                        }
+                    }
+                }
+
+                slots
+            })
+            .collect();
+
+        let colors = color_elems(domain, &elem_descendants);
+
+        let (desc_offsets, desc_elem_ids) = flatten(elem_descendants);
+        let (slot_offsets, slots) = flatten(elem_slots);
+
+        Self {
+            pattern: Arc::new(pattern),
+            num_elems: domain.mesh.elems.len(),
+            numbering: dof_numbering(domain),
+            desc_offsets,
+            desc_elem_ids,
+            slot_offsets,
+            slots,
+            colors,
+        }
+    }
+
+    /// The global [SparsityPattern] of the system matrices
+    pub fn pattern(&self) -> &SparsityPattern {
+        &self.pattern
+    }
+
+    /// A shared handle to the global [SparsityPattern]. Matrices constructed from this handle use the plan's copy of the pattern rather than allocating their own
+    pub fn shared_pattern(&self) -> Arc<SparsityPattern> {
+        self.pattern.clone()
+    }
+
+    /// IDs of an `Elem`'s descendants which have [BasisSpec](crate::fem_domain::domain::dof::basis_spec::BasisSpec)s
+    pub fn descendants(&self, elem_id: usize) -> &[usize] {
+        &self.desc_elem_ids[self.desc_offsets[elem_id]..self.desc_offsets[elem_id + 1]]
+    }
+
+    /// Storage slots of the values computed over an `Elem` (in the order of [ElemMatrix::upper_values](crate::fem_problem::linalg::elem_matrix::ElemMatrix::upper_values))
+    pub fn elem_slots(&self, elem_id: usize) -> &[usize] {
+        &self.slots[self.slot_offsets[elem_id]..self.slot_offsets[elem_id + 1]]
+    }
+
+    /// Groups of `Elem` IDs, such that no two `Elem`s in the same group contribute to any of the same DoFs
+    ///
+    /// The values from all `Elem`s of one color can be added into the system matrices simultaneously without any synchronization. `Elem`s without [BasisSpec](crate::fem_domain::domain::dof::basis_spec::BasisSpec)s are not included.
+    pub fn colors(&self) -> &[Vec<usize>] {
+        &self.colors
+    }
+
+    /// Check whether this plan has the same dimensions and DoF numbering as a [Domain] (i.e. it was likely computed from the same `Domain`, and the DoFs have not been renumbered since)
+    pub fn matches(&self, domain: &Domain) -> bool {
+        self.pattern.dimension() == domain.dofs.len()
+            && self.num_elems == domain.mesh.elems.len()
+            && self.numbering == dof_numbering(domain)
+    }
+}
+
+// A hash of the DoF ID of each BasisSpec on each Elem (in the style of GEPCacheKey)
+fn dof_numbering(domain: &Domain) -> u64 {
+    let mut hasher = Fnv1a::new();
+    for basis_specs in domain.basis_specs.iter() {
+        hasher.write_usize(basis_specs.len());
+        for bs in basis_specs.iter() {
+            hasher.write_usize(bs.dof_id.map_or(0, |id| id + 1));
+        }
+    }
+    hasher.finish()
+}
+
+// The IDs of each Elem's descendants which have BasisSpecs (only these are relevant to integration)
+// Elems without BasisSpecs are given an empty list
+pub(super) fn elem_descendants(domain: &Domain) -> Vec<Vec<usize>> {
+    domain
+        .mesh
+        .elems
+        .par_iter()
+        .map(|elem| {
+            if domain.basis_specs[elem.id].is_empty() {
+                Vec::new()
+            } else {
+                domain
+                    .mesh
+                    .descendant_elems(elem.id, false)
+                    .unwrap()
+                    .drain(0..)
+                    .filter(|desc_id| !domain.basis_specs[*desc_id].is_empty())
+                    .collect()
+            }
+        })
+        .collect()
+}
+
+// Greedily color the Elems such that no two Elems of the same color touch the same DoF (via their local or descendant BasisSpecs)
+// Elems that touch the most DoFs are colored first
+fn color_elems(domain: &Domain, elem_descendants: &[Vec<usize>]) -> Vec<Vec<usize>> {
+    let elem_dofs: Vec<Vec<usize>> = domain
+        .basis_specs
+        .par_iter()
+        .zip(elem_descendants.par_iter())
+        .map(|(local_bs, desc_ids)| {
+            if local_bs.is_empty() {
+                return Vec::new();
+            }
+            let mut dofs: Vec<usize> = local_bs
+                .iter()
+                .chain(
+                    desc_ids
+                        .iter()
+                        .flat_map(|desc_id| domain.basis_specs[*desc_id].iter()),
+                )
+                .map(|bs| bs.dof_id.unwrap())
+                .collect();
+            dofs.sort_unstable();
+            dofs.dedup();
+            dofs
+        })
+        .collect();
+
+    let mut dof_elems: Vec<Vec<usize>> = vec![Vec::new(); domain.dofs.len()];
+    for (elem_id, dofs) in elem_dofs.iter().enumerate() {
+        for &dof_id in dofs.iter() {
+            dof_elems[dof_id].push(elem_id);
+        }
+    }
+
+    let mut elem_order: Vec<usize> = (0..elem_dofs.len())
+        .filter(|elem_id| !elem_dofs[*elem_id].is_empty())
+        .collect();
+    elem_order.sort_by_key(|elem_id| std::cmp::Reverse(elem_dofs[*elem_id].len()));
+
+    let mut elem_colors = vec![usize::MAX; elem_dofs.len()];
+    let mut colors: Vec<Vec<usize>> = Vec::new();
+    // the last Elem for which each color was found to be unavailable
+    let mut unavailable_for: Vec<usize> = Vec::new();
+
+    for elem_id in elem_order {
+        for &dof_id in elem_dofs[elem_id].iter() {
+            for &neighbor_id in dof_elems[dof_id].iter() {
+                if elem_colors[neighbor_id] != usize::MAX {
+                    unavailable_for[elem_colors[neighbor_id]] = elem_id;
+                }
+            }
+        }
+
+        let color = match unavailable_for.iter().position(|&e| e != elem_id) {
+            Some(color) => color,
+            None => {
+                colors.push(Vec::new());
+                unavailable_for.push(usize::MAX);
+                colors.len() - 1
+            }
+        };
+
+        elem_colors[elem_id] = color;
+        colors[color].push(elem_id);
+    }
+
+    colors
+}
+
+// Convert a list of lists into offsets and a single contiguous list
+fn flatten(mut lists: Vec<Vec<usize>>) -> (Vec<usize>, Vec<usize>) {
+    let mut offsets = Vec::with_capacity(lists.len() + 1);
+    offsets.push(0);
+    for list in lists.iter() {
+        offsets.push(offsets.last().unwrap() + list.len());
+    }
+
+    let mut flat = Vec::with_capacity(*offsets.last().unwrap());
+    for list in lists.drain(0..) {
+        flat.extend(list);
+    }
+
+    (offsets, flat)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::fem_domain::domain::{
+        mesh::{h_refinement::HRef, p_refinement::PRef, Mesh},
+        ContinuityCondition,
+    };
+
+    #[test]
+    fn plan_construction() {
+        let mut mesh = Mesh::from_file("./test_input/test_mesh_b.json").unwrap();
+        mesh.global_p_refinement(PRef::from(2, 2));
+        mesh.global_h_refinement(HRef::T);
+        mesh.h_refine_elems(vec![6, 9, 12], HRef::T).unwrap();
+        let domain = Domain::from_mesh(mesh, ContinuityCondition::HCurl);
+
+        let plan = AssemblyPlan::new(&domain);
+        assert!(plan.matches(&domain));
+
+        for elem in domain.elems() {
+            let local_bs = domain.local_basis_specs(elem.id).unwrap();
+            let num_desc_bs: usize = plan
+                .descendants(elem.id)
+                .iter()
+                .map(|desc_id| domain.basis_specs[*desc_id].len())
+                .sum();
+
+            assert_eq!(
+                plan.elem_slots(elem.id).len(),
+                local_bs.len() * (local_bs.len() + 1) / 2 + local_bs.len() * num_desc_bs
+            );
+
+            if let Some(bs_0) = local_bs.first() {
+                let dof_0 = bs_0.dof_id.unwrap();
+                assert_eq!(
+                    plan.elem_slots(elem.id)[0],
+                    plan.pattern().slot([dof_0, dof_0]).unwrap()
+                );
+            }
+        }
+
+        assert!(!plan.matches(&Domain::unit(ContinuityCondition::HCurl)));
+    }
+
+    #[test]
+    fn elem_coloring() {
+        let mut mesh = Mesh::from_file("./test_input/test_mesh_b.json").unwrap();
+        mesh.global_p_refinement(PRef::from(2, 2));
+        mesh.global_h_refinement(HRef::T);
+        mesh.h_refine_elems(vec![6, 9, 12], HRef::T).unwrap();
+        let domain = Domain::from_mesh(mesh, ContinuityCondition::HCurl);
+
+        let plan = AssemblyPlan::new(&domain);
+
+        let elem_dofs = |elem_id: usize| -> Vec<usize> {
+            domain.basis_specs[elem_id]
+                .iter()
+                .chain(
+                    plan.descendants(elem_id)
+                        .iter()
+                        .flat_map(|desc_id| domain.basis_specs[*desc_id].iter()),
+                )
+                .map(|bs| bs.dof_id.unwrap())
+                .collect()
+        };
+
+        let mut num_colored = 0;
+        for color in plan.colors() {
+            let mut dof_used = vec![false; domain.dofs.len()];
+            for &elem_id in color.iter() {
+                let mut dofs = elem_dofs(elem_id);
+                dofs.sort_unstable();
+                dofs.dedup();
+
+                for dof_id in dofs {
+                    assert!(!dof_used[dof_id]);
+                    dof_used[dof_id] = true;
+                }
+            }
+            num_colored += color.len();
+        }
+
+        let num_with_bs = domain
+            .basis_specs
+            .iter()
+            .filter(|bs| !bs.is_empty())
+            .count();
+        assert_eq!(num_colored, num_with_bs);
+    }
+}
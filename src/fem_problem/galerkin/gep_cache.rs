@@ -0,0 +1,442 @@
+use super::{galerkin_sample_gep_hcurl, GalerkinSamplingError};
+use crate::fem_domain::{
+    basis::HierCurlBasisFnSpace,
+    domain::{dof::basis_spec::BasisDir, ContinuityCondition, Domain},
+};
+use crate::fem_problem::{
+    integration::HierCurlIntegral,
+    linalg::{
+        csr_matrix::{CsrMatrix, SparsityPattern},
+        sparse_matrix::{read_exact_at, read_section, write_all_at, write_section},
+        GEP,
+    },
+};
+use bytes::{BufMut, BytesMut};
+use std::fmt;
+use std::fs::{self, File};
+use std::path::{Path, PathBuf};
+use std::sync::Arc;
+
+/// Identifies the [GEP] produced by Galerkin Sampling over a particular [Domain] with particular settings
+///
+/// The key is a 64-bit FNV-1a hash of everything that determines the system matrices:
+/// * The geometry, materials, h-refinement state and expansion orders of each `Elem`
+/// * The [BasisSpec](crate::fem_domain::domain::dof::basis_spec::BasisSpec)s on each `Elem` (including their DoF IDs, such that renumbered Domains have distinct keys)
+/// * The type names of the Basis Space and the two Integrals
+/// * The GLQ grid dimensions
+#[derive(Clone, Copy, Debug, PartialEq, Eq, Hash)]
+pub struct GEPCacheKey(u64);
+
+impl GEPCacheKey {
+    /// Compute the key for the GEP that [galerkin_sample_gep_hcurl] would produce with the same arguments
+    pub fn new<BSpace, AI, BI>(domain: &Domain, glq_grid_dim: Option<[usize; 2]>) -> Self
+    where
+        BSpace: HierCurlBasisFnSpace,
+        AI: HierCurlIntegral,
+        BI: HierCurlIntegral,
+    {
+        let mut hasher = Fnv1a::new();
+
+        for type_name in [
+            std::any::type_name::<BSpace>(),
+            std::any::type_name::<AI>(),
+            std::any::type_name::<BI>(),
+        ] {
+            hasher.write_usize(type_name.len());
+            hasher.write(type_name.as_bytes());
+        }
+        match glq_grid_dim {
+            Some([u, v]) => {
+                hasher.write_usize(u);
+                hasher.write_usize(v);
+            }
+            None => hasher.write_usize(0),
+        }
+
+        hasher.write_u8(match domain.cc {
+            ContinuityCondition::HCurl => 0,
+            ContinuityCondition::HDiv => 1,
+            ContinuityCondition::Discontinuous => 2,
+        });
+        hasher.write_usize(domain.dofs.len());
+        hasher.write_usize(domain.mesh.elems.len());
+
+        for elem in domain.elems() {
+            hasher.write_usize(elem.element.id);
+            for point in elem.element.points.iter() {
+                hasher.write_f64(point.x);
+                hasher.write_f64(point.y);
+            }
+            let materials = elem.get_materials();
+            for value in [materials.eps_rel, materials.mu_rel] {
+                hasher.write_f64(value.re);
+                hasher.write_f64(value.im);
+            }
+
+            hasher.write_usize(elem.parent_id().map_or(0, |id| id + 1));
+            for bound in elem.parametric_range().iter().flatten() {
+                hasher.write_f64(*bound);
+            }
+            hasher.write_u8(elem.h_levels.u);
+            hasher.write_u8(elem.h_levels.v);
+            hasher.write_u8(elem.poly_orders.ni);
+            hasher.write_u8(elem.poly_orders.nj);
+
+            let basis_specs = &domain.basis_specs[elem.id];
+            hasher.write_usize(basis_specs.len());
+            for bs in basis_specs.iter() {
+                hasher.write_usize(bs.dof_id.map_or(0, |id| id + 1));
+                hasher.write_u8(bs.i);
+                hasher.write_u8(bs.j);
+                hasher.write_u8(match bs.dir {
+                    BasisDir::U => 0,
+                    BasisDir::V => 1,
+                    BasisDir::W => 2,
+                });
+            }
+        }
+
+        Self(hasher.finish())
+    }
+}
+
+impl fmt::Display for GEPCacheKey {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        write!(f, "{:016x}", self.0)
+    }
+}
+
+/// A directory of assembled [GEP]s stored in a compact binary format
+///
+/// Each GEP is stored in its own file, named by its [GEPCacheKey]. The file holds the shared [SparsityPattern] once, followed by the values of the A and B matrices.
+/// Files are read and written in parallel chunks at fixed offsets, such that loading a GEP is limited by disk bandwidth rather than by decoding.
+///
+/// ```
+/// use fem_2d::prelude::*;
+///
+/// let mut mesh = Mesh::from_file("./test_input/test_mesh_a.json").unwrap();
+/// mesh.global_p_refinement(PRef::from(2, 2));
+/// let domain = Domain::from_mesh(mesh, ContinuityCondition::HCurl);
+///
+/// let cache = GEPCache::new("./test_output/gep_cache_doc").unwrap();
+///
+/// // the first call samples the GEP and stores it; the second loads it from disk
+/// let gep = cache.load_or_sample::<HierPoly, CurlCurl, L2Inner>(&domain, Some([8, 8])).unwrap();
+/// let gep_loaded = cache.load_or_sample::<HierPoly, CurlCurl, L2Inner>(&domain, Some([8, 8])).unwrap();
+///
+/// assert_eq!(gep.a.values(), gep_loaded.a.values());
+/// ```
+pub struct GEPCache {
+    dir: PathBuf,
+}
+
+impl GEPCache {
+    /// Open a cache in some directory (which is created if it doesn't exist)
+    pub fn new(dir: impl AsRef<Path>) -> std::io::Result<Self> {
+        fs::create_dir_all(dir.as_ref())?;
+        Ok(Self {
+            dir: dir.as_ref().to_path_buf(),
+        })
+    }
+
+    /// Location of the file for a particular key
+    pub fn path(&self, key: GEPCacheKey) -> PathBuf {
+        self.dir.join(format!("gep_{}.bin", key))
+    }
+
+    /// Load a [GEP] from the cache. Returns `Ok(None)` if no GEP is stored under the key
+    pub fn load(&self, key: GEPCacheKey) -> Result<Option<GEP>, GEPCacheError> {
+        let path = self.path(key);
+        let file = match File::open(&path) {
+            Ok(file) => file,
+            Err(err) if err.kind() == std::io::ErrorKind::NotFound => return Ok(None),
+            Err(err) => return Err(GEPCacheError::IO(err)),
+        };
+        let corrupted = || GEPCacheError::Corrupted(path.clone());
+
+        let file_len = file.metadata()?.len();
+        if file_len < GEP_CACHE_HEADER_SIZE {
+            return Err(corrupted());
+        }
+        let mut header = [0; GEP_CACHE_HEADER_SIZE as usize];
+        read_exact_at(&file, &mut header, 0)?;
+        let header_field = |idx: usize| decode_u64(&header[8 * idx..8 * (idx + 1)]);
+
+        if &header[0..8] != GEP_CACHE_MAGIC
+            || header_field(1) != GEP_CACHE_VERSION
+            || header_field(2) != key.0
+        {
+            return Err(corrupted());
+        }
+        let dimension = header_field(3) as usize;
+        let nnz = header_field(4) as usize;
+        if dimension > (std::u32::MAX as usize) || nnz as u64 > file_len {
+            return Err(corrupted());
+        }
+
+        let layout = FileLayout::new(dimension, nnz);
+        if layout.file_len != file_len {
+            return Err(corrupted());
+        }
+
+        let mut row_offsets = vec![0; dimension + 1];
+        let mut col_indices = vec![0; nnz];
+        let mut a_values = vec![0.0; nnz];
+        let mut b_values = vec![0.0; nnz];
+        read_section(&file, &mut row_offsets, layout.row_offsets, 8, |b| {
+            decode_u64(b) as usize
+        })?;
+        read_section(&file, &mut col_indices, layout.col_indices, 4, |b| {
+            u32::from_le_bytes(b.try_into().unwrap())
+        })?;
+        read_section(&file, &mut a_values, layout.a_values, 8, |b| {
+            f64::from_le_bytes(b.try_into().unwrap())
+        })?;
+        read_section(&file, &mut b_values, layout.b_values, 8, |b| {
+            f64::from_le_bytes(b.try_into().unwrap())
+        })?;
+
+        let pattern = Arc::new(
+            SparsityPattern::from_raw_parts(dimension, row_offsets, col_indices)
+                .ok_or_else(corrupted)?,
+        );
+        Ok(Some(GEP {
+            a: CsrMatrix::from_values(pattern.clone(), a_values),
+            b: CsrMatrix::from_values(pattern, b_values),
+        }))
+    }
+
+    /// Store a [GEP] in the cache (replacing any GEP already stored under the key)
+    ///
+    /// The A and B matrices must share a [SparsityPattern] (as they do when produced by [galerkin_sample_gep_hcurl])
+    pub fn store(&self, key: GEPCacheKey, gep: &GEP) -> Result<(), GEPCacheError> {
+        assert!(
+            gep.a.shares_pattern_with(&gep.b),
+            "A and B matrices do not share a SparsityPattern; cannot store GEP!"
+        );
+        let pattern = gep.pattern();
+        let layout = FileLayout::new(pattern.dimension(), pattern.num_upper_entries());
+
+        // write to a temporary file first, such that an interrupted write never leaves a partial file under the key
+        let path = self.path(key);
+        let tmp_path = path.with_extension("tmp");
+        let file = File::create(&tmp_path)?;
+        file.set_len(layout.file_len)?;
+
+        let mut header = BytesMut::with_capacity(GEP_CACHE_HEADER_SIZE as usize);
+        header.put(&GEP_CACHE_MAGIC[..]);
+        header.put_u64_le(GEP_CACHE_VERSION);
+        header.put_u64_le(key.0);
+        header.put_u64_le(pattern.dimension() as u64);
+        header.put_u64_le(pattern.num_upper_entries() as u64);
+        write_all_at(&file, header.as_ref(), 0)?;
+
+        write_section(
+            &file,
+            pattern.row_offsets(),
+            layout.row_offsets,
+            8,
+            |buf, o| buf.put_u64_le(*o as u64),
+        )?;
+        write_section(
+            &file,
+            pattern.col_indices(),
+            layout.col_indices,
+            4,
+            |buf, c| buf.put_u32_le(*c),
+        )?;
+        write_section(&file, gep.a.values(), layout.a_values, 8, |buf, a| {
+            buf.put_f64_le(*a)
+        })?;
+        write_section(&file, gep.b.values(), layout.b_values, 8, |buf, b| {
+            buf.put_f64_le(*b)
+        })?;
+
+        file.sync_all()?;
+        fs::rename(&tmp_path, &path)?;
+        Ok(())
+    }
+
+    /// Load the [GEP] for a [Domain] from the cache, or compute it with [galerkin_sample_gep_hcurl] and store it if it isn't present
+    ///
+    /// A corrupted cache file is treated as missing, and is replaced
+    pub fn load_or_sample<BSpace, AI, BI>(
+        &self,
+        domain: &Domain,
+        glq_grid_dim: Option<[usize; 2]>,
+    ) -> Result<GEP, GEPCacheError>
+    where
+        BSpace: HierCurlBasisFnSpace,
+        AI: HierCurlIntegral,
+        BI: HierCurlIntegral,
+    {
+        let key = GEPCacheKey::new::<BSpace, AI, BI>(domain, glq_grid_dim);
+
+        match self.load(key) {
+            Ok(Some(gep)) if gep.dimension() == domain.dofs.len() => return Ok(gep),
+            Ok(_) | Err(GEPCacheError::Corrupted(_)) => {}
+            Err(err) => return Err(err),
+        }
+
+        let gep = galerkin_sample_gep_hcurl::<BSpace, AI, BI>(domain, glq_grid_dim)?;
+        self.store(key, &gep)?;
+        Ok(gep)
+    }
+}
+
+/// Identifies cache files written by [GEPCache]
+const GEP_CACHE_MAGIC: &[u8; 8] = b"fem2dGEP";
+/// Revision of the cache file layout (incremented whenever it changes)
+const GEP_CACHE_VERSION: u64 = 1;
+/// Size of a cache file header in bytes: magic, version, key, dimension, and number of upper-triangle entries
+const GEP_CACHE_HEADER_SIZE: u64 = 40;
+
+// Byte offsets of each section of a cache file
+struct FileLayout {
+    row_offsets: u64,
+    col_indices: u64,
+    a_values: u64,
+    b_values: u64,
+    file_len: u64,
+}
+
+impl FileLayout {
+    fn new(dimension: usize, nnz: usize) -> Self {
+        let row_offsets = GEP_CACHE_HEADER_SIZE;
+        let col_indices = row_offsets + 8 * (dimension as u64 + 1);
+        let a_values = col_indices + 4 * nnz as u64;
+        let b_values = a_values + 8 * nnz as u64;
+        Self {
+            row_offsets,
+            col_indices,
+            a_values,
+            b_values,
+            file_len: b_values + 8 * nnz as u64,
+        }
+    }
+}
+
+fn decode_u64(bytes: &[u8]) -> u64 {
+    u64::from_le_bytes(bytes.try_into().unwrap())
+}
+
+// 64-bit FNV-1a hash (stable across platforms and compiler versions, unlike std's DefaultHasher)
+pub(super) struct Fnv1a(u64);
+
+impl Fnv1a {
+    pub(super) fn new() -> Self {
+        Self(0xcbf29ce484222325)
+    }
+
+    fn write(&mut self, bytes: &[u8]) {
+        for byte in bytes {
+            self.0 ^= *byte as u64;
+            self.0 = self.0.wrapping_mul(0x100000001b3);
+        }
+    }
+
+    fn write_u8(&mut self, value: u8) {
+        self.write(&[value]);
+    }
+
+    pub(super) fn write_usize(&mut self, value: usize) {
+        self.write(&(value as u64).to_le_bytes());
+    }
+
+    fn write_f64(&mut self, value: f64) {
+        self.write(&value.to_bits().to_le_bytes());
+    }
+
+    pub(super) fn finish(&self) -> u64 {
+        self.0
+    }
+}
+
+#[derive(Debug)]
+pub enum GEPCacheError {
+    Sampling(GalerkinSamplingError),
+    IO(std::io::Error),
+    Corrupted(PathBuf),
+}
+
+impl std::error::Error for GEPCacheError {}
+
+impl fmt::Display for GEPCacheError {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        match self {
+            Self::Sampling(err) => write!(f, "{}", err),
+            Self::IO(err) => write!(f, "GEP Cache IO Error: {}", err),
+            Self::Corrupted(path) => write!(
+                f,
+                "GEP Cache file ({}) is corrupted; Cannot load GEP!",
+                path.display()
+            ),
+        }
+    }
+}
+
+impl From<GalerkinSamplingError> for GEPCacheError {
+    fn from(err: GalerkinSamplingError) -> Self {
+        Self::Sampling(err)
+    }
+}
+
+impl From<std::io::Error> for GEPCacheError {
+    fn from(err: std::io::Error) -> Self {
+        Self::IO(err)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::fem_domain::basis::hierarchical_basis_fns::poly::HierPoly;
+    use crate::fem_domain::domain::mesh::{h_refinement::HRef, p_refinement::PRef, Mesh};
+    use crate::fem_problem::integration::integrals::{curl_curl::CurlCurl, inner::L2Inner};
+
+    #[test]
+    fn gep_cache_round_trip() {
+        let mut mesh = Mesh::from_file("./test_input/test_mesh_b.json").unwrap();
+        mesh.global_p_refinement(PRef::from(2, 2));
+        mesh.global_h_refinement(HRef::T);
+        let domain = Domain::from_mesh(mesh, ContinuityCondition::HCurl);
+
+        let key = GEPCacheKey::new::<HierPoly, CurlCurl, L2Inner>(&domain, Some([8, 8]));
+        assert_eq!(
+            key,
+            GEPCacheKey::new::<HierPoly, CurlCurl, L2Inner>(&domain, Some([8, 8]))
+        );
+        assert_ne!(
+            key,
+            GEPCacheKey::new::<HierPoly, CurlCurl, L2Inner>(&domain, Some([10, 10]))
+        );
+        assert_ne!(
+            key,
+            GEPCacheKey::new::<HierPoly, L2Inner, L2Inner>(&domain, Some([8, 8]))
+        );
+
+        let cache = GEPCache::new("./test_output/gep_cache_test").unwrap();
+        let _ = fs::remove_file(cache.path(key));
+        assert!(cache.load(key).unwrap().is_none());
+
+        let gep = cache
+            .load_or_sample::<HierPoly, CurlCurl, L2Inner>(&domain, Some([8, 8]))
+            .unwrap();
+        let gep_loaded = cache.load(key).unwrap().unwrap();
+
+        assert_eq!(gep.pattern(), gep_loaded.pattern());
+        assert_eq!(gep.a.values(), gep_loaded.a.values());
+        assert_eq!(gep.b.values(), gep_loaded.b.values());
+        assert!(gep_loaded.a.shares_pattern_with(&gep_loaded.b));
+
+        // truncated files are detected
+        let file = fs::OpenOptions::new()
+            .write(true)
+            .open(cache.path(key))
+            .unwrap();
+        file.set_len(GEP_CACHE_HEADER_SIZE + 8).unwrap();
+        assert!(matches!(cache.load(key), Err(GEPCacheError::Corrupted(_))));
+
+        fs::remove_file(cache.path(key)).unwrap();
+    }
+}
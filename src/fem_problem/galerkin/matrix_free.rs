@@ -0,0 +1,201 @@
+use super::{
+    assembly_plan::elem_descendants, check_domain, sample_elem, setup_integration,
+    GalerkinSamplingError,
+};
+use crate::fem_domain::{
+    basis::{BasisFnSampler, HierCurlBasisFn, HierCurlBasisFnSpace},
+    domain::Domain,
+};
+use crate::fem_problem::{
+    integration::HierCurlIntegral,
+    linalg::{elem_matrix::ElemMatrix, operator::GEPOperator},
+};
+use rayon::prelude::*;
+
+/// The pair of system matrices produced by [galerkin_sample_gep_hcurl](super::galerkin_sample_gep_hcurl), represented without assembling them
+///
+/// Each application recomputes the `Elem`-wise integrals and multiplies the resulting [ElemMatrix]s directly against the input vector.
+/// Only the `Elem`-descendant relationships and the [BasisFnSampler]'s cache of sampled basis functions are retained between applications,
+/// so memory usage grows with the number of DoFs rather than the number of non-zero matrix entries.
+///
+/// This trades floating point work for memory, which is favorable for high expansion orders where the matrices become dense within each `Elem`.
+///
+/// The operator implements [GEPOperator], so it can be used in place of an assembled [GEP](crate::fem_problem::linalg::GEP) by iterative solvers.
+pub struct MatrixFreeGEP<'d, BSpace, AI, BI>
+where
+    BSpace: HierCurlBasisFnSpace,
+    AI: HierCurlIntegral,
+    BI: HierCurlIntegral,
+{
+    domain: &'d Domain,
+    elem_ids: Vec<usize>,
+    elem_descendants: Vec<Vec<usize>>,
+    bs_sampler: BasisFnSampler<HierCurlBasisFn<BSpace>>,
+    a_integrator: AI,
+    b_integrator: BI,
+}
+
+impl<'d, BSpace, AI, BI> MatrixFreeGEP<'d, BSpace, AI, BI>
+where
+    BSpace: HierCurlBasisFnSpace,
+    AI: HierCurlIntegral,
+    BI: HierCurlIntegral,
+{
+    /// Setup matrix-free application of the system matrices over a [Domain]
+    ///
+    /// Accepts the same arguments (and returns the same errors) as [galerkin_sample_gep_hcurl](super::galerkin_sample_gep_hcurl)
+    pub fn new(
+        domain: &'d Domain,
+        glq_grid_dim: Option<[usize; 2]>,
+    ) -> Result<Self, GalerkinSamplingError> {
+        check_domain(domain)?;
+        let (bs_sampler, a_integrator, b_integrator) =
+            setup_integration::<BSpace, AI, BI>(domain, glq_grid_dim)?;
+
+        let elem_ids = domain
+            .elems()
+            .map(|elem| elem.id)
+            .filter(|elem_id| !domain.basis_specs[*elem_id].is_empty())
+            .collect();
+
+        Ok(Self {
+            domain,
+            elem_ids,
+            elem_descendants: elem_descendants(domain),
+            bs_sampler,
+            a_integrator,
+            b_integrator,
+        })
+    }
+
+    // Compute the products of `x` with the requested matrices. The product of a matrix that isn't requested is left empty
+    fn apply_matrices(&self, x: &[f64], [with_a, with_b]: [bool; 2]) -> [Vec<f64>; 2] {
+        let dim = self.domain.dofs.len();
+        assert_eq!(
+            x.len(),
+            dim,
+            "Vector length does not match the number of DoFs; cannot apply MatrixFreeGEP!"
+        );
+        let zeros = |requested: bool| {
+            if requested {
+                vec![0.0; dim]
+            } else {
+                Vec::new()
+            }
+        };
+
+        self.elem_ids
+            .par_iter()
+            .fold(
+                || {
+                    (
+                        self.bs_sampler.clone(),
+                        [ElemMatrix::default(), ElemMatrix::default()],
+                        [zeros(with_a), zeros(with_b)],
+                    )
+                },
+                |(mut sampler, mut elem_matrices, mut products), &elem_id| {
+                    let [a_matrix, b_matrix] = &mut elem_matrices;
+                    sample_elem(
+                        self.domain,
+                        &self.elem_descendants[elem_id],
+                        &self.domain.mesh.elems[elem_id],
+                        &mut sampler,
+                        &self.a_integrator,
+                        &self.b_integrator,
+                        [with_a.then(|| a_matrix), with_b.then(|| b_matrix)],
+                    );
+
+                    for (elem_matrix, y) in elem_matrices.iter().zip(products.iter_mut()) {
+                        if !y.is_empty() {
+                            elem_matrix.sym_mul_vec_add(x, y);
+                        }
+                    }
+
+                    (sampler, elem_matrices, products)
+                },
+            )
+            .map(|(_, _, products)| products)
+            .reduce_with(|mut products, other| {
+                for (y, y_other) in products.iter_mut().zip(other.iter()) {
+                    if !y.is_empty() {
+                        super::add_values(y, y_other);
+                    }
+                }
+                products
+            })
+            .unwrap_or_else(|| [zeros(with_a), zeros(with_b)])
+    }
+}
+
+impl<'d, BSpace, AI, BI> GEPOperator for MatrixFreeGEP<'d, BSpace, AI, BI>
+where
+    BSpace: HierCurlBasisFnSpace,
+    AI: HierCurlIntegral,
+    BI: HierCurlIntegral,
+{
+    fn dimension(&self) -> usize {
+        self.domain.dofs.len()
+    }
+
+    fn apply_a(&self, x: &[f64]) -> Vec<f64> {
+        let [ax, _] = self.apply_matrices(x, [true, false]);
+        ax
+    }
+
+    fn apply_b(&self, x: &[f64]) -> Vec<f64> {
+        let [_, bx] = self.apply_matrices(x, [false, true]);
+        bx
+    }
+
+    fn apply_both(&self, x: &[f64]) -> [Vec<f64>; 2] {
+        self.apply_matrices(x, [true, true])
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::fem_domain::basis::hierarchical_basis_fns::poly::HierPoly;
+    use crate::fem_domain::domain::{
+        mesh::{h_refinement::HRef, p_refinement::PRef, Mesh},
+        ContinuityCondition,
+    };
+    use crate::fem_problem::galerkin::galerkin_sample_gep_hcurl;
+    use crate::fem_problem::integration::integrals::{curl_curl::CurlCurl, inner::L2Inner};
+
+    #[test]
+    fn matrix_free_application() {
+        let mut mesh = Mesh::from_file("./test_input/test_mesh_b.json").unwrap();
+        mesh.global_p_refinement(PRef::from(2, 2));
+        mesh.global_h_refinement(HRef::T);
+        mesh.h_refine_elems(vec![6, 9, 12], HRef::T).unwrap();
+        let domain = Domain::from_mesh(mesh, ContinuityCondition::HCurl);
+
+        let gep = galerkin_sample_gep_hcurl::<HierPoly, CurlCurl, L2Inner>(&domain, Some([8, 8]))
+            .unwrap();
+        let mf_gep =
+            MatrixFreeGEP::<HierPoly, CurlCurl, L2Inner>::new(&domain, Some([8, 8])).unwrap();
+        assert_eq!(mf_gep.dimension(), gep.dimension());
+
+        let x: Vec<f64> = (0..gep.dimension())
+            .map(|i| ((i * 7) % 13) as f64 - 6.0)
+            .collect();
+
+        let [ax, bx] = gep.mul_vec(&x);
+        let [mf_ax, mf_bx] = mf_gep.apply_both(&x);
+
+        let (mf_ax_only, mf_bx_only) = (mf_gep.apply_a(&x), mf_gep.apply_b(&x));
+
+        for (expected, computed) in [
+            (&ax, &mf_ax),
+            (&bx, &mf_bx),
+            (&ax, &mf_ax_only),
+            (&bx, &mf_bx_only),
+        ] {
+            for (e, c) in expected.iter().zip(computed.iter()) {
+                assert!((e - c).abs() < 1e-10 * (1.0 + e.abs()));
+            }
+        }
+    }
+}
@@ -0,0 +1,480 @@
+use super::{
+    assembly_plan::elem_descendants, check_domain, sample_elem, setup_integration,
+    GalerkinSamplingError,
+};
+use crate::fem_domain::{basis::HierCurlBasisFnSpace, domain::Domain};
+use crate::fem_problem::{
+    integration::HierCurlIntegral,
+    linalg::{elem_matrix::ElemMatrix, sparse_matrix::petsc_matrix_header},
+};
+use rayon::prelude::*;
+use std::cmp::Reverse;
+use std::collections::BinaryHeap;
+use std::fmt;
+use std::fs::{self, File};
+use std::io::{self, BufReader, BufWriter, Read, Write};
+use std::path::{Path, PathBuf};
+
+/// Settings for [galerkin_sample_gep_hcurl_out_of_core]
+#[derive(Clone, Debug)]
+pub struct OutOfCoreSettings {
+    /// Directory in which temporary files are stored during assembly (preferably on fast local storage)
+    pub scratch_dir: PathBuf,
+    /// Approximate number of bytes of matrix entries held in memory at once
+    pub memory_budget: usize,
+}
+
+/// A Generalized Eigenvalue Problem whose A and B matrices are stored on disk in PETSc's binary AIJ format
+///
+/// This is produced by [galerkin_sample_gep_hcurl_out_of_core], and can be passed directly to [slepc_solve_gep](crate::fem_problem::linalg::slepc_solve::slepc_solve_gep)
+#[derive(Clone, Debug)]
+pub struct OutOfCoreGEP {
+    /// Size of the square matrices
+    pub dimension: usize,
+    /// Number of non-zero entries in each matrix (counting both triangles)
+    pub nnz: usize,
+    /// Location of the A Matrix file
+    pub a_path: PathBuf,
+    /// Location of the B Matrix file
+    pub b_path: PathBuf,
+}
+
+/// Fill two system matrices using a [Domain]'s Basis Space as the Testing Space, writing them directly to disk in PETSc's binary AIJ format
+///
+/// This is equivalent to [galerkin_sample_gep_hcurl](super::galerkin_sample_gep_hcurl) followed by [GEP::print_to_petsc_binary_files](crate::fem_problem::linalg::GEP::print_to_petsc_binary_files),
+/// except that the matrices are never held in memory. Memory usage is bounded by `settings.memory_budget`, plus a few vectors the length of the number of DoFs.
+///
+/// # Execution Details:
+///
+/// 1. `Elem`s are processed in consecutive batches whose entries fit within the memory budget. The entries of each batch are computed in parallel, sorted, combined, and spilled to a run file in the scratch directory
+/// 2. The run files are merged in a single streaming pass (summing duplicate entries), producing the row counts, column indices, and values of both matrices
+/// 3. The two matrix files are written from the merged sections, and all temporary files are removed
+///
+/// The matrix files are written to `a_path` and `b_path`.
+pub fn galerkin_sample_gep_hcurl_out_of_core<
+    BSpace: HierCurlBasisFnSpace,
+    AI: HierCurlIntegral,
+    BI: HierCurlIntegral,
+>(
+    domain: &Domain,
+    glq_grid_dim: Option<[usize; 2]>,
+    settings: &OutOfCoreSettings,
+    a_path: impl AsRef<Path>,
+    b_path: impl AsRef<Path>,
+) -> Result<OutOfCoreGEP, OutOfCoreError> {
+    check_domain(domain)?;
+    let (bs_sampler, a_integrator, b_integrator) =
+        setup_integration::<BSpace, AI, BI>(domain, glq_grid_dim)?;
+    let elem_descendants = elem_descendants(domain);
+
+    // the number of non-zeros is only checked once the runs are merged, but an oversized dimension can be caught before any sampling is done
+    petsc_matrix_header(domain.dofs.len(), 0)?;
+
+    let scratch = ScratchDir::new(&settings.scratch_dir)?;
+    let max_run_entries = (settings.memory_budget / std::mem::size_of::<Entry>()).max(1);
+
+    // compute and spill sorted runs of entries
+    let mut run_paths = Vec::new();
+    for batch in entry_batches(domain, &elem_descendants, max_run_entries) {
+        let mut entries: Vec<Entry> = domain.mesh.elems[batch]
+            .par_iter()
+            .filter(|elem| !domain.basis_specs[elem.id].is_empty())
+            .map_with(
+                (
+                    bs_sampler.clone(),
+                    [ElemMatrix::default(), ElemMatrix::default()],
+                ),
+                |(bf_sampler_elem, elem_matrices), elem| {
+                    let [a_matrix, b_matrix] = elem_matrices;
+                    sample_elem(
+                        domain,
+                        &elem_descendants[elem.id],
+                        elem,
+                        bf_sampler_elem,
+                        &a_integrator,
+                        &b_integrator,
+                        [Some(&mut *a_matrix), Some(&mut *b_matrix)],
+                    );
+                    full_entries(a_matrix, b_matrix)
+                },
+            )
+            .flatten()
+            .collect();
+
+        entries.par_sort_unstable_by_key(|entry| entry.coords);
+        combine_duplicates(&mut entries);
+
+        let run_path = scratch.path(&format!("run_{}", run_paths.len()));
+        write_run(&run_path, &entries)?;
+        run_paths.push(run_path);
+    }
+
+    // merge runs into matrix sections
+    let sections = MatrixSections::create(&scratch, domain.dofs.len())?;
+    let sections = merge_runs(&run_paths, sections)?;
+    for run_path in run_paths {
+        fs::remove_file(run_path)?;
+    }
+
+    // assemble the matrix files
+    let nnz = sections.nnz;
+    let header = petsc_matrix_header(domain.dofs.len(), nnz)?;
+    for (path, values_path) in [
+        (a_path.as_ref(), &sections.a_values_path),
+        (b_path.as_ref(), &sections.b_values_path),
+    ] {
+        let mut file = BufWriter::new(File::create(path)?);
+        file.write_all(header.as_ref())?;
+        for count in sections.row_counts.iter() {
+            file.write_all(&count.to_be_bytes())?;
+        }
+        io::copy(&mut File::open(&sections.cols_path)?, &mut file)?;
+        io::copy(&mut File::open(values_path)?, &mut file)?;
+        file.flush()?;
+    }
+
+    Ok(OutOfCoreGEP {
+        dimension: domain.dofs.len(),
+        nnz,
+        a_path: a_path.as_ref().to_path_buf(),
+        b_path: b_path.as_ref().to_path_buf(),
+    })
+}
+
+// An entry of both the A and B matrices
+#[derive(Clone, Copy, Debug, PartialEq)]
+struct Entry {
+    coords: [u32; 2],
+    values: [f64; 2],
+}
+
+/// Size of an [Entry] in a run file in bytes
+const RUN_ENTRY_SIZE: usize = 24;
+
+impl Entry {
+    fn encode(&self, buf: &mut [u8]) {
+        buf[0..4].copy_from_slice(&self.coords[0].to_le_bytes());
+        buf[4..8].copy_from_slice(&self.coords[1].to_le_bytes());
+        buf[8..16].copy_from_slice(&self.values[0].to_le_bytes());
+        buf[16..24].copy_from_slice(&self.values[1].to_le_bytes());
+    }
+
+    fn decode(buf: &[u8]) -> Self {
+        Self {
+            coords: [
+                u32::from_le_bytes(buf[0..4].try_into().unwrap()),
+                u32::from_le_bytes(buf[4..8].try_into().unwrap()),
+            ],
+            values: [
+                f64::from_le_bytes(buf[8..16].try_into().unwrap()),
+                f64::from_le_bytes(buf[16..24].try_into().unwrap()),
+            ],
+        }
+    }
+}
+
+// Expand the upper parts of a pair of ElemMatrices into entries of the full (both triangles) matrices
+fn full_entries(a_matrix: &ElemMatrix, b_matrix: &ElemMatrix) -> Vec<Entry> {
+    let mut entries = Vec::with_capacity(2 * a_matrix.num_rows() * a_matrix.num_cols());
+    for (([r, c], a), b) in a_matrix.iter_upper().zip(b_matrix.upper_values()) {
+        let [r, c] = [r as u32, c as u32];
+        entries.push(Entry {
+            coords: [r, c],
+            values: [a, b],
+        });
+        if r != c {
+            entries.push(Entry {
+                coords: [c, r],
+                values: [a, b],
+            });
+        }
+    }
+    entries
+}
+
+// Split the Elems into contiguous batches, each producing at most `max_entries` entries (every batch holds at least one Elem)
+fn entry_batches(
+    domain: &Domain,
+    elem_descendants: &[Vec<usize>],
+    max_entries: usize,
+) -> Vec<std::ops::Range<usize>> {
+    let elem_entries = |elem_id: usize| {
+        let num_rows = domain.basis_specs[elem_id].len();
+        let num_cols = num_rows
+            + elem_descendants[elem_id]
+                .iter()
+                .map(|desc_id| domain.basis_specs[*desc_id].len())
+                .sum::<usize>();
+        2 * num_rows * num_cols
+    };
+
+    let mut batches = Vec::new();
+    let mut batch_start = 0;
+    let mut batch_entries = 0;
+    for elem_id in 0..domain.mesh.elems.len() {
+        let entries = elem_entries(elem_id);
+        if batch_entries + entries > max_entries && elem_id > batch_start {
+            batches.push(batch_start..elem_id);
+            batch_start = elem_id;
+            batch_entries = 0;
+        }
+        batch_entries += entries;
+    }
+    if batch_start < domain.mesh.elems.len() {
+        batches.push(batch_start..domain.mesh.elems.len());
+    }
+    batches
+}
+
+// Sum adjacent entries with the same coordinates (the entries must already be sorted)
+fn combine_duplicates(entries: &mut Vec<Entry>) {
+    entries.dedup_by(|next, kept| {
+        if next.coords == kept.coords {
+            kept.values[0] += next.values[0];
+            kept.values[1] += next.values[1];
+            true
+        } else {
+            false
+        }
+    });
+}
+
+fn write_run(path: &Path, entries: &[Entry]) -> io::Result<()> {
+    let mut file = BufWriter::new(File::create(path)?);
+    let mut buf = [0; RUN_ENTRY_SIZE];
+    for entry in entries {
+        entry.encode(&mut buf);
+        file.write_all(&buf)?;
+    }
+    file.flush()
+}
+
+// Sequential reader over the entries of a run file
+struct RunReader {
+    reader: BufReader<File>,
+}
+
+impl RunReader {
+    fn open(path: &Path) -> io::Result<Self> {
+        Ok(Self {
+            reader: BufReader::new(File::open(path)?),
+        })
+    }
+
+    fn next_entry(&mut self) -> io::Result<Option<Entry>> {
+        let mut buf = [0; RUN_ENTRY_SIZE];
+        match self.reader.read_exact(&mut buf) {
+            Ok(()) => Ok(Some(Entry::decode(&buf))),
+            Err(err) if err.kind() == io::ErrorKind::UnexpectedEof => Ok(None),
+            Err(err) => Err(err),
+        }
+    }
+}
+
+// The row counts of the merged matrices (held in memory), along with their column indices and values (streamed to scratch files) in PETSc's big-endian encoding
+struct MatrixSections {
+    row_counts: Vec<u32>,
+    nnz: usize,
+    cols_path: PathBuf,
+    a_values_path: PathBuf,
+    b_values_path: PathBuf,
+    writers: [BufWriter<File>; 3],
+}
+
+impl MatrixSections {
+    fn create(scratch: &ScratchDir, dimension: usize) -> io::Result<Self> {
+        let [cols_path, a_values_path, b_values_path] =
+            ["cols", "a_values", "b_values"].map(|name| scratch.path(name));
+        Ok(Self {
+            row_counts: vec![0; dimension],
+            nnz: 0,
+            writers: [
+                BufWriter::new(File::create(&cols_path)?),
+                BufWriter::new(File::create(&a_values_path)?),
+                BufWriter::new(File::create(&b_values_path)?),
+            ],
+            cols_path,
+            a_values_path,
+            b_values_path,
+        })
+    }
+
+    fn push(&mut self, entry: Entry) -> io::Result<()> {
+        let [cols, a_values, b_values] = &mut self.writers;
+        self.row_counts[entry.coords[0] as usize] += 1;
+        self.nnz += 1;
+        cols.write_all(&entry.coords[1].to_be_bytes())?;
+        a_values.write_all(&entry.values[0].to_be_bytes())?;
+        b_values.write_all(&entry.values[1].to_be_bytes())
+    }
+
+    fn finish(mut self) -> io::Result<Self> {
+        for writer in self.writers.iter_mut() {
+            writer.flush()?;
+        }
+        Ok(self)
+    }
+}
+
+// Merge the sorted runs into a single sorted stream of entries (summing entries with the same coordinates)
+fn merge_runs(run_paths: &[PathBuf], mut sections: MatrixSections) -> io::Result<MatrixSections> {
+    let mut readers = run_paths
+        .iter()
+        .map(|path| RunReader::open(path))
+        .collect::<io::Result<Vec<_>>>()?;
+
+    // the next entry from each run, ordered by coordinates
+    let mut heap = BinaryHeap::with_capacity(readers.len());
+    let mut heads: Vec<Option<Entry>> = Vec::with_capacity(readers.len());
+    for (run_idx, reader) in readers.iter_mut().enumerate() {
+        let head = reader.next_entry()?;
+        if let Some(entry) = head {
+            heap.push(Reverse((entry.coords, run_idx)));
+        }
+        heads.push(head);
+    }
+
+    let mut pending: Option<Entry> = None;
+    while let Some(Reverse((_, run_idx))) = heap.pop() {
+        let entry = heads[run_idx].take().unwrap();
+        heads[run_idx] = readers[run_idx].next_entry()?;
+        if let Some(next) = heads[run_idx] {
+            heap.push(Reverse((next.coords, run_idx)));
+        }
+
+        pending = match pending {
+            Some(mut current) if current.coords == entry.coords => {
+                current.values[0] += entry.values[0];
+                current.values[1] += entry.values[1];
+                Some(current)
+            }
+            Some(current) => {
+                sections.push(current)?;
+                Some(entry)
+            }
+            None => Some(entry),
+        };
+    }
+    if let Some(current) = pending {
+        sections.push(current)?;
+    }
+
+    sections.finish()
+}
+
+// A uniquely named directory for temporary files, which is removed when dropped
+struct ScratchDir {
+    path: PathBuf,
+}
+
+impl ScratchDir {
+    fn new(parent: &Path) -> io::Result<Self> {
+        let nanos = std::time::SystemTime::now()
+            .duration_since(std::time::SystemTime::UNIX_EPOCH)
+            .unwrap()
+            .subsec_nanos();
+        let path = parent.join(format!("fem_2d_ooc_{}_{}", std::process::id(), nanos));
+        fs::create_dir_all(&path)?;
+        Ok(Self { path })
+    }
+
+    fn path(&self, name: &str) -> PathBuf {
+        self.path.join(format!("{}.bin", name))
+    }
+}
+
+impl Drop for ScratchDir {
+    fn drop(&mut self) {
+        let _ = fs::remove_dir_all(&self.path);
+    }
+}
+
+#[derive(Debug)]
+pub enum OutOfCoreError {
+    Sampling(GalerkinSamplingError),
+    IO(io::Error),
+}
+
+impl std::error::Error for OutOfCoreError {}
+
+impl fmt::Display for OutOfCoreError {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        match self {
+            Self::Sampling(err) => write!(f, "{}", err),
+            Self::IO(err) => write!(f, "Out-of-Core Assembly IO Error: {}", err),
+        }
+    }
+}
+
+impl From<GalerkinSamplingError> for OutOfCoreError {
+    fn from(err: GalerkinSamplingError) -> Self {
+        Self::Sampling(err)
+    }
+}
+
+impl From<io::Error> for OutOfCoreError {
+    fn from(err: io::Error) -> Self {
+        Self::IO(err)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::fem_domain::basis::hierarchical_basis_fns::poly::HierPoly;
+    use crate::fem_domain::domain::{
+        mesh::{h_refinement::HRef, p_refinement::PRef, Mesh},
+        ContinuityCondition,
+    };
+    use crate::fem_problem::galerkin::galerkin_sample_gep_hcurl;
+    use crate::fem_problem::integration::integrals::{curl_curl::CurlCurl, inner::L2Inner};
+    use crate::fem_problem::linalg::sparse_matrix::AIJMatrixBinary;
+
+    #[test]
+    fn out_of_core_assembly() {
+        let mut mesh = Mesh::from_file("./test_input/test_mesh_b.json").unwrap();
+        mesh.global_p_refinement(PRef::from(2, 2));
+        mesh.global_h_refinement(HRef::T);
+        mesh.h_refine_elems(vec![6, 9, 12], HRef::T).unwrap();
+        let domain = Domain::from_mesh(mesh, ContinuityCondition::HCurl);
+
+        let settings = OutOfCoreSettings {
+            scratch_dir: PathBuf::from("./test_output"),
+            memory_budget: 1 << 16,
+        };
+        assert!(
+            entry_batches(
+                &domain,
+                &elem_descendants(&domain),
+                settings.memory_budget / std::mem::size_of::<Entry>()
+            )
+            .len()
+                > 1
+        );
+
+        let ooc_gep = galerkin_sample_gep_hcurl_out_of_core::<HierPoly, CurlCurl, L2Inner>(
+            &domain,
+            Some([8, 8]),
+            &settings,
+            "./test_output/ooc_a.dat",
+            "./test_output/ooc_b.dat",
+        )
+        .unwrap();
+
+        let gep = galerkin_sample_gep_hcurl::<HierPoly, CurlCurl, L2Inner>(&domain, Some([8, 8]))
+            .unwrap();
+        let [a, b]: [AIJMatrixBinary; 2] = [gep.a.into(), gep.b.into()];
+
+        for (expected, path) in [(a, &ooc_gep.a_path), (b, &ooc_gep.b_path)] {
+            let computed = AIJMatrixBinary::read_from_petsc_binary_file(path).unwrap();
+            assert_eq!(computed.dim, expected.dim);
+            assert_eq!(computed.a.len(), ooc_gep.nnz);
+            assert_eq!(computed.i, expected.i);
+            assert_eq!(computed.j, expected.j);
+            for (e, c) in expected.a.iter().zip(computed.a.iter()) {
+                assert!((e - c).abs() < 1e-12 * (1.0 + e.abs()));
+            }
+            fs::remove_file(path).unwrap();
+        }
+    }
+}
@@ -0,0 +1,421 @@
+use super::{parse_glq_grid_dim, GalerkinSamplingError};
+use crate::fem_domain::{
+    basis::{BasisFnSampler, HierCurlBasisFn, HierCurlBasisFnSpace},
+    domain::{
+        dof::basis_spec::BasisSpec, mesh::element::Materials, renumbering::DoFOrdering, Domain,
+    },
+};
+use crate::fem_problem::integration::HierCurlIntegral;
+use crate::fem_problem::linalg::{
+    csr_matrix::CsrMatrix,
+    multifrontal::{MultifrontalLDL, SymbolicLDL},
+    skyline::FactorizationError,
+};
+use rayon::prelude::*;
+use std::fmt;
+use std::sync::Arc;
+
+/// Map a solution vector from a [Domain] onto the DoFs of a refined copy of that Domain
+///
+/// `new_domain` must be constructed from the mesh of `old_domain` after some number of h- and p-refinements (i.e. every `Elem` of the old mesh is still present with the same ID).
+/// The result is a good initial vector for an iterative solve over the refined Domain (see: [lanczos_solve_gep_k_with_initial_vector](crate::fem_problem::linalg::lanczos_solve::lanczos_solve_gep_k_with_initial_vector)).
+///
+/// Because the basis is hierarchical, a DoF whose Basis Functions are unchanged by the refinements (e.g. all DoFs after p-refinements) keeps its value,
+/// and DoFs introduced by the refinements are zero. This is computed directly when every old DoF survives.
+///
+/// Otherwise (after h-refinements, which replace the DoFs on refined `Elem`s), the old solution is projected onto the refined basis: `B c = ∫ φ_new · u_old`,
+/// where `B` is the B-Matrix of the refined problem (`new_b`) and `BI` is the integral used to compute it. The cross integrals are computed over each overlapping pair of `Elem`s,
+/// as in Galerkin Sampling, and `B` is factored with a [MultifrontalLDL].
+/// If the refined basis space contains the old one, both approaches reproduce the old solution exactly.
+///
+/// The symbolic analysis and factorization of `B` are recomputed on every call that needs them. To prolong several vectors onto the same Domain,
+/// factor `B` once and use [prolong_eigenvector_with_factorization] instead.
+pub fn prolong_eigenvector<BSpace, BI>(
+    old_domain: &Domain,
+    old_vector: &[f64],
+    new_domain: &Domain,
+    new_b: &CsrMatrix,
+    glq_grid_dim: Option<[usize; 2]>,
+) -> Result<Vec<f64>, ProlongationError>
+where
+    BSpace: HierCurlBasisFnSpace,
+    BI: HierCurlIntegral,
+{
+    assert_eq!(
+        new_b.dimension(),
+        new_domain.dofs.len(),
+        "B-Matrix dimension does not match the number of DoFs in the new Domain; cannot prolong!"
+    );
+    prolong::<BSpace, BI>(old_domain, old_vector, new_domain, glq_grid_dim, |rhs| {
+        let symbolic = Arc::new(SymbolicLDL::new(
+            &[new_b.pattern()],
+            DoFOrdering::NestedDissection,
+        ));
+        Ok(MultifrontalLDL::new(&symbolic, new_b)?.solve(rhs))
+    })
+}
+
+/// Like [prolong_eigenvector], except that an existing factorization of the refined problem's B-Matrix is used for the projection (if one is needed)
+///
+/// The factorization can be computed over any analysis that includes B's pattern, such as `SymbolicLDL::from_gep(&new_gep)`,
+/// which can also be used to factor the shifted matrix `A - σB` (see: [MultifrontalLDL::shifted]).
+pub fn prolong_eigenvector_with_factorization<BSpace, BI>(
+    old_domain: &Domain,
+    old_vector: &[f64],
+    new_domain: &Domain,
+    new_b_factorization: &MultifrontalLDL,
+    glq_grid_dim: Option<[usize; 2]>,
+) -> Result<Vec<f64>, ProlongationError>
+where
+    BSpace: HierCurlBasisFnSpace,
+    BI: HierCurlIntegral,
+{
+    assert_eq!(
+        new_b_factorization.dimension(),
+        new_domain.dofs.len(),
+        "B-Matrix factorization dimension does not match the number of DoFs in the new Domain; cannot prolong!"
+    );
+    prolong::<BSpace, BI>(old_domain, old_vector, new_domain, glq_grid_dim, |rhs| {
+        Ok(new_b_factorization.solve(rhs))
+    })
+}
+
+// Copy the surviving DoFs' values, or project the old solution (applying `b_solve` to the cross products) if any DoFs were replaced
+fn prolong<BSpace, BI>(
+    old_domain: &Domain,
+    old_vector: &[f64],
+    new_domain: &Domain,
+    glq_grid_dim: Option<[usize; 2]>,
+    b_solve: impl FnOnce(&[f64]) -> Result<Vec<f64>, ProlongationError>,
+) -> Result<Vec<f64>, ProlongationError>
+where
+    BSpace: HierCurlBasisFnSpace,
+    BI: HierCurlIntegral,
+{
+    assert_eq!(
+        old_vector.len(),
+        old_domain.dofs.len(),
+        "Vector length does not match the number of DoFs in the old Domain; cannot prolong!"
+    );
+    check_meshes(old_domain, new_domain)?;
+
+    let matching_dofs = matching_dofs(old_domain, new_domain);
+    if matching_dofs.iter().all(Option::is_some) {
+        let mut new_vector = vec![0.0; new_domain.dofs.len()];
+        for (value, new_dof) in old_vector.iter().zip(matching_dofs) {
+            new_vector[new_dof.unwrap()] = *value;
+        }
+        return Ok(new_vector);
+    }
+
+    let rhs =
+        sample_cross_products::<BSpace, BI>(old_domain, old_vector, new_domain, glq_grid_dim)?;
+    b_solve(&rhs)
+}
+
+// Ensure that each Elem in the old mesh is present (with the same ID) in the new mesh
+fn check_meshes(old_domain: &Domain, new_domain: &Domain) -> Result<(), ProlongationError> {
+    if old_domain.mesh.elems.len() > new_domain.mesh.elems.len() {
+        return Err(ProlongationError::IncompatibleMeshes);
+    }
+
+    let compatible = old_domain
+        .mesh
+        .elems
+        .iter()
+        .zip(new_domain.mesh.elems.iter())
+        .all(|(old_elem, new_elem)| {
+            old_elem.nodes == new_elem.nodes && old_elem.parent_id() == new_elem.parent_id()
+        });
+
+    if compatible {
+        Ok(())
+    } else {
+        Err(ProlongationError::IncompatibleMeshes)
+    }
+}
+
+// The new DoF made up of exactly the same BasisSpecs as each old DoF (if there is one)
+fn matching_dofs(old_domain: &Domain, new_domain: &Domain) -> Vec<Option<usize>> {
+    let same_fn =
+        |a: &BasisSpec, b: &BasisSpec| a.i == b.i && a.j == b.j && a.dir == b.dir && a.loc == b.loc;
+
+    old_domain
+        .dofs
+        .par_iter()
+        .map(|old_dof| {
+            let addresses = old_dof.get_basis_specs();
+            let mut new_dof_ids = addresses.iter().map(|address| {
+                let old_bs = &old_domain.basis_specs[address.elem_id][address.elem_idx];
+                new_domain.basis_specs[address.elem_id]
+                    .iter()
+                    .find(|new_bs| same_fn(old_bs, new_bs))
+                    .map(|new_bs| new_bs.dof_id.unwrap())
+            });
+
+            let new_dof_id = new_dof_ids.next().flatten()?;
+            if new_dof_ids.all(|id| id == Some(new_dof_id))
+                && new_domain.dofs[new_dof_id].get_basis_specs().len() == addresses.len()
+            {
+                Some(new_dof_id)
+            } else {
+                None
+            }
+        })
+        .collect()
+}
+
+// Compute the integral of each new DoF's Basis Function(s) against the old solution: ∫ φ_new · u_old
+//
+// Each pair of old and new BasisSpecs overlaps if one of their Elems is the other or one of its ancestors. The coarser Basis Function is sampled over the finer Elem.
+fn sample_cross_products<BSpace, BI>(
+    old_domain: &Domain,
+    old_vector: &[f64],
+    new_domain: &Domain,
+    glq_grid_dim: Option<[usize; 2]>,
+) -> Result<Vec<f64>, GalerkinSamplingError>
+where
+    BSpace: HierCurlBasisFnSpace,
+    BI: HierCurlIntegral,
+{
+    let [num_glq_u, num_glq_v] = parse_glq_grid_dim(glq_grid_dim)?;
+    let [old_i_max, old_j_max] = old_domain.mesh.max_expansion_orders();
+    let [new_i_max, new_j_max] = new_domain.mesh.max_expansion_orders();
+    let (bf_sampler, [u_weights, v_weights]) = BasisFnSampler::<HierCurlBasisFn<BSpace>>::with(
+        old_i_max.max(new_i_max) as usize,
+        old_j_max.max(new_j_max) as usize,
+        num_glq_u,
+        num_glq_v,
+        false,
+    );
+    let integrator = BI::with_weights(&u_weights, &v_weights);
+
+    let has_old_basis_specs = |elem_id: &usize| {
+        *elem_id < old_domain.basis_specs.len() && !old_domain.basis_specs[*elem_id].is_empty()
+    };
+    let elems = &new_domain.mesh.elems;
+
+    let entries: Vec<Vec<(usize, f64)>> = elems
+        .par_iter()
+        .filter(|elem| !new_domain.basis_specs[elem.id].is_empty())
+        .map_with(bf_sampler, |bf_sampler, new_elem| {
+            let new_basis_specs = &new_domain.basis_specs[new_elem.id];
+            let mut entries = Vec::new();
+            let mut add_products = |old_elem_id: usize,
+                                    old_basis: &HierCurlBasisFn<BSpace>,
+                                    new_basis: &HierCurlBasisFn<BSpace>,
+                                    materials: &Materials| {
+                for old_bs in old_domain.basis_specs[old_elem_id].iter() {
+                    let coeff = old_vector[old_bs.dof_id.unwrap()];
+                    if coeff == 0.0 {
+                        continue;
+                    }
+                    let (p_orders, p_dir, _) = old_bs.integration_data();
+
+                    for new_bs in new_basis_specs.iter() {
+                        let (q_orders, q_dir, _) = new_bs.integration_data();
+                        if integrator.is_structurally_zero(p_dir, q_dir) {
+                            continue;
+                        }
+                        let value = integrator
+                            .integrate(
+                                p_dir, q_dir, p_orders, q_orders, old_basis, new_basis, materials,
+                            )
+                            .full_solution();
+                        entries.push((new_bs.dof_id.unwrap(), coeff * value));
+                    }
+                }
+            };
+
+            // old Elems covering this Elem (itself or one of its ancestors)
+            let new_local = bf_sampler.sample_basis_fn(new_elem, None);
+            for old_elem_id in new_elem
+                .loc_stack()
+                .iter()
+                .map(|(ancestor_id, _)| *ancestor_id)
+                .chain(std::iter::once(new_elem.id))
+                .filter(has_old_basis_specs)
+            {
+                let old_elem = &elems[old_elem_id];
+                let old_sampled = if old_elem_id == new_elem.id {
+                    new_local.clone()
+                } else {
+                    bf_sampler.sample_basis_fn(old_elem, Some(new_elem))
+                };
+                add_products(
+                    old_elem_id,
+                    &old_sampled,
+                    &new_local,
+                    old_elem.get_materials(),
+                );
+            }
+
+            // old Elems within this Elem
+            for old_elem_id in new_domain
+                .mesh
+                .descendant_elems(new_elem.id, false)
+                .unwrap()
+                .into_iter()
+                .filter(has_old_basis_specs)
+            {
+                let old_elem = &elems[old_elem_id];
+                let old_local = bf_sampler.sample_basis_fn(old_elem, None);
+                let new_sampled = bf_sampler.sample_basis_fn(new_elem, Some(old_elem));
+                add_products(
+                    old_elem_id,
+                    &old_local,
+                    &new_sampled,
+                    new_elem.get_materials(),
+                );
+            }
+
+            entries
+        })
+        .collect();
+
+    let mut rhs = vec![0.0; new_domain.dofs.len()];
+    for (dof_id, value) in entries.into_iter().flatten() {
+        rhs[dof_id] += value;
+    }
+    Ok(rhs)
+}
+
+#[derive(Debug)]
+/// Error type for Eigenvector prolongation
+pub enum ProlongationError {
+    /// The new Domain's mesh is not a refinement of the old Domain's mesh
+    IncompatibleMeshes,
+    Sampling(GalerkinSamplingError),
+    /// The B-Matrix of the refined problem could not be factored
+    FailedToFactor(FactorizationError),
+}
+
+impl std::error::Error for ProlongationError {}
+
+impl fmt::Display for ProlongationError {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        match self {
+            Self::IncompatibleMeshes => write!(
+                f,
+                "New Domain's mesh is not a refinement of the old Domain's mesh; cannot prolong!"
+            ),
+            Self::Sampling(err) => write!(f, "{}", err),
+            Self::FailedToFactor(err) => write!(f, "Failed to factor B-Matrix: {}", err),
+        }
+    }
+}
+
+impl From<GalerkinSamplingError> for ProlongationError {
+    fn from(err: GalerkinSamplingError) -> Self {
+        Self::Sampling(err)
+    }
+}
+
+impl From<FactorizationError> for ProlongationError {
+    fn from(err: FactorizationError) -> Self {
+        Self::FailedToFactor(err)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::fem_domain::basis::hierarchical_basis_fns::poly::HierPoly;
+    use crate::fem_domain::domain::{
+        mesh::{h_refinement::HRef, p_refinement::PRef, Mesh},
+        ContinuityCondition,
+    };
+    use crate::fem_problem::galerkin::galerkin_sample_gep_hcurl;
+    use crate::fem_problem::integration::integrals::{curl_curl::CurlCurl, inner::L2Inner};
+    use crate::fem_problem::linalg::lanczos_solve::{
+        lanczos_solve_gep, lanczos_solve_gep_k_with_stats, LanczosSettings,
+    };
+    use crate::fem_problem::linalg::GEP;
+
+    fn coarse_mesh() -> Mesh {
+        let mut mesh = Mesh::from_file("./test_input/test_mesh_a.json").unwrap();
+        mesh.global_p_refinement(PRef::from(2, 2));
+        mesh
+    }
+
+    fn rayleigh_quotient(gep: &GEP, x: &[f64]) -> f64 {
+        let [ax, bx] = gep.mul_vec(x);
+        let dot = |a: &[f64], b: &[f64]| a.iter().zip(b.iter()).map(|(a, b)| a * b).sum::<f64>();
+        dot(x, &ax) / dot(x, &bx)
+    }
+
+    #[test]
+    fn prolong_after_refinement() {
+        let old_domain = Domain::from_mesh(coarse_mesh(), ContinuityCondition::HCurl);
+        let old_gep =
+            galerkin_sample_gep_hcurl::<HierPoly, CurlCurl, L2Inner>(&old_domain, Some([8, 8]))
+                .unwrap();
+        let old_solution = lanczos_solve_gep(&old_gep, 2.64).unwrap();
+
+        let mut p_refined = coarse_mesh();
+        p_refined.global_p_refinement(PRef::from(1, 1));
+        let mut h_refined = coarse_mesh();
+        h_refined.global_h_refinement(HRef::T);
+
+        for new_mesh in [p_refined, h_refined] {
+            let new_domain = Domain::from_mesh(new_mesh, ContinuityCondition::HCurl);
+            let new_gep =
+                galerkin_sample_gep_hcurl::<HierPoly, CurlCurl, L2Inner>(&new_domain, Some([8, 8]))
+                    .unwrap();
+
+            let initial_vector = prolong_eigenvector::<HierPoly, L2Inner>(
+                &old_domain,
+                &old_solution.vector,
+                &new_domain,
+                &new_gep.b,
+                Some([8, 8]),
+            )
+            .unwrap();
+
+            // the coarse solution is reproduced exactly in the refined space
+            assert!(
+                (rayleigh_quotient(&new_gep, &initial_vector) - old_solution.value).abs() < 1e-8
+            );
+
+            // a factorization of B (over an analysis shared with A - σB) gives the same result
+            let symbolic = Arc::new(SymbolicLDL::from_gep(&new_gep));
+            let b_factorization = MultifrontalLDL::new(&symbolic, &new_gep.b).unwrap();
+            let factored_initial_vector =
+                prolong_eigenvector_with_factorization::<HierPoly, L2Inner>(
+                    &old_domain,
+                    &old_solution.vector,
+                    &new_domain,
+                    &b_factorization,
+                    Some([8, 8]),
+                )
+                .unwrap();
+            assert!(initial_vector
+                .iter()
+                .zip(factored_initial_vector.iter())
+                .all(|(a, b)| (a - b).abs() < 1e-10));
+
+            // a small subspace forces restarts, so that the savings show up in both counts
+            let settings = LanczosSettings {
+                max_subspace_dim: 4,
+                ..Default::default()
+            };
+            let (warm_solution, warm_stats) =
+                lanczos_solve_gep_k_with_stats(&new_gep, 2.64, 1, Some(&initial_vector), settings)
+                    .unwrap();
+            let (cold_solution, cold_stats) =
+                lanczos_solve_gep_k_with_stats(&new_gep, 2.64, 1, None, settings).unwrap();
+            assert!((warm_solution[0].value - cold_solution[0].value).abs() < 1e-8);
+            assert!((warm_solution[0].value - old_solution.value).abs() < 1e-2);
+            assert!(warm_solution[0].residual_norm(&new_gep) < 1e-8);
+
+            // the prolonged vector saves work
+            assert!(
+                warm_stats.restarts < cold_stats.restarts
+                    && warm_stats.iterations < cold_stats.iterations,
+                "warm start ({:?}) should be cheaper than a cold start ({:?})",
+                warm_stats,
+                cold_stats
+            );
+        }
+    }
+}
@@ -87,4 +87,11 @@ pub trait HierCurlIntegral: Sync + Send {
         q_basis: &HierCurlBasisFn<BSpace>,
         materials: &Materials,
     ) -> IntegralResult;
+
+    /// Check whether the integral between basis functions with directions P and Q is zero regardless of their orders, the geometry, or the materials
+    ///
+    /// Integration is skipped for such pairs. The default implementation never predicts a structural zero.
+    fn is_structurally_zero(&self, _p_dir: BasisDir, _q_dir: BasisDir) -> bool {
+        false
+    }
 }
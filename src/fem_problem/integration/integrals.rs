@@ -23,6 +23,11 @@ pub mod curl_curl {
             }
         }
 
+        fn is_structurally_zero(&self, p_dir: BasisDir, q_dir: BasisDir) -> bool {
+            // W-directed basis functions are not integrated
+            p_dir == BasisDir::W || q_dir == BasisDir::W
+        }
+
         fn integrate<BSpace: HierCurlBasisFnSpace>(
             &self,
             p_dir: BasisDir,
@@ -289,6 +294,11 @@ pub mod inner {
             }
         }
 
+        fn is_structurally_zero(&self, p_dir: BasisDir, q_dir: BasisDir) -> bool {
+            // W-directed basis functions are not integrated
+            p_dir == BasisDir::W || q_dir == BasisDir::W
+        }
+
         fn integrate<BSpace: HierCurlBasisFnSpace>(
             &self,
             p_dir: BasisDir,
@@ -1,5 +1,25 @@
+/// Block-Sparse Matrix with variable-size dense blocks aligned to groups of DoFs
+pub mod bsr_matrix;
+/// Unordered Coordinate-form entries, sorted into Compressed-Row form
+pub mod coo_matrix;
+/// Compressed-Row Matrix over a precomputed Sparsity Pattern
+pub mod csr_matrix;
+/// Dense blocks of values computed over individual Elems
+pub mod elem_matrix;
+/// An in-process shift-invert Lanczos solver for GEPs
+pub mod lanczos_solve;
+/// A LOBPCG solver for several of the smallest Eigenpairs of a GEP
+pub mod lobpcg_solve;
+/// Supernodal Multifrontal LDLᵀ factorization of sparse symmetric matrices
+pub mod multifrontal;
 /// An Nalgebra Eigen decomposition to solve a GEP (not recommended)
 pub mod nalgebra_solve;
+/// Linear Operator interfaces for iterative solvers
+pub mod operator;
+/// Preconditioners for iterative solvers
+pub mod preconditioner;
+/// Profile (Skyline) LDLᵀ factorization of sparse symmetric matrices
+pub mod skyline;
 /// Link to an External SLEPc solver to solve a GEP
 ///
 /// This module relies on an external SLEPc solver. Source code and installation instructions are found [here](https://github.com/jeremiah-corrado/slepc_gep_solver/blob/main/README.md)
@@ -13,14 +33,23 @@ pub mod nalgebra_solve;
 /// 3. If the solver is successful, the solution is retrieved from the `/tmp/` directory and returned
 /// 4. All Matrix and Vector files are then deleted from the `/tmp/` directory
 ///
+/// When several Eigenpairs are requested (`slepc_solve_gep_k`), the solver is also passed `-nev k`, and is expected to write its Eigenvalues to `{prefix}_eval.dat` (as big-endian doubles)
+/// and each Eigenvector to `{prefix}_evec_{i}.dat`. This requires a version of the solver that supports the `-nev` option.
+///
+/// An initial vector can also be provided (`slepc_solve_gep_k_with_initial_vector`), which is written to `{prefix}_init.dat` (the solver is passed `-init`).
+///
+/// Alternatively, `SlepcTransport::Pipes` streams the matrices to the solver's stdin and reads the Eigenpairs from its stdout, so that steps 1 and 4 are skipped entirely.
+///
 pub mod slepc_solve;
 /// Sparsely Packed Matrix
 pub mod sparse_matrix;
 
+use csr_matrix::{CsrMatrix, SparsityPattern};
+use elem_matrix::ElemMatrix;
 use nalgebra::DMatrix;
 use rayon::prelude::*;
-use sparse_matrix::{AIJMatrixBinary, SparseMatrix};
-use std::sync::mpsc::channel;
+use sparse_matrix::AIJMatrixBinary;
+use std::sync::{mpsc::channel, Arc};
 
 /// Generalized Eigenvalue Problem
 ///
@@ -28,16 +57,61 @@ use std::sync::mpsc::channel;
 #[derive(Clone)]
 pub struct GEP {
     /// A Matrix
-    pub a: SparseMatrix,
+    pub a: CsrMatrix,
     /// B Matrix
-    pub b: SparseMatrix,
+    pub b: CsrMatrix,
 }
 
 impl GEP {
-    pub fn new(num_dofs: usize) -> Self {
+    /// Create a GEP with A and B matrices of zeros over the given [SparsityPattern]
+    ///
+    /// Both matrices share a single copy of the pattern; only their value arrays are stored separately
+    pub fn new(pattern: impl Into<Arc<SparsityPattern>>) -> Self {
+        let pattern = pattern.into();
         Self {
-            a: SparseMatrix::new(num_dofs),
-            b: SparseMatrix::new(num_dofs),
+            a: CsrMatrix::new(pattern.clone()),
+            b: CsrMatrix::new(pattern),
+        }
+    }
+
+    /// Size of the square matrices
+    pub fn dimension(&self) -> usize {
+        self.a.dimension()
+    }
+
+    /// The [SparsityPattern] of the A matrix (and the B matrix, if they share a pattern)
+    pub fn pattern(&self) -> &SparsityPattern {
+        self.a.pattern()
+    }
+
+    /// Compute the products of the A and B matrices with a vector: `[Ax, Bx]`
+    ///
+    /// If the matrices share a [SparsityPattern], both products are computed in a single pass over the index arrays
+    pub fn mul_vec(&self, x: &[f64]) -> [Vec<f64>; 2] {
+        if self.a.shares_pattern_with(&self.b) {
+            self.pattern()
+                .sym_mul_vecs([self.a.values(), self.b.values()], x)
+        } else {
+            [self.a.mul_vec(x), self.b.mul_vec(x)]
+        }
+    }
+
+    /// Add a pair of [ElemMatrix]s into the A and B matrices at precomputed storage slots, traversing the slots only once
+    ///
+    /// Panics if the A and B matrices do not share a [SparsityPattern]
+    pub fn scatter_to_slots(&mut self, [a_matrix, b_matrix]: &[ElemMatrix; 2], slots: &[usize]) {
+        assert!(
+            self.a.shares_pattern_with(&self.b),
+            "A and B matrices do not share a SparsityPattern; cannot scatter values!"
+        );
+
+        let [a_values, b_values] = [self.a.values_mut(), self.b.values_mut()];
+        for (&slot, (a, b)) in slots
+            .iter()
+            .zip(a_matrix.upper_values().zip(b_matrix.upper_values()))
+        {
+            a_values[slot] += a;
+            b_values[slot] += b;
         }
     }
 
@@ -56,27 +130,32 @@ impl GEP {
     }
 }
 
-impl ParallelExtend<[SparseMatrix; 2]> for GEP {
-    fn par_extend<I>(&mut self, elem_matrices_iter: I)
+/// [ElemMatrix]s to be added to the A and B matrices at the given storage slots (see: [CsrMatrix::scatter_to_slots])
+pub struct SlotGroups<'s> {
+    /// Storage slot of each value in the upper part of the [ElemMatrix]s
+    pub slots: &'s [usize],
+    /// A and B matrix values
+    pub matrices: [ElemMatrix; 2],
+}
+
+impl<'s> ParallelExtend<SlotGroups<'s>> for GEP {
+    fn par_extend<I>(&mut self, slot_groups_iter: I)
     where
-        I: IntoParallelIterator<Item = [SparseMatrix; 2]>,
+        I: IntoParallelIterator<Item = SlotGroups<'s>>,
     {
         let (sender, receiver) = channel();
 
-        elem_matrices_iter
+        slot_groups_iter
             .into_par_iter()
-            .for_each_with(sender, |s, elem_matrices| {
-                s.send(elem_matrices).expect(
+            .for_each_with(sender, |s, slot_groups| {
+                s.send(slot_groups).expect(
                     "Failed to send sub-matrices over MSPC channel; cannot construct Matrices!",
                 )
             });
 
-        receiver
-            .iter()
-            .for_each(|[mut elem_a_mat, mut elem_b_mat]| {
-                self.a.consume_matrix(&mut elem_a_mat);
-                self.b.consume_matrix(&mut elem_b_mat);
-            });
+        receiver.iter().for_each(|slot_groups| {
+            self.scatter_to_slots(&slot_groups.matrices, slot_groups.slots);
+        });
     }
 }
 
@@ -94,4 +173,81 @@ impl EigenPair {
         let norm = self.vector.iter().map(|x| x.powi(2)).sum::<f64>().sqrt();
         self.vector.iter().map(|x| x / norm).collect()
     }
+
+    /// B-normalized vector (such that `uᵀBu = 1`)
+    pub fn b_normalized_eigenvector(&self, b: &CsrMatrix) -> Vec<f64> {
+        let b_norm = dot(&self.vector, &b.mul_vec(&self.vector)).sqrt();
+        self.vector.iter().map(|x| x / b_norm).collect()
+    }
+
+    /// The L2 norm of the residual `Au - λBu` (computed with the B-normalized eigenvector)
+    pub fn residual_norm(&self, gep: &GEP) -> f64 {
+        let [au, bu] = gep.mul_vec(&self.vector);
+        let b_norm = dot(&self.vector, &bu).sqrt();
+
+        au.par_iter()
+            .zip(bu.par_iter())
+            .map(|(au_i, bu_i)| ((au_i - self.value * bu_i) / b_norm).powi(2))
+            .sum::<f64>()
+            .sqrt()
+    }
+}
+
+// Inner product of two vectors
+fn dot(x: &[f64], y: &[f64]) -> f64 {
+    x.par_iter()
+        .zip(y.par_iter())
+        .map(|(x_i, y_i)| x_i * y_i)
+        .sum()
+}
+
+// y += alpha * x
+fn axpy(alpha: f64, x: &[f64], y: &mut [f64]) {
+    y.par_iter_mut()
+        .zip(x.par_iter())
+        .for_each(|(y_i, x_i)| *y_i += alpha * x_i);
+}
+
+// Linear combination of vectors with the given coefficients
+fn combine<V: AsRef<[f64]> + Sync>(vectors: &[V], coeff: impl Fn(usize) -> f64) -> Vec<f64> {
+    let coeffs: Vec<f64> = (0..vectors.len()).map(coeff).collect();
+    (0..vectors[0].as_ref().len())
+        .into_par_iter()
+        .map(|r| {
+            vectors
+                .iter()
+                .zip(coeffs.iter())
+                .map(|(v, c)| v.as_ref()[r] * c)
+                .sum()
+        })
+        .collect()
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn eigenpair_residual() {
+        let dim = 6;
+        let pattern = SparsityPattern::from_coordinates(dim, (0..dim).map(|i| [i, i]));
+        let mut gep = GEP::new(pattern);
+        for i in 0..dim {
+            gep.a.insert([i, i], (i + 1) as f64);
+            gep.b.insert([i, i], 2.0);
+        }
+
+        let mut vector = vec![0.0; dim];
+        vector[2] = 5.0;
+        let pair = EigenPair { value: 1.5, vector };
+
+        assert!(pair.residual_norm(&gep) < 1e-14);
+        assert!((pair.b_normalized_eigenvector(&gep.b)[2] - 0.5_f64.sqrt()).abs() < 1e-14);
+
+        let wrong_pair = EigenPair {
+            value: 2.0,
+            vector: pair.vector,
+        };
+        assert!(wrong_pair.residual_norm(&gep) > 0.5);
+    }
 }
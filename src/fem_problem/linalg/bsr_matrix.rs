@@ -0,0 +1,546 @@
+use super::csr_matrix::{sym_accumulate, CsrMatrix, SparsityPattern, SpmvBlock, SPMV_BLOCK_SIZE};
+use super::operator::{GEPOperator, LinearOperator};
+use super::GEP;
+use crate::fem_domain::domain::{dof::basis_spec::BasisLoc, Domain};
+
+use rayon::prelude::*;
+use std::ops::Range;
+use std::sync::Arc;
+
+/// A partition of the rows (DoFs) of a matrix into contiguous blocks of variable size
+#[derive(Clone, Debug, PartialEq)]
+pub struct BlockPartition {
+    /// First row of each block (with one extra entry marking the end of the last block)
+    offsets: Vec<usize>,
+}
+
+impl BlockPartition {
+    /// Construct a partition from the first row of each block, followed by the matrix dimension
+    pub fn from_offsets(offsets: Vec<usize>) -> Self {
+        assert!(
+            offsets.first() == Some(&0) && offsets.windows(2).all(|w| w[0] < w[1]),
+            "Block offsets must start at zero and be strictly increasing; cannot construct BlockPartition!"
+        );
+        Self { offsets }
+    }
+
+    /// Partition the DoFs of a [Domain] into blocks that share a geometric component
+    ///
+    /// Each block is a maximal run of consecutive DoF IDs whose [BasisSpec](crate::fem_domain::domain::dof::basis_spec::BasisSpec)s are associated with the same `Elem` interior, `Edge`, or `Node`.
+    /// With the DoF numbering produced by [Domain::from_mesh], this groups all of the expansion orders on each component into a single block.
+    pub fn from_domain(domain: &Domain) -> Self {
+        let dof_components: Vec<(u8, usize)> = domain
+            .dofs
+            .par_iter()
+            .map(|dof| {
+                let address = dof.get_basis_specs()[0];
+                let bs = &domain.basis_specs[address.elem_id][address.elem_idx];
+                match bs.loc {
+                    BasisLoc::ElemBs => (0, bs.elem_id),
+                    BasisLoc::EdgeBs(_, edge_id) => (1, edge_id),
+                    BasisLoc::NodeBs(_, node_id) => (2, node_id),
+                }
+            })
+            .collect();
+
+        let mut offsets = vec![0];
+        for dof_id in 1..dof_components.len() {
+            if dof_components[dof_id] != dof_components[dof_id - 1] {
+                offsets.push(dof_id);
+            }
+        }
+        if !dof_components.is_empty() {
+            offsets.push(dof_components.len());
+        }
+
+        Self { offsets }
+    }
+
+    /// Size of the partitioned matrix
+    pub fn dimension(&self) -> usize {
+        *self.offsets.last().unwrap()
+    }
+
+    /// Number of blocks
+    pub fn num_blocks(&self) -> usize {
+        self.offsets.len() - 1
+    }
+
+    /// Rows in a particular block
+    pub fn range(&self, block_idx: usize) -> Range<usize> {
+        self.offsets[block_idx]..self.offsets[block_idx + 1]
+    }
+
+    /// Number of rows in a particular block
+    pub fn block_size(&self, block_idx: usize) -> usize {
+        self.offsets[block_idx + 1] - self.offsets[block_idx]
+    }
+
+    // Index of the block that each row belongs to
+    fn row_blocks(&self) -> Vec<u32> {
+        let mut row_blocks = Vec::with_capacity(self.dimension());
+        for block_idx in 0..self.num_blocks() {
+            row_blocks.extend(std::iter::repeat(block_idx as u32).take(self.block_size(block_idx)));
+        }
+        row_blocks
+    }
+}
+
+/// The locations of the dense blocks in the upper block-triangle of a square-symmetric matrix, stored in compressed-block-row form
+///
+/// Only one column index is stored for each block (rather than one for each entry). Diagonal blocks are stored in full (both triangles),
+/// such that every block can be applied with the same dense kernel.
+#[derive(Clone, Debug, PartialEq)]
+pub struct BlockSparsityPattern {
+    partition: BlockPartition,
+    /// Position of the first block of each block-row in `block_cols` (with one extra entry marking the end of the last block-row)
+    block_row_offsets: Vec<usize>,
+    /// Block-column index of each block
+    block_cols: Vec<u32>,
+    /// Position of the first value of each block (with one extra entry marking the end of the last block)
+    value_offsets: Vec<usize>,
+    /// Groups of block-rows handed out to threads in matrix-vector products (computed once, see: [BlockSparsityPattern::sym_mul_vecs])
+    spmv_blocks: Vec<SpmvBlock>,
+}
+
+impl BlockSparsityPattern {
+    /// Construct the block pattern which covers all entries of a scalar [SparsityPattern]
+    pub fn from_pattern(pattern: &SparsityPattern, partition: BlockPartition) -> Self {
+        assert_eq!(
+            pattern.dimension(),
+            partition.dimension(),
+            "BlockPartition does not match the SparsityPattern's dimension; cannot construct BlockSparsityPattern!"
+        );
+        let row_blocks = partition.row_blocks();
+
+        let block_rows: Vec<Vec<u32>> = (0..partition.num_blocks())
+            .into_par_iter()
+            .map(|block_row| {
+                let mut block_cols: Vec<u32> = partition
+                    .range(block_row)
+                    .flat_map(|r| pattern.row(r).iter().map(|c| row_blocks[*c as usize]))
+                    .collect();
+                block_cols.sort_unstable();
+                block_cols.dedup();
+                block_cols
+            })
+            .collect();
+
+        let mut block_row_offsets = Vec::with_capacity(block_rows.len() + 1);
+        let mut block_cols = Vec::new();
+        let mut value_offsets = vec![0];
+        block_row_offsets.push(0);
+
+        for (block_row, cols) in block_rows.iter().enumerate() {
+            let num_rows = partition.block_size(block_row);
+            for &block_col in cols.iter() {
+                let num_values = num_rows * partition.block_size(block_col as usize);
+                value_offsets.push(value_offsets.last().unwrap() + num_values);
+            }
+            block_cols.extend_from_slice(cols);
+            block_row_offsets.push(block_cols.len());
+        }
+
+        let mut pattern = Self {
+            partition,
+            block_row_offsets,
+            block_cols,
+            value_offsets,
+            spmv_blocks: Vec::new(),
+        };
+        pattern.spmv_blocks = pattern.block_row_groups(SPMV_BLOCK_SIZE);
+        pattern
+    }
+
+    /// Size of the square matrix
+    pub fn dimension(&self) -> usize {
+        self.partition.dimension()
+    }
+
+    /// The partition of the rows into blocks
+    pub fn partition(&self) -> &BlockPartition {
+        &self.partition
+    }
+
+    /// Number of blocks stored in the upper block-triangle
+    pub fn num_upper_blocks(&self) -> usize {
+        self.block_cols.len()
+    }
+
+    /// Number of values stored in all blocks
+    pub fn num_values(&self) -> usize {
+        *self.value_offsets.last().unwrap()
+    }
+
+    /// Block-column indices of the blocks on a particular block-row
+    pub fn block_row(&self, block_row: usize) -> &[u32] {
+        &self.block_cols[self.block_row_offsets[block_row]..self.block_row_offsets[block_row + 1]]
+    }
+
+    /// Get the storage index of a block (`block_row` must not be greater than `block_col`)
+    ///
+    /// Returns `None` if the block is not part of the pattern
+    pub fn block_slot(&self, [block_row, block_col]: [usize; 2]) -> Option<usize> {
+        self.block_row(block_row)
+            .binary_search(&(block_col as u32))
+            .ok()
+            .map(|offset| self.block_row_offsets[block_row] + offset)
+    }
+
+    // Partition the block-rows into contiguous groups, each holding roughly `values_per_group` values
+    fn block_row_groups(&self, values_per_group: usize) -> Vec<SpmvBlock> {
+        let num_block_rows = self.partition.num_blocks();
+        let block_row_values = |br: usize| self.value_offsets[self.block_row_offsets[br]];
+        let group = |group_start: usize, group_end: usize| {
+            let max_block_col = (group_start..group_end)
+                .filter_map(|br| self.block_row(br).last())
+                .map(|&bc| bc as usize)
+                .max()
+                .unwrap_or(group_end - 1)
+                .max(group_end - 1);
+            SpmvBlock {
+                rows: [group_start, group_end],
+                reach: [
+                    self.partition.range(group_start).start,
+                    self.partition.range(max_block_col).end,
+                ],
+            }
+        };
+
+        let mut groups = Vec::new();
+        let mut group_start = 0;
+        for br in 0..num_block_rows {
+            if block_row_values(br + 1) - block_row_values(group_start) >= values_per_group {
+                groups.push(group(group_start, br + 1));
+                group_start = br + 1;
+            }
+        }
+        if group_start < num_block_rows {
+            groups.push(group(group_start, num_block_rows));
+        }
+        groups
+    }
+
+    /// Multiply `N` symmetric matrices (whose upper block-triangles are stored over this pattern) by the vector `x`
+    ///
+    /// Groups of block-rows are processed in parallel. Diagonal blocks are applied directly, while each off-diagonal block `B` at `(r, c)`
+    /// is applied twice in a single pass over its values: `y_r += B x_c` and `y_c += Bᵀ x_r`.
+    /// The second set of contributions can overlap between threads, so each thread accumulates into its own result vectors (see: [sym_accumulate]).
+    pub(super) fn sym_mul_vecs<const N: usize>(
+        &self,
+        values: [&[f64]; N],
+        x: &[f64],
+    ) -> [Vec<f64>; N] {
+        assert_eq!(
+            x.len(),
+            self.dimension(),
+            "Vector length does not match the matrix dimension; cannot compute product!"
+        );
+
+        sym_accumulate(self.dimension(), &self.spmv_blocks, |group, offset, ys| {
+            for br in group.rows[0]..group.rows[1] {
+                let rows = self.partition.range(br);
+                let y_rows = (rows.start - offset)..(rows.end - offset);
+                for block_idx in self.block_row_offsets[br]..self.block_row_offsets[br + 1] {
+                    let bc = self.block_cols[block_idx] as usize;
+                    let cols = self.partition.range(bc);
+                    let value_range =
+                        self.value_offsets[block_idx]..self.value_offsets[block_idx + 1];
+
+                    for (vals, y) in values.iter().zip(ys.iter_mut()) {
+                        let block = &vals[value_range.clone()];
+                        if bc == br {
+                            dense_mul_add(block, &x[rows.clone()], &mut y[y_rows.clone()]);
+                        } else {
+                            // rows always precede cols, so the two result ranges can be borrowed separately
+                            let (y_lower, y_upper) = y.split_at_mut(cols.start - offset);
+                            dense_sym_mul_add(
+                                block,
+                                [&x[rows.clone()], &x[cols.clone()]],
+                                [&mut y_lower[y_rows.clone()], &mut y_upper[0..cols.len()]],
+                            );
+                        }
+                    }
+                }
+            }
+        })
+    }
+}
+
+// Dense row-major block kernel: y += Bx
+fn dense_mul_add(block: &[f64], x: &[f64], y: &mut [f64]) {
+    for (y_i, block_row) in y.iter_mut().zip(block.chunks_exact(x.len())) {
+        *y_i += block_row
+            .iter()
+            .zip(x.iter())
+            .map(|(b, x_j)| b * x_j)
+            .sum::<f64>();
+    }
+}
+
+// Dense row-major block kernel for an off-diagonal block of a symmetric matrix: y_r += B x_c and y_c += Bᵀ x_r
+fn dense_sym_mul_add(block: &[f64], [x_r, x_c]: [&[f64]; 2], [y_r, y_c]: [&mut [f64]; 2]) {
+    for ((y_i, &x_i), block_row) in y_r
+        .iter_mut()
+        .zip(x_r.iter())
+        .zip(block.chunks_exact(x_c.len()))
+    {
+        let mut dot = 0.0;
+        for ((b, x_j), y_j) in block_row.iter().zip(x_c.iter()).zip(y_c.iter_mut()) {
+            dot += b * x_j;
+            *y_j += b * x_i;
+        }
+        *y_i += dot;
+    }
+}
+
+/// A square-symmetric matrix stored as dense blocks over a [BlockSparsityPattern]
+///
+/// Only the upper block-triangle is stored. Like [CsrMatrix], the pattern is reference counted so that it can be shared between matrices.
+#[derive(Clone)]
+pub struct BsrMatrix {
+    pattern: Arc<BlockSparsityPattern>,
+    values: Vec<f64>,
+}
+
+impl BsrMatrix {
+    /// Create a matrix of zeros over a [BlockSparsityPattern]
+    pub fn new(pattern: impl Into<Arc<BlockSparsityPattern>>) -> Self {
+        let pattern = pattern.into();
+        Self {
+            values: vec![0.0; pattern.num_values()],
+            pattern,
+        }
+    }
+
+    /// Copy the values of a [CsrMatrix] into blocks
+    ///
+    /// Panics if any entry of the [CsrMatrix] is not covered by the [BlockSparsityPattern]
+    pub fn from_csr(csr: &CsrMatrix, pattern: impl Into<Arc<BlockSparsityPattern>>) -> Self {
+        let pattern = pattern.into();
+        assert_eq!(
+            csr.dimension(),
+            pattern.dimension(),
+            "CsrMatrix does not match the BlockSparsityPattern's dimension; cannot construct BsrMatrix!"
+        );
+        let partition = pattern.partition();
+        let row_blocks = partition.row_blocks();
+        let scalar_pattern = csr.pattern();
+        let csr_values = csr.values();
+
+        // split the values by block-row, such that each block-row can be filled independently
+        let mut values = vec![0.0; pattern.num_values()];
+        let mut block_row_values: Vec<&mut [f64]> = Vec::with_capacity(partition.num_blocks());
+        let mut remaining = &mut values[..];
+        for br in 0..partition.num_blocks() {
+            let [start, end] = [
+                pattern.value_offsets[pattern.block_row_offsets[br]],
+                pattern.value_offsets[pattern.block_row_offsets[br + 1]],
+            ];
+            let (current, rest) = remaining.split_at_mut(end - start);
+            block_row_values.push(current);
+            remaining = rest;
+        }
+
+        block_row_values
+            .par_iter_mut()
+            .enumerate()
+            .for_each(|(br, br_values)| {
+                let rows = partition.range(br);
+                let br_value_start = pattern.value_offsets[pattern.block_row_offsets[br]];
+
+                for r in rows.clone() {
+                    let row_start = scalar_pattern.row_offsets()[r];
+                    for (offset, &c) in scalar_pattern.row(r).iter().enumerate() {
+                        let c = c as usize;
+                        let bc = row_blocks[c] as usize;
+                        let block_idx = pattern.block_slot([br, bc]).expect(
+                            "CsrMatrix entry is not covered by the BlockSparsityPattern; cannot construct BsrMatrix!",
+                        );
+                        let cols = partition.range(bc);
+                        let block_start = pattern.value_offsets[block_idx] - br_value_start;
+                        let value = csr_values[row_start + offset];
+
+                        br_values[block_start + (r - rows.start) * cols.len() + (c - cols.start)] =
+                            value;
+                        if bc == br {
+                            br_values[block_start + (c - rows.start) * cols.len() + (r - rows.start)] =
+                                value;
+                        }
+                    }
+                }
+            });
+
+        Self { pattern, values }
+    }
+
+    /// Size of the square matrix
+    pub fn dimension(&self) -> usize {
+        self.pattern.dimension()
+    }
+
+    /// The matrix's [BlockSparsityPattern]
+    pub fn pattern(&self) -> &BlockSparsityPattern {
+        &self.pattern
+    }
+
+    /// A shared handle to the matrix's [BlockSparsityPattern]
+    pub fn shared_pattern(&self) -> Arc<BlockSparsityPattern> {
+        self.pattern.clone()
+    }
+
+    /// Check whether two matrices use the same copy of a [BlockSparsityPattern]
+    pub fn shares_pattern_with(&self, other: &Self) -> bool {
+        Arc::ptr_eq(&self.pattern, &other.pattern)
+    }
+
+    /// Values of all blocks in storage order (each block is stored densely in row-major order)
+    pub fn values(&self) -> &[f64] {
+        &self.values
+    }
+
+    /// Values of a single block
+    pub fn block(&self, block_idx: usize) -> &[f64] {
+        &self.values
+            [self.pattern.value_offsets[block_idx]..self.pattern.value_offsets[block_idx + 1]]
+    }
+
+    /// Compute the product of the (full, symmetric) matrix with a vector: `y = Mx`
+    pub fn mul_vec(&self, x: &[f64]) -> Vec<f64> {
+        let [y] = self.pattern.sym_mul_vecs([&self.values], x);
+        y
+    }
+}
+
+impl LinearOperator for BsrMatrix {
+    fn dimension(&self) -> usize {
+        self.dimension()
+    }
+
+    fn apply(&self, x: &[f64]) -> Vec<f64> {
+        self.mul_vec(x)
+    }
+}
+
+/// A Generalized Eigenvalue Problem ([GEP]) with both matrices stored in block-sparse form over a shared [BlockSparsityPattern]
+#[derive(Clone)]
+pub struct BsrGEP {
+    /// A Matrix
+    pub a: BsrMatrix,
+    /// B Matrix
+    pub b: BsrMatrix,
+}
+
+impl BsrGEP {
+    /// Convert the matrices of a [GEP] into block-sparse form
+    pub fn from_gep(gep: &GEP, partition: BlockPartition) -> Self {
+        let pattern = Arc::new(BlockSparsityPattern::from_pattern(gep.pattern(), partition));
+        Self {
+            a: BsrMatrix::from_csr(&gep.a, pattern.clone()),
+            b: BsrMatrix::from_csr(&gep.b, pattern),
+        }
+    }
+
+    /// Size of the square matrices
+    pub fn dimension(&self) -> usize {
+        self.a.dimension()
+    }
+
+    /// Compute the products of the A and B matrices with a vector: `[Ax, Bx]`
+    ///
+    /// If the matrices share a [BlockSparsityPattern], both products are computed in a single pass over the block indices
+    pub fn mul_vec(&self, x: &[f64]) -> [Vec<f64>; 2] {
+        if self.a.shares_pattern_with(&self.b) {
+            self.a
+                .pattern
+                .sym_mul_vecs([self.a.values(), self.b.values()], x)
+        } else {
+            [self.a.mul_vec(x), self.b.mul_vec(x)]
+        }
+    }
+}
+
+impl GEPOperator for BsrGEP {
+    fn dimension(&self) -> usize {
+        self.dimension()
+    }
+
+    fn apply_a(&self, x: &[f64]) -> Vec<f64> {
+        self.a.mul_vec(x)
+    }
+
+    fn apply_b(&self, x: &[f64]) -> Vec<f64> {
+        self.b.mul_vec(x)
+    }
+
+    fn apply_both(&self, x: &[f64]) -> [Vec<f64>; 2] {
+        self.mul_vec(x)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::fem_domain::basis::hierarchical_basis_fns::poly::HierPoly;
+    use crate::fem_domain::domain::{
+        mesh::{h_refinement::HRef, p_refinement::PRef, Mesh},
+        ContinuityCondition,
+    };
+    use crate::fem_problem::galerkin::galerkin_sample_gep_hcurl;
+    use crate::fem_problem::integration::integrals::{curl_curl::CurlCurl, inner::L2Inner};
+
+    #[test]
+    fn block_mat_vec() {
+        let pattern = SparsityPattern::from_coordinates(
+            5,
+            vec![[0, 0], [0, 1], [1, 1], [1, 3], [2, 4], [4, 4]],
+        );
+        let mut csr = CsrMatrix::new(pattern);
+        for (i, rc) in [[0, 0], [0, 1], [1, 1], [1, 3], [2, 4], [4, 4]]
+            .iter()
+            .enumerate()
+        {
+            csr.insert(*rc, i as f64 + 1.0);
+        }
+
+        let partition = BlockPartition::from_offsets(vec![0, 2, 3, 5]);
+        let block_pattern = BlockSparsityPattern::from_pattern(csr.pattern(), partition);
+        assert_eq!(block_pattern.num_upper_blocks(), 4);
+        assert_eq!(block_pattern.block_row(0), &[0, 2]);
+        assert_eq!(block_pattern.block_row(1), &[2]);
+
+        let bsr = BsrMatrix::from_csr(&csr, block_pattern);
+        assert_eq!(bsr.block(0), &[1.0, 2.0, 2.0, 3.0]);
+
+        let x = [1.0, -2.0, 3.0, 0.5, 2.0];
+        assert_eq!(bsr.mul_vec(&x), csr.mul_vec(&x));
+    }
+
+    #[test]
+    fn block_gep_from_domain() {
+        let mut mesh = Mesh::from_file("./test_input/test_mesh_b.json").unwrap();
+        mesh.global_p_refinement(PRef::from(3, 3));
+        mesh.global_h_refinement(HRef::T);
+        mesh.h_refine_elems(vec![6, 9, 12], HRef::T).unwrap();
+        let domain = Domain::from_mesh(mesh, ContinuityCondition::HCurl);
+
+        let gep = galerkin_sample_gep_hcurl::<HierPoly, CurlCurl, L2Inner>(&domain, Some([8, 8]))
+            .unwrap();
+        let bsr_gep = BsrGEP::from_gep(&gep, BlockPartition::from_domain(&domain));
+
+        assert!(bsr_gep.a.pattern().num_upper_blocks() < gep.pattern().num_upper_entries());
+        assert!(bsr_gep.a.pattern().partition().num_blocks() < domain.dofs.len());
+
+        let x: Vec<f64> = (0..gep.dimension())
+            .map(|i| ((i * 5) % 11) as f64 - 5.0)
+            .collect();
+        let [ax, bx] = gep.mul_vec(&x);
+        let [bsr_ax, bsr_bx] = bsr_gep.mul_vec(&x);
+
+        for (expected, computed) in [(&ax, &bsr_ax), (&bx, &bsr_bx)] {
+            for (e, c) in expected.iter().zip(computed.iter()) {
+                assert!((e - c).abs() < 1e-10 * (1.0 + e.abs()));
+            }
+        }
+    }
+}
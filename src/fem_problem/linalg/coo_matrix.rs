@@ -0,0 +1,406 @@
+use super::csr_matrix::{CsrMatrix, SparsityPattern};
+use super::elem_matrix::ElemMatrix;
+use super::GEP;
+
+use rayon::prelude::*;
+use std::fmt;
+use std::sync::Arc;
+
+/// Unordered entries of the A and B matrices of a [GEP] in coordinate (COO) form
+///
+/// Entries are accumulated without any knowledge of the final [SparsityPattern] (duplicates are allowed). Each coordinate pair is packed into a single `u64` key
+/// (`row * dimension + col`, over the upper triangle), such that sorting by key orders the entries by row, then by column.
+///
+/// Conversion into compressed-row form ([CooEntries::into_gep]) is done with a parallel radix sort of the keys, followed by a parallel segmented reduction of duplicate keys.
+#[derive(Clone, Debug, Default)]
+pub struct CooEntries {
+    dimension: usize,
+    entries: Vec<(u64, [f64; 2])>,
+    num_skipped: usize,
+}
+
+impl CooEntries {
+    /// Create an empty set of entries for a pair of matrices of some size
+    pub fn new(dimension: usize) -> Self {
+        assert!(
+            dimension <= (std::u32::MAX as usize),
+            "Matrix Dimension cannot exceed the size of a u32!"
+        );
+        Self {
+            dimension,
+            entries: Vec::new(),
+            num_skipped: 0,
+        }
+    }
+
+    /// Size of the square matrices
+    pub fn dimension(&self) -> usize {
+        self.dimension
+    }
+
+    /// Number of entries (including duplicates)
+    pub fn len(&self) -> usize {
+        self.entries.len()
+    }
+
+    /// Check if there are no entries
+    pub fn is_empty(&self) -> bool {
+        self.entries.is_empty()
+    }
+
+    /// Add an entry to both matrices. Assumes symmetry: row/col order does not matter.
+    pub fn push(&mut self, [row_idx, col_idx]: [usize; 2], values: [f64; 2]) {
+        let [r, c] = if row_idx <= col_idx {
+            [row_idx, col_idx]
+        } else {
+            [col_idx, row_idx]
+        };
+        assert!(
+            c < self.dimension,
+            "Coordinates ({}, {}) exceed matrix dimension; cannot push entry!",
+            row_idx,
+            col_idx
+        );
+        self.entries.push(((r * self.dimension + c) as u64, values));
+    }
+
+    /// Add the upper parts of a pair of [ElemMatrix]s (for the A and B matrices respectively)
+    pub fn push_elem_matrices(&mut self, a_matrix: &ElemMatrix, b_matrix: &ElemMatrix) {
+        self.entries
+            .reserve(a_matrix.num_rows() * (a_matrix.num_cols() + 1) / 2);
+        for ((rc, a), b) in a_matrix.iter_upper().zip(b_matrix.upper_values()) {
+            self.push(rc, [a, b]);
+        }
+    }
+
+    /// Add the upper parts of a pair of [ElemMatrix]s, skipping off-diagonal entries that are zero in both matrices
+    ///
+    /// Zero contributions don't change the summed values, so this only affects the resulting [SparsityPattern]. The number of skipped entries is reported by [CooEntries::into_gep_pruned].
+    pub fn push_elem_matrices_nonzero(&mut self, a_matrix: &ElemMatrix, b_matrix: &ElemMatrix) {
+        for (([r, c], a), b) in a_matrix.iter_upper().zip(b_matrix.upper_values()) {
+            if r != c && a == 0.0 && b == 0.0 {
+                self.num_skipped += 1;
+            } else {
+                self.push([r, c], [a, b]);
+            }
+        }
+    }
+
+    /// Combine several sets of entries (e.g. those accumulated by separate threads)
+    pub fn concat(mut parts: Vec<Self>) -> Self {
+        let dimension = parts.first().map_or(0, |part| part.dimension);
+        assert!(
+            parts.iter().all(|part| part.dimension == dimension),
+            "Entries with different dimensions; cannot concatenate CooEntries!"
+        );
+
+        let num_skipped = parts.iter().map(|part| part.num_skipped).sum();
+        let mut entries = Vec::with_capacity(parts.iter().map(|part| part.len()).sum());
+        for part in parts.drain(0..) {
+            entries.extend(part.entries);
+        }
+        Self {
+            dimension,
+            entries,
+            num_skipped,
+        }
+    }
+
+    /// Sort the entries, sum the duplicates, and convert them into a [GEP] whose matrices share a single [SparsityPattern]
+    pub fn into_gep(self) -> GEP {
+        let dim = self.dimension;
+        let entries = self.sorted_entries();
+        Self::compress(dim, entries)
+    }
+
+    /// Like [CooEntries::into_gep], except that summed off-diagonal entries which are negligible in both matrices (according to the `tolerance`) are left out of the [SparsityPattern]
+    ///
+    /// Diagonal entries are always retained. Returns the [GEP] along with a [DropReport] of the omitted entries.
+    pub fn into_gep_pruned(self, tolerance: DropTolerance) -> (GEP, DropReport) {
+        let dim = self.dimension;
+        let skipped_zeros = self.num_skipped;
+        let entries = self.sorted_entries();
+        let num_summed = entries.len();
+
+        let mut diagonal = vec![[0.0; 2]; dim];
+        for (key, values) in entries
+            .iter()
+            .filter(|(key, _)| key % (dim as u64 + 1) == 0)
+        {
+            diagonal[(key / dim as u64) as usize] = *values;
+        }
+
+        let entries: Vec<(u64, [f64; 2])> = entries
+            .into_par_iter()
+            .filter(|(key, values)| {
+                let [r, c] = [(key / dim as u64) as usize, (key % dim as u64) as usize];
+                r == c || !tolerance.is_negligible(*values, [diagonal[r], diagonal[c]])
+            })
+            .collect();
+
+        let report = DropReport {
+            skipped_zeros,
+            below_tolerance: num_summed - entries.len(),
+            retained: entries.len(),
+        };
+        (Self::compress(dim, entries), report)
+    }
+
+    // Radix sort the entries by key and sum the duplicates
+    fn sorted_entries(self) -> Vec<(u64, [f64; 2])> {
+        let dim = self.dimension;
+        let mut entries = self.entries;
+
+        let key_bits = 64 - ((dim * dim) as u64).leading_zeros();
+        par_radix_sort(&mut entries, key_bits);
+        par_sum_duplicates(entries)
+    }
+
+    // Convert sorted entries with unique keys into compressed-row form
+    fn compress(dim: usize, entries: Vec<(u64, [f64; 2])>) -> GEP {
+        let row_offsets: Vec<usize> = (0..dim + 1)
+            .into_par_iter()
+            .map(|r| entries.partition_point(|(key, _)| *key < (r * dim) as u64))
+            .collect();
+        let col_indices: Vec<u32> = entries
+            .par_iter()
+            .map(|(key, _)| (*key % dim as u64) as u32)
+            .collect();
+        let (a_values, b_values): (Vec<f64>, Vec<f64>) =
+            entries.par_iter().map(|(_, [a, b])| (*a, *b)).unzip();
+
+        let pattern = Arc::new(
+            SparsityPattern::from_raw_parts(dim, row_offsets, col_indices)
+                .expect("Sorted COO entries produced an invalid SparsityPattern!"),
+        );
+        GEP {
+            a: CsrMatrix::from_values(pattern.clone(), a_values),
+            b: CsrMatrix::from_values(pattern, b_values),
+        }
+    }
+}
+
+/// Criteria for leaving negligible off-diagonal entries out of a pair of system matrices (see: [CooEntries::into_gep_pruned])
+///
+/// An entry `(r, c)` is negligible when, in both the A and B matrices, its magnitude does not exceed the larger of:
+/// * the `absolute` tolerance
+/// * the `relative` tolerance times `sqrt(|M[r, r] * M[c, c]|)`
+///
+/// The default tolerance only drops entries that are exactly zero.
+#[derive(Clone, Copy, Debug, Default, PartialEq)]
+pub struct DropTolerance {
+    pub absolute: f64,
+    pub relative: f64,
+}
+
+impl DropTolerance {
+    /// Drop entries whose magnitude does not exceed some fixed value
+    pub fn absolute(absolute: f64) -> Self {
+        Self {
+            absolute,
+            relative: 0.0,
+        }
+    }
+
+    /// Drop entries that are small relative to the diagonal entries in their row and column
+    pub fn relative(relative: f64) -> Self {
+        Self {
+            absolute: 0.0,
+            relative,
+        }
+    }
+
+    fn is_negligible(&self, values: [f64; 2], [diag_r, diag_c]: [[f64; 2]; 2]) -> bool {
+        (0..2).all(|m| {
+            let scale = (diag_r[m] * diag_c[m]).abs().sqrt();
+            values[m].abs() <= self.absolute.max(self.relative * scale)
+        })
+    }
+}
+
+/// The number of entries omitted from (and retained in) a pair of matrices produced by [CooEntries::into_gep_pruned]
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub struct DropReport {
+    /// Number of `Elem`-wise contributions that were skipped because they were zero in both matrices
+    pub skipped_zeros: usize,
+    /// Number of summed entries that were dropped by the [DropTolerance]
+    pub below_tolerance: usize,
+    /// Number of entries in the upper triangle of the resulting matrices
+    pub retained: usize,
+}
+
+impl fmt::Display for DropReport {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        write!(
+            f,
+            "Retained {} entries; skipped {} zero contributions; dropped {} entries below tolerance",
+            self.retained, self.skipped_zeros, self.below_tolerance
+        )
+    }
+}
+
+/// Number of bits sorted in each pass of [par_radix_sort]
+const RADIX_BITS: u32 = 8;
+/// Approximate number of items handled by each task in [par_radix_sort] and [par_sum_duplicates]
+const COO_CHUNK_SIZE: usize = 1 << 16;
+
+// A pointer that can be shared between threads which write to disjoint positions
+#[derive(Clone, Copy)]
+struct SharedPtr<T>(*mut T);
+
+unsafe impl<T> Send for SharedPtr<T> {}
+unsafe impl<T> Sync for SharedPtr<T> {}
+
+// Stable least-significant-digit radix sort of key-value pairs, whose keys use at most the lowest `key_bits` bits
+//
+// Each pass counts the digits in each chunk in parallel, then each chunk scatters its items in parallel into the region of the output reserved for it.
+fn par_radix_sort<V: Copy + Send + Sync>(items: &mut Vec<(u64, V)>, key_bits: u32) {
+    if items.len() < 2 {
+        return;
+    }
+    let num_buckets = 1 << RADIX_BITS;
+    let mut buffer = items.clone();
+
+    for shift in (0..key_bits).step_by(RADIX_BITS as usize) {
+        let digit = |key: u64| ((key >> shift) as usize) & (num_buckets - 1);
+
+        let mut chunk_counts: Vec<Vec<usize>> = items
+            .par_chunks(COO_CHUNK_SIZE)
+            .map(|chunk| {
+                let mut counts = vec![0; num_buckets];
+                for (key, _) in chunk {
+                    counts[digit(*key)] += 1;
+                }
+                counts
+            })
+            .collect();
+
+        // convert the counts into the output position of the first item with each digit in each chunk
+        let mut position = 0;
+        for d in 0..num_buckets {
+            for counts in chunk_counts.iter_mut() {
+                let count = counts[d];
+                counts[d] = position;
+                position += count;
+            }
+        }
+
+        let output = SharedPtr(buffer.as_mut_ptr());
+        items
+            .par_chunks(COO_CHUNK_SIZE)
+            .zip(chunk_counts.into_par_iter())
+            .for_each(|(chunk, mut positions)| {
+                let output = output;
+                for item in chunk {
+                    let d = digit(item.0);
+                    // Safety: the positions reserved for each chunk are disjoint, and all of them are within the buffer (which has the same length as `items`)
+                    unsafe { output.0.add(positions[d]).write(*item) };
+                    positions[d] += 1;
+                }
+            });
+
+        std::mem::swap(items, &mut buffer);
+    }
+}
+
+// Sum the values of adjacent items with equal keys (the items must already be sorted by key)
+//
+// The items are split into chunks at key boundaries, such that each chunk can be reduced independently
+fn par_sum_duplicates(items: Vec<(u64, [f64; 2])>) -> Vec<(u64, [f64; 2])> {
+    let mut bounds = vec![0];
+    while *bounds.last().unwrap() < items.len() {
+        let mut end = (bounds.last().unwrap() + COO_CHUNK_SIZE).min(items.len());
+        while end < items.len() && items[end].0 == items[end - 1].0 {
+            end += 1;
+        }
+        bounds.push(end);
+    }
+
+    let reduced: Vec<Vec<(u64, [f64; 2])>> = bounds
+        .par_windows(2)
+        .map(|w| {
+            let mut chunk = items[w[0]..w[1]].to_vec();
+            chunk.dedup_by(|next, kept| {
+                if next.0 == kept.0 {
+                    kept.1[0] += next.1[0];
+                    kept.1[1] += next.1[1];
+                    true
+                } else {
+                    false
+                }
+            });
+            chunk
+        })
+        .collect();
+
+    let mut summed = Vec::with_capacity(reduced.iter().map(|chunk| chunk.len()).sum());
+    for chunk in reduced {
+        summed.extend(chunk);
+    }
+    summed
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn radix_sort() {
+        let mut items: Vec<(u64, usize)> = (0..3 * COO_CHUNK_SIZE)
+            .map(|i| (((i * 7919) % 100_003) as u64, i))
+            .collect();
+        let mut expected = items.clone();
+        expected.sort_by_key(|(key, _)| *key);
+
+        par_radix_sort(&mut items, 17);
+        assert_eq!(items, expected);
+    }
+
+    #[test]
+    fn coo_to_csr() {
+        let mut coo = CooEntries::new(5);
+        coo.push([0, 0], [1.0, 2.0]);
+        coo.push([3, 1], [0.5, 0.25]);
+        coo.push([4, 4], [3.0, 1.0]);
+        coo.push([1, 3], [0.5, 0.25]);
+        coo.push([0, 0], [1.0, 2.0]);
+
+        let mut other = CooEntries::new(5);
+        other.push([2, 0], [1.5, 0.0]);
+        let gep = CooEntries::concat(vec![coo, other]).into_gep();
+
+        assert_eq!(
+            gep.pattern(),
+            &SparsityPattern::from_coordinates(5, vec![[0, 0], [0, 2], [1, 3], [4, 4]])
+        );
+        assert_eq!(gep.a.values(), &[2.0, 1.5, 1.0, 3.0]);
+        assert_eq!(gep.b.values(), &[4.0, 0.0, 0.5, 1.0]);
+    }
+
+    #[test]
+    fn pruned_coo_to_csr() {
+        let mut coo = CooEntries::new(3);
+        coo.push([0, 0], [4.0, 1.0]);
+        coo.push([1, 1], [1.0, 4.0]);
+        coo.push([2, 2], [0.0, 0.0]);
+        coo.push([0, 1], [1e-4, 1e-2]);
+        coo.push([0, 2], [1e-4, 0.0]);
+        coo.push([1, 2], [1e-4, -1e-4]);
+        coo.push([1, 2], [-1e-4, 1e-4]);
+
+        let (gep, report) = coo.into_gep_pruned(DropTolerance::relative(1e-3));
+
+        assert_eq!(
+            gep.pattern(),
+            &SparsityPattern::from_coordinates(3, vec![[0, 0], [0, 1], [0, 2], [1, 1], [2, 2]])
+        );
+        assert_eq!(
+            report,
+            DropReport {
+                skipped_zeros: 0,
+                below_tolerance: 1,
+                retained: 5,
+            }
+        );
+    }
+}
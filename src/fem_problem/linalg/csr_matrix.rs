@@ -0,0 +1,757 @@
+use super::elem_matrix::ElemMatrix;
+use super::sparse_matrix::{AIJMatrixBinary, SparseMatrix};
+use crate::fem_domain::domain::Domain;
+
+use nalgebra::DMatrix;
+use rayon::prelude::*;
+use std::marker::PhantomData;
+use std::sync::Arc;
+
+/// The locations of the entries in the upper triangle of a square-symmetric matrix, stored in compressed-row form
+///
+/// Column indices are sorted within each row, such that the storage slot of any entry can be found with a binary search over its row.
+#[derive(Clone, Debug, PartialEq)]
+pub struct SparsityPattern {
+    dimension: usize,
+    /// Position of the first entry of each row in `col_indices` (with one extra entry marking the end of the last row)
+    row_offsets: Vec<usize>,
+    /// Column index of each entry
+    col_indices: Vec<u32>,
+    /// Blocks of rows handed out to threads in matrix-vector products (computed once, see: [SparsityPattern::sym_mul_vecs])
+    spmv_blocks: Vec<SpmvBlock>,
+}
+
+impl SparsityPattern {
+    /// Construct a pattern from a list of `[row, col]` coordinates (row/col order does not matter, duplicates are ignored)
+    pub fn from_coordinates(
+        dimension: usize,
+        coordinates: impl IntoIterator<Item = [usize; 2]>,
+    ) -> Self {
+        assert!(
+            dimension <= (std::u32::MAX as usize),
+            "Matrix Dimension cannot exceed the size of a u32!"
+        );
+
+        let mut rows: Vec<Vec<u32>> = vec![Vec::new(); dimension];
+        for [r, c] in coordinates {
+            assert!(
+                r < dimension && c < dimension,
+                "Coordinates ({}, {}) exceed matrix dimension; cannot construct SparsityPattern!",
+                r,
+                c
+            );
+            let [r, c] = if r <= c { [r, c] } else { [c, r] };
+            rows[r].push(c as u32);
+        }
+
+        rows.par_iter_mut().for_each(|row| {
+            row.sort_unstable();
+            row.dedup();
+        });
+
+        Self::from_rows(dimension, rows)
+    }
+
+    /// Construct the pattern of the system matrices produced by Galerkin Sampling over a [Domain]
+    ///
+    /// Each DoF is coupled with every other DoF on the same `Elem`, and with every DoF on that `Elem`'s descendants.
+    pub fn from_domain(domain: &Domain) -> Self {
+        let num_dofs = domain.dofs.len();
+        assert!(
+            num_dofs <= (std::u32::MAX as usize),
+            "Matrix Dimension cannot exceed the size of a u32!"
+        );
+
+        // dof ids on each Elem, and on each Elem's descendants
+        let local_dofs: Vec<Vec<usize>> = domain
+            .basis_specs
+            .par_iter()
+            .map(|elem_bs| elem_bs.iter().map(|bs| bs.dof_id.unwrap()).collect())
+            .collect();
+        let desc_dofs: Vec<Vec<usize>> = domain
+            .mesh
+            .elems
+            .par_iter()
+            .map(|elem| {
+                domain
+                    .descendant_basis_specs(elem.id)
+                    .unwrap()
+                    .iter()
+                    .flat_map(|(_, desc_bs)| desc_bs.iter().map(|bs| bs.dof_id.unwrap()))
+                    .collect()
+            })
+            .collect();
+
+        // Elems over which each DoF is locally defined, and Elems whose descendants each DoF is defined over
+        let mut local_elems: Vec<Vec<usize>> = vec![Vec::new(); num_dofs];
+        let mut ancestor_elems: Vec<Vec<usize>> = vec![Vec::new(); num_dofs];
+        for (elem_id, (l_dofs, d_dofs)) in local_dofs.iter().zip(desc_dofs.iter()).enumerate() {
+            if l_dofs.is_empty() {
+                continue;
+            }
+            for &dof_id in l_dofs.iter() {
+                local_elems[dof_id].push(elem_id);
+            }
+            for &dof_id in d_dofs.iter() {
+                ancestor_elems[dof_id].push(elem_id);
+            }
+        }
+
+        let rows: Vec<Vec<u32>> = (0..num_dofs)
+            .into_par_iter()
+            .map(|dof_id| {
+                let mut row: Vec<u32> = local_elems[dof_id]
+                    .iter()
+                    .flat_map(|&elem_id| {
+                        local_dofs[elem_id].iter().chain(desc_dofs[elem_id].iter())
+                    })
+                    .chain(
+                        ancestor_elems[dof_id]
+                            .iter()
+                            .flat_map(|&elem_id| local_dofs[elem_id].iter()),
+                    )
+                    .filter(|&&col| col >= dof_id)
+                    .map(|&col| col as u32)
+                    .collect();
+                row.sort_unstable();
+                row.dedup();
+                row
+            })
+            .collect();
+
+        Self::from_rows(num_dofs, rows)
+    }
+
+    /// Construct a pattern directly from its compressed-row index arrays (e.g. ones previously retrieved with [SparsityPattern::row_offsets] and [SparsityPattern::col_indices])
+    ///
+    /// Returns `None` if the arrays do not describe a valid upper-triangular pattern (with sorted, unique column indices in each row)
+    pub fn from_raw_parts(
+        dimension: usize,
+        row_offsets: Vec<usize>,
+        col_indices: Vec<u32>,
+    ) -> Option<Self> {
+        if dimension > (std::u32::MAX as usize)
+            || row_offsets.len() != dimension + 1
+            || row_offsets[0] != 0
+            || row_offsets[dimension] != col_indices.len()
+            || row_offsets.windows(2).any(|w| w[0] > w[1])
+        {
+            return None;
+        }
+
+        let rows_valid = (0..dimension).into_par_iter().all(|r| {
+            let row = &col_indices[row_offsets[r]..row_offsets[r + 1]];
+            row.first().map_or(true, |&c| c as usize >= r)
+                && row.last().map_or(true, |&c| (c as usize) < dimension)
+                && row.windows(2).all(|w| w[0] < w[1])
+        });
+
+        if rows_valid {
+            Some(Self::from_parts(dimension, row_offsets, col_indices))
+        } else {
+            None
+        }
+    }
+
+    fn from_rows(dimension: usize, rows: Vec<Vec<u32>>) -> Self {
+        let mut row_offsets = Vec::with_capacity(dimension + 1);
+        row_offsets.push(0);
+        for row in rows.iter() {
+            row_offsets.push(row_offsets.last().unwrap() + row.len());
+        }
+
+        let mut col_indices = Vec::with_capacity(*row_offsets.last().unwrap());
+        for row in rows {
+            col_indices.extend(row);
+        }
+
+        Self::from_parts(dimension, row_offsets, col_indices)
+    }
+
+    fn from_parts(dimension: usize, row_offsets: Vec<usize>, col_indices: Vec<u32>) -> Self {
+        let mut pattern = Self {
+            dimension,
+            row_offsets,
+            col_indices,
+            spmv_blocks: Vec::new(),
+        };
+        pattern.spmv_blocks = pattern.row_blocks(SPMV_BLOCK_SIZE);
+        pattern
+    }
+
+    /// Size of the square matrix
+    pub fn dimension(&self) -> usize {
+        self.dimension
+    }
+
+    /// Number of entries stored in the upper triangle
+    pub fn num_upper_entries(&self) -> usize {
+        self.col_indices.len()
+    }
+
+    /// Number of entries in the full matrix (counting both triangles)
+    pub fn num_entries(&self) -> usize {
+        let num_diag = (0..self.dimension)
+            .filter(|&r| self.row(r).first() == Some(&(r as u32)))
+            .count();
+        2 * self.col_indices.len() - num_diag
+    }
+
+    /// Position of the first entry of each row (with one extra entry marking the end of the last row)
+    pub fn row_offsets(&self) -> &[usize] {
+        &self.row_offsets
+    }
+
+    /// Column indices of all entries
+    pub fn col_indices(&self) -> &[u32] {
+        &self.col_indices
+    }
+
+    /// Column indices of the entries on a particular row of the upper triangle
+    pub fn row(&self, row_idx: usize) -> &[u32] {
+        &self.col_indices[self.row_offsets[row_idx]..self.row_offsets[row_idx + 1]]
+    }
+
+    /// Get the storage slot of an entry. Assumes symmetry: row/col order does not matter.
+    ///
+    /// Returns `None` if the entry is not part of the pattern
+    pub fn slot(&self, [row_idx, col_idx]: [usize; 2]) -> Option<usize> {
+        let [r, c] = if row_idx <= col_idx {
+            [row_idx, col_idx]
+        } else {
+            [col_idx, row_idx]
+        };
+        if c >= self.dimension {
+            return None;
+        }
+
+        self.row(r)
+            .binary_search(&(c as u32))
+            .ok()
+            .map(|offset| self.row_offsets[r] + offset)
+    }
+
+    /// Iterate over the coordinates of the upper triangle of the pattern
+    pub fn iter_upper_tri(&self) -> impl Iterator<Item = [usize; 2]> + '_ {
+        (0..self.dimension).flat_map(move |r| self.row(r).iter().map(move |c| [r, *c as usize]))
+    }
+
+    /// The off-diagonal neighbors of each row in the graph of the union of several patterns (with the same dimension)
+    ///
+    /// Each list is sorted and contains both the upper and (implied) lower entries of its row
+    pub fn union_adjacency(patterns: &[&Self]) -> Vec<Vec<usize>> {
+        let dim = patterns.first().map_or(0, |pattern| pattern.dimension);
+        assert!(
+            patterns.iter().all(|pattern| pattern.dimension == dim),
+            "Patterns have different dimensions; cannot compute adjacency!"
+        );
+
+        let mut adjacency = vec![Vec::new(); dim];
+        for pattern in patterns {
+            for [r, c] in pattern.iter_upper_tri() {
+                if r != c {
+                    adjacency[r].push(c);
+                    adjacency[c].push(r);
+                }
+            }
+        }
+        adjacency.par_iter_mut().for_each(|adj| {
+            adj.sort_unstable();
+            adj.dedup();
+        });
+        adjacency
+    }
+
+    // Partition the rows into contiguous blocks, each holding roughly `entries_per_block` entries
+    fn row_blocks(&self, entries_per_block: usize) -> Vec<SpmvBlock> {
+        let block = |block_start: usize, block_end: usize| {
+            let max_col = (block_start..block_end)
+                .filter_map(|r| self.row(r).last())
+                .map(|&c| c as usize + 1)
+                .max()
+                .unwrap_or(0);
+            SpmvBlock {
+                rows: [block_start, block_end],
+                reach: [block_start, max_col.max(block_end)],
+            }
+        };
+
+        let mut blocks = Vec::new();
+        let mut block_start = 0;
+        for r in 0..self.dimension {
+            if self.row_offsets[r + 1] - self.row_offsets[block_start] >= entries_per_block {
+                blocks.push(block(block_start, r + 1));
+                block_start = r + 1;
+            }
+        }
+        if block_start < self.dimension {
+            blocks.push(block(block_start, self.dimension));
+        }
+        blocks
+    }
+
+    /// Multiply `N` symmetric matrices (whose upper triangles are stored over this pattern) by the vector `x`
+    ///
+    /// Blocks of rows are processed in parallel. Each row contributes a dot product to its own entry of the result,
+    /// and (through the implied lower triangle) scales `x[r]` into the entries of the result at its columns.
+    /// The second set of contributions can overlap between threads, so each thread accumulates into its own result vectors (see: [sym_accumulate]).
+    pub(super) fn sym_mul_vecs<const N: usize>(
+        &self,
+        values: [&[f64]; N],
+        x: &[f64],
+    ) -> [Vec<f64>; N] {
+        assert_eq!(
+            x.len(),
+            self.dimension,
+            "Vector length does not match the matrix dimension; cannot compute product!"
+        );
+
+        sym_accumulate(self.dimension, &self.spmv_blocks, |block, offset, ys| {
+            for r in block.rows[0]..block.rows[1] {
+                let [start, end] = [self.row_offsets[r], self.row_offsets[r + 1]];
+                let has_diag = self.col_indices[start..end].first() == Some(&(r as u32));
+                let off_diag_start = if has_diag { start + 1 } else { start };
+
+                let cols = &self.col_indices[off_diag_start..end];
+                let x_r = x[r];
+
+                for (vals, y) in values.iter().zip(ys.iter_mut()) {
+                    let mut dot = if has_diag { vals[start] * x_r } else { 0.0 };
+                    for (&c, &v) in cols.iter().zip(vals[off_diag_start..end].iter()) {
+                        dot += v * x[c as usize];
+                        y[c as usize - offset] += v * x_r;
+                    }
+                    y[r - offset] += dot;
+                }
+            }
+        })
+    }
+}
+
+/// A contiguous range of rows (or block-rows) handled as a single task in a symmetric matrix-vector product
+#[derive(Clone, Copy, Debug, PartialEq)]
+pub(super) struct SpmvBlock {
+    /// The range of (block-)rows
+    pub rows: [usize; 2],
+    /// The range of result entries that the rows add into (from the first row, through the largest column)
+    pub reach: [usize; 2],
+}
+
+/// Accumulate `N` symmetric matrix-vector products over a list of [SpmvBlock]s
+///
+/// The blocks are split into one contiguous group per thread. Each group adds into its own result vectors,
+/// which only cover the range of entries reachable from its rows; `kernel` is given each block along with the offset of that range.
+/// The ranged results are then summed into the full-length vectors, one chunk of entries at a time.
+pub(super) fn sym_accumulate<const N: usize, K>(
+    dim: usize,
+    blocks: &[SpmvBlock],
+    kernel: K,
+) -> [Vec<f64>; N]
+where
+    K: Fn(SpmvBlock, usize, &mut [Vec<f64>; N]) + Sync,
+{
+    let num_threads = rayon::current_num_threads().max(1);
+    let group_size = ((blocks.len() + num_threads - 1) / num_threads).max(1);
+
+    let mut partials: Vec<(usize, [Vec<f64>; N])> = blocks
+        .par_chunks(group_size)
+        .map(|group| {
+            let start = group[0].reach[0];
+            let end = group.iter().map(|block| block.reach[1]).max().unwrap();
+            let mut ys = [(); N].map(|_| vec![0.0; end - start]);
+            for &block in group {
+                kernel(block, start, &mut ys);
+            }
+            (start, ys)
+        })
+        .collect();
+
+    // a single group already covers the entire result
+    if partials.len() == 1 && partials[0].0 == 0 && partials[0].1[0].len() == dim {
+        return partials.pop().unwrap().1;
+    }
+
+    let mut result = [(); N].map(|_| vec![0.0; dim]);
+    for (n, y) in result.iter_mut().enumerate() {
+        y.par_chunks_mut(SPMV_BLOCK_SIZE)
+            .enumerate()
+            .for_each(|(chunk_idx, y_chunk)| {
+                let chunk_start = chunk_idx * SPMV_BLOCK_SIZE;
+                let chunk_end = chunk_start + y_chunk.len();
+                for (start, ys) in partials.iter() {
+                    let lo = chunk_start.max(*start);
+                    let hi = chunk_end.min(start + ys[n].len());
+                    if lo < hi {
+                        y_chunk[(lo - chunk_start)..(hi - chunk_start)]
+                            .iter_mut()
+                            .zip(ys[n][(lo - start)..(hi - start)].iter())
+                            .for_each(|(a, b)| *a += b);
+                    }
+                }
+            });
+    }
+    result
+}
+
+/// Approximate number of stored entries handled by each task in a sparse matrix-vector product
+pub(super) const SPMV_BLOCK_SIZE: usize = 1 << 14;
+
+/// A square-symmetric matrix stored in compressed-row form over a fixed [SparsityPattern]
+///
+/// Only the upper triangle is stored. Values can only be added to entries that are part of the pattern, such that no allocation is done when the matrix is filled.
+///
+/// The pattern is reference counted, so any number of matrices (e.g. the A and B matrices of a [GEP](super::GEP)) can share a single copy of the index arrays.
+#[derive(Clone)]
+pub struct CsrMatrix {
+    pattern: Arc<SparsityPattern>,
+    values: Vec<f64>,
+}
+
+impl CsrMatrix {
+    /// Create a matrix of zeros over a [SparsityPattern] (which may already be shared with other matrices)
+    pub fn new(pattern: impl Into<Arc<SparsityPattern>>) -> Self {
+        let pattern = pattern.into();
+        Self {
+            values: vec![0.0; pattern.num_upper_entries()],
+            pattern,
+        }
+    }
+
+    /// Create a matrix over a [SparsityPattern] with a precomputed array of values (one for each entry in the upper triangle, in storage order)
+    pub fn from_values(pattern: impl Into<Arc<SparsityPattern>>, values: Vec<f64>) -> Self {
+        let pattern = pattern.into();
+        assert_eq!(
+            values.len(),
+            pattern.num_upper_entries(),
+            "Number of values does not match the SparsityPattern; cannot construct CsrMatrix!"
+        );
+        Self { pattern, values }
+    }
+
+    /// Size of the square matrix
+    pub fn dimension(&self) -> usize {
+        self.pattern.dimension
+    }
+
+    /// The matrix's [SparsityPattern]
+    pub fn pattern(&self) -> &SparsityPattern {
+        &self.pattern
+    }
+
+    /// A shared handle to the matrix's [SparsityPattern]
+    pub fn shared_pattern(&self) -> Arc<SparsityPattern> {
+        self.pattern.clone()
+    }
+
+    /// Check whether two matrices use the same copy of a [SparsityPattern]
+    pub fn shares_pattern_with(&self, other: &Self) -> bool {
+        Arc::ptr_eq(&self.pattern, &other.pattern)
+    }
+
+    /// Values of the upper triangle in storage order
+    pub fn values(&self) -> &[f64] {
+        &self.values
+    }
+
+    /// Mutable values of the upper triangle in storage order
+    pub fn values_mut(&mut self) -> &mut [f64] {
+        &mut self.values
+    }
+
+    /// Number of entries in the full matrix (counting both triangles)
+    pub fn num_entries(&self) -> usize {
+        self.pattern.num_entries()
+    }
+
+    /// Compute the product of the (full, symmetric) matrix with a vector: `y = Mx`
+    ///
+    /// The product is computed directly from the upper triangle storage, in parallel over blocks of rows
+    pub fn mul_vec(&self, x: &[f64]) -> Vec<f64> {
+        let [y] = self.pattern.sym_mul_vecs([&self.values], x);
+        y
+    }
+
+    /// Add a value to an entry in the matrix. Assumes symmetry: row/col order does not matter.
+    ///
+    /// Panics if the entry is not part of the matrix's [SparsityPattern]
+    pub fn insert(&mut self, [row_idx, col_idx]: [usize; 2], value: f64) {
+        match self.pattern.slot([row_idx, col_idx]) {
+            Some(slot) => self.values[slot] += value,
+            None => panic!(
+                "Entry ({}, {}) is not in the SparsityPattern; cannot insert value!",
+                row_idx, col_idx
+            ),
+        }
+    }
+
+    /// Add a group of values to the matrix
+    pub fn insert_group(&mut self, entry_group: &[([usize; 2], f64)]) {
+        for (rc, value) in entry_group.iter() {
+            self.insert(*rc, *value);
+        }
+    }
+
+    /// Add a value directly to a storage slot (see: [SparsityPattern::slot])
+    pub fn add_to_slot(&mut self, slot: usize, value: f64) {
+        self.values[slot] += value;
+    }
+
+    /// Add the upper part of an [ElemMatrix] into the matrix, looking up the storage slot of each entry in the [SparsityPattern]
+    ///
+    /// Panics if any of the entries are not part of the matrix's [SparsityPattern]
+    pub fn scatter(&mut self, elem_matrix: &ElemMatrix) {
+        for (rc, value) in elem_matrix.iter_upper() {
+            self.insert(rc, value);
+        }
+    }
+
+    /// Add the upper part of an [ElemMatrix] into the matrix at precomputed storage slots (one slot for each value in [ElemMatrix::upper_values])
+    pub fn scatter_to_slots(&mut self, elem_matrix: &ElemMatrix, slots: &[usize]) {
+        for (&slot, value) in slots.iter().zip(elem_matrix.upper_values()) {
+            self.values[slot] += value;
+        }
+    }
+
+    /// Get a handle which can add values to this matrix's storage slots from multiple threads (see: [SharedSlots])
+    pub fn shared_slots(&mut self) -> SharedSlots<'_> {
+        SharedSlots {
+            ptr: self.values.as_mut_ptr(),
+            len: self.values.len(),
+            _values: PhantomData,
+        }
+    }
+
+    /// Iterate over the upper triangle of the matrix.
+    pub fn iter_upper_tri(&self) -> impl Iterator<Item = ([usize; 2], f64)> + '_ {
+        self.pattern
+            .iter_upper_tri()
+            .zip(self.values.iter().copied())
+    }
+}
+
+/// Unsynchronized access to the values of a [CsrMatrix] from multiple threads
+///
+/// The matrix is mutably borrowed for the lifetime of the handle. Adding to a slot is `unsafe` because it is up to the caller to ensure that no two threads access the same slot at the same time
+/// (e.g. by only adding values from groups of `Elem`s that don't share any DoFs at once; see: [AssemblyPlan::colors](crate::fem_problem::galerkin::assembly_plan::AssemblyPlan::colors)).
+pub struct SharedSlots<'m> {
+    ptr: *mut f64,
+    len: usize,
+    _values: PhantomData<&'m mut [f64]>,
+}
+
+unsafe impl<'m> Send for SharedSlots<'m> {}
+unsafe impl<'m> Sync for SharedSlots<'m> {}
+
+impl<'m> SharedSlots<'m> {
+    /// Add a value to a storage slot
+    ///
+    /// # Safety
+    /// No other thread may access `slot` during this call
+    pub unsafe fn add_to_slot(&self, slot: usize, value: f64) {
+        assert!(
+            slot < self.len,
+            "Slot {} is outside the SparsityPattern; cannot add value!",
+            slot
+        );
+        *self.ptr.add(slot) += value;
+    }
+
+    /// Add the upper part of an [ElemMatrix] at precomputed storage slots (see: [CsrMatrix::scatter_to_slots])
+    ///
+    /// # Safety
+    /// No other thread may access any of the `slots` during this call
+    pub unsafe fn scatter_to_slots(&self, elem_matrix: &ElemMatrix, slots: &[usize]) {
+        for (&slot, value) in slots.iter().zip(elem_matrix.upper_values()) {
+            self.add_to_slot(slot, value);
+        }
+    }
+}
+
+impl From<CsrMatrix> for SparseMatrix {
+    fn from(csr: CsrMatrix) -> Self {
+        let mut sm = SparseMatrix::new(csr.dimension());
+        sm.insert_group(csr.iter_upper_tri().collect());
+        sm
+    }
+}
+
+impl From<CsrMatrix> for DMatrix<f64> {
+    fn from(csr: CsrMatrix) -> Self {
+        let dim = csr.dimension();
+        let mut dense = DMatrix::zeros(dim, dim);
+
+        for ([r, c], v) in csr.iter_upper_tri() {
+            dense[(r, c)] = v;
+            dense[(c, r)] = v;
+        }
+
+        dense
+    }
+}
+
+impl From<CsrMatrix> for AIJMatrixBinary {
+    fn from(csr: CsrMatrix) -> Self {
+        AIJMatrixBinary::from_upper_tri(csr.dimension(), || csr.iter_upper_tri())
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::fem_domain::domain::{
+        mesh::{h_refinement::HRef, p_refinement::PRef, Mesh},
+        ContinuityCondition,
+    };
+
+    #[test]
+    fn pattern_construction() {
+        let pattern = SparsityPattern::from_coordinates(
+            5,
+            vec![[0, 0], [4, 0], [0, 4], [3, 1], [2, 2], [1, 1]],
+        );
+
+        assert_eq!(pattern.num_upper_entries(), 5);
+        assert_eq!(pattern.num_entries(), 7);
+        assert_eq!(pattern.row(0), &[0, 4]);
+        assert_eq!(pattern.row(1), &[1, 3]);
+        assert_eq!(pattern.row(3), &[] as &[u32]);
+
+        assert_eq!(pattern.slot([0, 4]), Some(1));
+        assert_eq!(pattern.slot([4, 0]), Some(1));
+        assert_eq!(pattern.slot([2, 2]), Some(4));
+        assert!(pattern.slot([2, 3]).is_none());
+        assert!(pattern.slot([0, 5]).is_none());
+    }
+
+    #[test]
+    fn value_insertion() {
+        let pattern = SparsityPattern::from_coordinates(10, vec![[0, 0], [9, 9], [3, 4], [0, 8]]);
+        let mut csr = CsrMatrix::new(pattern);
+
+        csr.insert([0, 0], 1.0);
+        csr.insert([0, 0], 1.0);
+        csr.insert([9, 9], 10.0);
+        csr.insert([4, 3], 0.25);
+        csr.insert_group(&[([0, 8], 0.125), ([8, 0], 0.125)]);
+
+        let entries: Vec<([usize; 2], f64)> = csr.iter_upper_tri().collect();
+        assert_eq!(
+            entries,
+            vec![
+                ([0, 0], 2.0),
+                ([0, 8], 0.25),
+                ([3, 4], 0.25),
+                ([9, 9], 10.0)
+            ]
+        );
+    }
+
+    #[test]
+    #[should_panic]
+    fn insertion_outside_pattern() {
+        let pattern = SparsityPattern::from_coordinates(10, vec![[0, 0], [9, 9]]);
+        let mut csr = CsrMatrix::new(pattern);
+        csr.insert([0, 9], 1.0);
+    }
+
+    #[test]
+    fn dense_conversion() {
+        let pattern = SparsityPattern::from_coordinates(3, vec![[0, 0], [0, 2], [1, 1], [2, 2]]);
+        let mut csr = CsrMatrix::new(pattern);
+        csr.insert([0, 0], 1.0);
+        csr.insert([2, 0], -0.5);
+        csr.insert([1, 1], 2.0);
+        csr.insert([2, 2], 3.0);
+
+        let dense: DMatrix<f64> = csr.clone().into();
+        let dense_cmp: DMatrix<f64> = SparseMatrix::from(csr).into();
+
+        assert_eq!(dense, dense_cmp);
+        assert!((dense[(0, 2)] + 0.5).abs() < 1e-15);
+        assert!((dense[(2, 0)] + 0.5).abs() < 1e-15);
+    }
+
+    #[test]
+    fn symmetric_mat_vec() {
+        let pattern = SparsityPattern::from_coordinates(
+            5,
+            vec![[0, 0], [0, 3], [1, 1], [1, 4], [2, 3], [3, 3], [4, 0]],
+        );
+        let mut csr = CsrMatrix::new(pattern);
+        for (i, rc) in csr
+            .pattern()
+            .iter_upper_tri()
+            .collect::<Vec<_>>()
+            .iter()
+            .enumerate()
+        {
+            csr.insert(*rc, 1.0 + i as f64 * 0.5);
+        }
+
+        let x = vec![1.0, -2.0, 0.5, 3.0, -1.5];
+        let y = csr.mul_vec(&x);
+
+        let dense: DMatrix<f64> = csr.into();
+        for r in 0..5 {
+            let y_r: f64 = (0..5).map(|c| dense[(r, c)] * x[c]).sum();
+            assert!((y[r] - y_r).abs() < 1e-12);
+        }
+    }
+
+    #[test]
+    fn blocked_mat_vec() {
+        // large enough to be split into several blocks (and thread groups) with overlapping result ranges
+        let dim = 20_000;
+        let pattern = SparsityPattern::from_coordinates(
+            dim,
+            (0..dim).flat_map(|r| [[r, r], [r, (r + 7) % dim], [r, (r * 13) % dim]]),
+        );
+        assert!(pattern.spmv_blocks.len() > 1);
+
+        let values: Vec<f64> = (0..pattern.num_upper_entries())
+            .map(|i| 1.0 + (i % 11) as f64 * 0.25)
+            .collect();
+        let csr = CsrMatrix::from_values(pattern, values);
+        let x: Vec<f64> = (0..dim).map(|i| ((i % 17) as f64 - 8.0) * 0.5).collect();
+        let y = csr.mul_vec(&x);
+
+        let mut expected = vec![0.0; dim];
+        for ([r, c], v) in csr.pattern().iter_upper_tri().zip(csr.values().iter()) {
+            expected[r] += v * x[c];
+            if r != c {
+                expected[c] += v * x[r];
+            }
+        }
+        for (y_r, e_r) in y.iter().zip(expected.iter()) {
+            assert!((y_r - e_r).abs() < 1e-9);
+        }
+    }
+
+    #[test]
+    fn pattern_from_domain() {
+        let mut mesh = Mesh::from_file("./test_input/test_mesh_b.json").unwrap();
+        mesh.global_p_refinement(PRef::from(2, 2));
+        mesh.global_h_refinement(HRef::T);
+        mesh.h_refine_elems(vec![6, 9, 12], HRef::T).unwrap();
+        let domain = Domain::from_mesh(mesh, ContinuityCondition::HCurl);
+
+        let pattern = SparsityPattern::from_domain(&domain);
+        assert_eq!(pattern.dimension(), domain.dofs.len());
+
+        for elem in domain.elems() {
+            let local_bs = domain.local_basis_specs(elem.id).unwrap();
+            let desc_bs = domain.descendant_basis_specs(elem.id).unwrap();
+
+            for bs_p in local_bs.iter() {
+                for bs_q in local_bs
+                    .iter()
+                    .chain(desc_bs.iter().flat_map(|(_, d_bs)| d_bs.iter()))
+                {
+                    assert!(pattern
+                        .slot([bs_p.dof_id.unwrap(), bs_q.dof_id.unwrap()])
+                        .is_some());
+                }
+            }
+        }
+    }
+}
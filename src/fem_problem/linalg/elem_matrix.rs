@@ -0,0 +1,185 @@
+/// A dense block of values computed over a single `Elem`, along with the global DoF IDs of its rows and columns
+///
+/// The rows correspond to the `Elem`'s local DoFs. The columns correspond to the same local DoFs (in the same order), followed by the DoFs of the `Elem`'s descendants.
+/// As such, the block is composed of a square local-local block and a rectangular local-descendant block.
+///
+/// Values are stored densely in row-major order.
+///
+/// Because the global matrices are symmetric, only the "upper" part of the block is added into them:
+/// each row `r` contributes the values in columns `r` and onward (see: [ElemMatrix::iter_upper])
+#[derive(Clone, Debug, Default)]
+pub struct ElemMatrix {
+    num_rows: usize,
+    dofs: Vec<usize>,
+    values: Vec<f64>,
+}
+
+impl ElemMatrix {
+    /// Create a zeroed block over a set of local DoFs and descendant DoFs
+    pub fn new(
+        local_dofs: impl IntoIterator<Item = usize>,
+        desc_dofs: impl IntoIterator<Item = usize>,
+    ) -> Self {
+        let mut em = Self::default();
+        em.reset(local_dofs, desc_dofs);
+        em
+    }
+
+    /// Zero the block and assign it a new set of local DoFs and descendant DoFs (reusing the existing allocations)
+    pub fn reset(
+        &mut self,
+        local_dofs: impl IntoIterator<Item = usize>,
+        desc_dofs: impl IntoIterator<Item = usize>,
+    ) {
+        self.dofs.clear();
+        self.dofs.extend(local_dofs);
+        self.num_rows = self.dofs.len();
+        self.dofs.extend(desc_dofs);
+
+        self.values.clear();
+        self.values.resize(self.num_rows * self.dofs.len(), 0.0);
+    }
+
+    /// Number of rows (local DoFs)
+    pub fn num_rows(&self) -> usize {
+        self.num_rows
+    }
+
+    /// Number of columns (local and descendant DoFs)
+    pub fn num_cols(&self) -> usize {
+        self.dofs.len()
+    }
+
+    /// Global DoF IDs of the rows
+    pub fn row_dofs(&self) -> &[usize] {
+        &self.dofs[0..self.num_rows]
+    }
+
+    /// Global DoF IDs of the columns
+    pub fn col_dofs(&self) -> &[usize] {
+        &self.dofs
+    }
+
+    /// Get the value at a local `[row, col]` position
+    pub fn get(&self, [row, col]: [usize; 2]) -> f64 {
+        self.values[self.index([row, col])]
+    }
+
+    /// Set the value at a local `[row, col]` position
+    pub fn set(&mut self, [row, col]: [usize; 2], value: f64) {
+        let idx = self.index([row, col]);
+        self.values[idx] = value;
+    }
+
+    /// Set the value at a local `[row, col]` position in the local-local block, along with its transposed position
+    pub fn set_symmetric(&mut self, [row, col]: [usize; 2], value: f64) {
+        self.set([row, col], value);
+        self.set([col, row], value);
+    }
+
+    /// Values of one row
+    pub fn row(&self, row: usize) -> &[f64] {
+        let num_cols = self.num_cols();
+        &self.values[row * num_cols..(row + 1) * num_cols]
+    }
+
+    /// Iterate over the values that contribute to the upper triangle of a global matrix, in row-major order
+    pub fn upper_values(&self) -> impl Iterator<Item = f64> + '_ {
+        (0..self.num_rows).flat_map(move |row| self.row(row)[row..].iter().copied())
+    }
+
+    /// Iterate over the global `[row, col]` DoF IDs and values that contribute to the upper triangle of a global matrix, in row-major order
+    pub fn iter_upper(&self) -> impl Iterator<Item = ([usize; 2], f64)> + '_ {
+        (0..self.num_rows).flat_map(move |row| {
+            self.dofs[row..]
+                .iter()
+                .zip(self.row(row)[row..].iter())
+                .map(move |(col_dof, value)| ([self.dofs[row], *col_dof], *value))
+        })
+    }
+
+    /// Add this block's contribution to the product of a global symmetric matrix with a vector: `y += Mx`
+    ///
+    /// `M` is the matrix which would be assembled from the upper part of this block (i.e. each off-diagonal value is applied along with its transpose)
+    pub fn sym_mul_vec_add(&self, x: &[f64], y: &mut [f64]) {
+        for row in 0..self.num_rows {
+            let p = self.dofs[row];
+            let x_p = x[p];
+
+            let mut dot = 0.0;
+            for (&q, &value) in self.dofs[row..].iter().zip(self.row(row)[row..].iter()) {
+                dot += value * x[q];
+                if q != p {
+                    y[q] += value * x_p;
+                }
+            }
+            y[p] += dot;
+        }
+    }
+
+    fn index(&self, [row, col]: [usize; 2]) -> usize {
+        assert!(
+            row < self.num_rows && col < self.dofs.len(),
+            "Position ({}, {}) is outside the ElemMatrix; cannot access value!",
+            row,
+            col
+        );
+        row * self.dofs.len() + col
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::super::csr_matrix::{CsrMatrix, SparsityPattern};
+    use super::*;
+
+    #[test]
+    fn upper_iteration() {
+        let mut em = ElemMatrix::new([4, 2], [7, 9, 1]);
+        assert_eq!(em.num_rows(), 2);
+        assert_eq!(em.num_cols(), 5);
+        assert_eq!(em.row_dofs(), &[4, 2]);
+
+        em.set_symmetric([0, 0], 1.0);
+        em.set_symmetric([0, 1], 2.0);
+        em.set_symmetric([1, 1], 3.0);
+        for (col, value) in [(2, 4.0), (3, 5.0), (4, 6.0)] {
+            em.set([0, col], value);
+            em.set([1, col], value + 3.0);
+        }
+        assert_eq!(em.get([1, 0]), 2.0);
+
+        let upper: Vec<([usize; 2], f64)> = em.iter_upper().collect();
+        assert_eq!(
+            upper,
+            vec![
+                ([4, 4], 1.0),
+                ([4, 2], 2.0),
+                ([4, 7], 4.0),
+                ([4, 9], 5.0),
+                ([4, 1], 6.0),
+                ([2, 2], 3.0),
+                ([2, 7], 7.0),
+                ([2, 9], 8.0),
+                ([2, 1], 9.0),
+            ]
+        );
+        assert!(em.upper_values().eq(upper.iter().map(|(_, v)| *v)));
+
+        // scattering by DoF ID and by precomputed slots should be equivalent
+        let pattern = SparsityPattern::from_coordinates(10, upper.iter().map(|(rc, _)| *rc));
+        let slots: Vec<usize> = upper
+            .iter()
+            .map(|(rc, _)| pattern.slot(*rc).unwrap())
+            .collect();
+        let mut csr_by_dof = CsrMatrix::new(pattern.clone());
+        let mut csr_by_slot = CsrMatrix::new(pattern);
+        csr_by_dof.scatter(&em);
+        csr_by_slot.scatter_to_slots(&em, &slots);
+        assert_eq!(csr_by_dof.values(), csr_by_slot.values());
+
+        em.reset([3], []);
+        assert_eq!(em.num_cols(), 1);
+        assert_eq!(em.get([0, 0]), 0.0);
+    }
+}
@@ -0,0 +1,449 @@
+use super::multifrontal::{MultifrontalLDL, SymbolicLDL};
+use super::skyline::{FactorizationError, SkylineLDL};
+use super::{axpy, combine, dot, EigenPair, GEP};
+use nalgebra::{DMatrix, DVector, SymmetricEigen};
+use rayon::prelude::*;
+use std::fmt;
+use std::sync::Arc;
+
+/// Sparse factorizations of the shifted matrix `A - σB`
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub enum ShiftFactorization {
+    /// Profile storage in Reverse Cuthill–McKee order (see: [SkylineLDL]). Works well for small or narrow-banded problems
+    Skyline,
+    /// Supernodal multifrontal elimination in Nested Dissection order (see: [MultifrontalLDL]). Produces less fill-in on larger meshes, and uses 1x1/2x2 pivoting for indefinite shifts
+    Multifrontal,
+}
+
+impl ShiftFactorization {
+    fn factor(self, gep: &GEP, shift: f64) -> Result<ShiftedLDL, FactorizationError> {
+        match self {
+            Self::Skyline => Ok(ShiftedLDL::Skyline(SkylineLDL::shifted(gep, shift)?)),
+            Self::Multifrontal => {
+                let symbolic = Arc::new(SymbolicLDL::from_gep(gep));
+                Ok(ShiftedLDL::Multifrontal(MultifrontalLDL::shifted(
+                    &symbolic, gep, shift,
+                )?))
+            }
+        }
+    }
+}
+
+enum ShiftedLDL {
+    Skyline(SkylineLDL),
+    Multifrontal(MultifrontalLDL),
+}
+
+impl ShiftedLDL {
+    fn solve(&self, rhs: &[f64]) -> Vec<f64> {
+        match self {
+            Self::Skyline(ldl) => ldl.solve(rhs),
+            Self::Multifrontal(ldl) => ldl.solve(rhs),
+        }
+    }
+}
+
+/// Parameters for [lanczos_solve_gep_with_settings]
+#[derive(Clone, Copy, Debug)]
+pub struct LanczosSettings {
+    /// Maximum dimension of the Krylov subspace. Once it is reached, the subspace is restarted
+    pub max_subspace_dim: usize,
+    /// Maximum number of restarts before giving up
+    pub max_restarts: usize,
+    /// Convergence tolerance on the residual of the Ritz pair (relative to its Ritz value)
+    pub tolerance: f64,
+    /// Tolerance on the residual of each returned Eigenpair `‖Au - λBu‖`, relative to `‖Au‖ + |λ|‖Bu‖`
+    ///
+    /// The Ritz residual only measures convergence with respect to the factored operator, so this guards against an inaccurate factorization of `A - σB`
+    pub residual_tolerance: f64,
+    /// Factorization used to apply the shift-inverted operator
+    pub factorization: ShiftFactorization,
+}
+
+impl Default for LanczosSettings {
+    fn default() -> Self {
+        Self {
+            max_subspace_dim: 24,
+            max_restarts: 200,
+            tolerance: 1e-12,
+            residual_tolerance: 1e-8,
+            factorization: ShiftFactorization::Multifrontal,
+        }
+    }
+}
+
+/// Solve a Generalized Eigenvalue Problem in-process, returning the Eigenpair whose Eigenvalue is closest to `target_eigenvalue`
+///
+/// Uses a restarted shift-invert Lanczos method with default [LanczosSettings] (see: [lanczos_solve_gep_with_settings]).
+///
+/// Unlike the SLEPc solver, no external processes or files are involved, and unlike the Nalgebra solver, the matrices are never stored densely.
+pub fn lanczos_solve_gep(gep: &GEP, target_eigenvalue: f64) -> Result<EigenPair, LanczosGEPError> {
+    lanczos_solve_gep_with_settings(gep, target_eigenvalue, LanczosSettings::default())
+}
+
+/// Solve a Generalized Eigenvalue Problem in-process with the given [LanczosSettings], returning the Eigenpair whose Eigenvalue is closest to `target_eigenvalue`
+///
+/// See: [lanczos_solve_gep_k_with_settings]
+pub fn lanczos_solve_gep_with_settings(
+    gep: &GEP,
+    target_eigenvalue: f64,
+    settings: LanczosSettings,
+) -> Result<EigenPair, LanczosGEPError> {
+    let mut pairs = lanczos_solve_gep_k_with_settings(gep, target_eigenvalue, 1, settings)?;
+    Ok(pairs.remove(0))
+}
+
+/// Solve a Generalized Eigenvalue Problem in-process, returning the `k` Eigenpairs whose Eigenvalues are closest to `target_eigenvalue` (sorted by their distance from the target)
+///
+/// Uses default [LanczosSettings] (see: [lanczos_solve_gep_k_with_settings])
+pub fn lanczos_solve_gep_k(
+    gep: &GEP,
+    target_eigenvalue: f64,
+    k: usize,
+) -> Result<Vec<EigenPair>, LanczosGEPError> {
+    lanczos_solve_gep_k_with_settings(gep, target_eigenvalue, k, LanczosSettings::default())
+}
+
+/// Solve a Generalized Eigenvalue Problem in-process, returning the `k` Eigenpairs whose Eigenvalues are closest to `target_eigenvalue` (sorted by their distance from the target)
+///
+/// The Eigenvalues `λ` of `Au = λBu` nearest to the target `σ` are the largest (in magnitude) Eigenvalues `θ = 1 / (λ - σ)` of the shift-inverted operator `(A - σB)⁻¹B`.
+/// The shifted matrix is factored once with a sparse LDLᵀ factorization (see: [ShiftFactorization]). The operator is then applied repeatedly to build a B-orthonormal Krylov basis (Lanczos with full reorthogonalization).
+///
+/// When the basis reaches `max_subspace_dim` (which is raised to at least `2k + 2`), it is compressed onto the Ritz vectors with the largest `|θ|` and expanded again
+/// (a thick restart, which is equivalent to Krylov–Schur for symmetric problems). Convergence is checked after each expansion step, and iteration stops once all `k` of the wanted Ritz pairs have converged.
+///
+/// The Eigenvalue of each returned pair is the Rayleigh quotient of its Eigenvector. If the true residual of any pair exceeds [LanczosSettings::residual_tolerance]
+/// (e.g. because the factorization of `A - σB` is inaccurate), [LanczosGEPError::FailedToConverge] is returned.
+pub fn lanczos_solve_gep_k_with_settings(
+    gep: &GEP,
+    target_eigenvalue: f64,
+    k: usize,
+    settings: LanczosSettings,
+) -> Result<Vec<EigenPair>, LanczosGEPError> {
+    lanczos(gep, target_eigenvalue, k, None, settings).map(|(pairs, _)| pairs)
+}
+
+/// Like [lanczos_solve_gep_k_with_settings], except that the Krylov subspace is started from `initial_vector` (such as an Eigenvector from a coarser Domain,
+/// mapped onto this problem's DoFs with [prolong_eigenvector](crate::fem_problem::galerkin::prolongation::prolong_eigenvector))
+///
+/// The closer the initial vector is to the span of the wanted Eigenvectors, the fewer iterations are needed.
+/// A small multiple of the default starting vector is added to it, so that the subspace can still grow if the initial vector is an exact Eigenvector.
+pub fn lanczos_solve_gep_k_with_initial_vector(
+    gep: &GEP,
+    target_eigenvalue: f64,
+    k: usize,
+    initial_vector: &[f64],
+    settings: LanczosSettings,
+) -> Result<Vec<EigenPair>, LanczosGEPError> {
+    lanczos_solve_gep_k_with_stats(gep, target_eigenvalue, k, Some(initial_vector), settings)
+        .map(|(pairs, _)| pairs)
+}
+
+/// Like [lanczos_solve_gep_k_with_settings] (or [lanczos_solve_gep_k_with_initial_vector] if an initial vector is given),
+/// except that the amount of work done by the solver is also returned
+///
+/// This can be used to check how much a good initial vector saves over a cold solve.
+pub fn lanczos_solve_gep_k_with_stats(
+    gep: &GEP,
+    target_eigenvalue: f64,
+    k: usize,
+    initial_vector: Option<&[f64]>,
+    settings: LanczosSettings,
+) -> Result<(Vec<EigenPair>, LanczosStats), LanczosGEPError> {
+    if let Some(initial_vector) = initial_vector {
+        assert_eq!(
+            initial_vector.len(),
+            gep.dimension(),
+            "Initial vector length does not match the problem dimension; cannot solve!"
+        );
+    }
+    lanczos(gep, target_eigenvalue, k, initial_vector, settings)
+}
+
+/// Work done by a Lanczos solve (see: [lanczos_solve_gep_k_with_stats])
+#[derive(Clone, Copy, Debug, Default, PartialEq, Eq)]
+pub struct LanczosStats {
+    /// Number of thick restarts
+    pub restarts: usize,
+    /// Number of applications of the shift-inverted operator (i.e. solves with the factored `A - σB`)
+    pub iterations: usize,
+}
+
+// Relative (B-norm) size of the default starting vector mixed into an initial vector
+const INITIAL_VECTOR_PERTURBATION: f64 = 1e-6;
+
+fn lanczos(
+    gep: &GEP,
+    target_eigenvalue: f64,
+    k: usize,
+    initial_vector: Option<&[f64]>,
+    settings: LanczosSettings,
+) -> Result<(Vec<EigenPair>, LanczosStats), LanczosGEPError> {
+    let dim = gep.dimension();
+    if k == 0 {
+        return Ok((Vec::new(), LanczosStats::default()));
+    }
+    let max_subspace_dim = settings.max_subspace_dim.max(2 * k + 2).min(dim);
+    if max_subspace_dim <= k + 1 {
+        return Err(LanczosGEPError::ProblemTooSmall);
+    }
+    let num_kept = (max_subspace_dim / 2).max(k);
+
+    let factorization = settings.factorization.factor(gep, target_eigenvalue)?;
+
+    // B-orthonormal basis vectors, and their products with B
+    let mut basis: Vec<Vec<f64>> = Vec::with_capacity(max_subspace_dim);
+    let mut b_basis: Vec<Vec<f64>> = Vec::with_capacity(max_subspace_dim);
+    // projection of the shift-inverted operator onto the basis
+    let mut projection = DMatrix::zeros(max_subspace_dim, max_subspace_dim);
+
+    let mut start: Vec<f64> = (0..dim)
+        .map(|i| ((i * 7919 + 17) % 1013) as f64 / 1013.0 - 0.5)
+        .collect();
+    if let Some(initial_vector) = initial_vector {
+        let initial_norm = dot(initial_vector, &gep.b.mul_vec(initial_vector)).sqrt();
+        if initial_norm > 0.0 {
+            let default_norm = dot(&start, &gep.b.mul_vec(&start)).sqrt();
+            let perturbation = INITIAL_VECTOR_PERTURBATION * initial_norm / default_norm;
+            start = initial_vector
+                .iter()
+                .zip(start.iter())
+                .map(|(x, s)| x + perturbation * s)
+                .collect();
+        }
+    }
+    let b_start = gep.b.mul_vec(&start);
+    let start_norm = dot(&start, &b_start).sqrt();
+    let mut next = (scale(&start, start_norm), scale(&b_start, start_norm));
+
+    let mut stats = LanczosStats::default();
+    for restart in 0..=settings.max_restarts {
+        stats.restarts = restart;
+
+        // expand the basis
+        let mut residual_norm = 0.0;
+        let mut early_ritz = None;
+        for j in basis.len()..max_subspace_dim {
+            let (v, bv) = next;
+            let mut w = factorization.solve(&bv);
+            stats.iterations += 1;
+            basis.push(v);
+            b_basis.push(bv);
+
+            for i in 0..=j {
+                projection[(i, j)] = 0.0;
+            }
+            for _ in 0..2 {
+                for i in 0..=j {
+                    let coeff = dot(&b_basis[i], &w);
+                    axpy(-coeff, &basis[i], &mut w);
+                    projection[(i, j)] += coeff;
+                }
+            }
+            // Bw is computed after orthogonalization (rather than updated alongside w), since w can be much smaller than the vectors it was
+            // computed from (e.g. when the starting vector is nearly an Eigenvector)
+            let bw = gep.b.mul_vec(&w);
+            for i in 0..j {
+                projection[(j, i)] = projection[(i, j)];
+            }
+
+            residual_norm = dot(&w, &bw).max(0.0).sqrt();
+            if residual_norm <= f64::EPSILON * projection[(j, j)].abs() {
+                // the basis spans an invariant subspace
+                residual_norm = 0.0;
+                next = (Vec::new(), Vec::new());
+                break;
+            }
+            next = (scale(&w, residual_norm), scale(&bw, residual_norm));
+
+            // check for convergence before the basis is full, so that a good starting vector can end the iteration early
+            // (the projection is small, so this is cheap compared to the solve above)
+            if j + 1 >= k && j + 1 < max_subspace_dim {
+                let ritz = RitzPairs::new(&projection, j + 1);
+                if ritz.converged(k, residual_norm, settings.tolerance) {
+                    early_ritz = Some(ritz);
+                    break;
+                }
+            }
+        }
+
+        // Rayleigh-Ritz
+        let size = basis.len();
+        if size < k {
+            // the basis spans an invariant subspace without enough Eigenpairs
+            return Err(LanczosGEPError::FailedToConverge);
+        }
+        let ritz = early_ritz.unwrap_or_else(|| RitzPairs::new(&projection, size));
+        if ritz.converged(k, residual_norm, settings.tolerance) {
+            let mut pairs = Vec::with_capacity(k);
+            for i in ritz.ranking[..k].iter() {
+                let vector = combine(&basis, |l| ritz.vectors[(l, *i)]);
+                let [au, bu] = gep.mul_vec(&vector);
+                let value = dot(&vector, &au) / dot(&vector, &bu);
+
+                // check the true residual (the Ritz residual is only as accurate as the factorization)
+                let mut residual = au.clone();
+                axpy(-value, &bu, &mut residual);
+                let scale = dot(&au, &au).sqrt() + value.abs() * dot(&bu, &bu).sqrt();
+                if !(dot(&residual, &residual).sqrt() <= settings.residual_tolerance * scale) {
+                    return Err(LanczosGEPError::FailedToConverge);
+                }
+
+                pairs.push(EigenPair { value, vector });
+            }
+            return Ok((pairs, stats));
+        }
+        if residual_norm == 0.0 {
+            return Err(LanczosGEPError::FailedToConverge);
+        }
+
+        // thick restart: compress the basis onto the dominant Ritz vectors
+        let kept = &ritz.ranking[..num_kept];
+        let (new_basis, new_b_basis) = kept
+            .iter()
+            .map(|k| {
+                (
+                    combine(&basis, |l| ritz.vectors[(l, *k)]),
+                    combine(&b_basis, |l| ritz.vectors[(l, *k)]),
+                )
+            })
+            .unzip();
+        basis = new_basis;
+        b_basis = new_b_basis;
+
+        projection = DMatrix::zeros(max_subspace_dim, max_subspace_dim);
+        for (i, k) in kept.iter().enumerate() {
+            projection[(i, i)] = ritz.values[*k];
+        }
+    }
+
+    Err(LanczosGEPError::FailedToConverge)
+}
+
+// Eigenpairs of the leading `size x size` block of the projected operator, ranked by the magnitude of their Eigenvalues (i.e. by the closeness of the corresponding GEP Eigenvalues to the shift)
+struct RitzPairs {
+    values: DVector<f64>,
+    vectors: DMatrix<f64>,
+    ranking: Vec<usize>,
+}
+
+impl RitzPairs {
+    fn new(projection: &DMatrix<f64>, size: usize) -> Self {
+        let eigen = SymmetricEigen::new(DMatrix::from_fn(size, size, |r, c| projection[(r, c)]));
+        let mut ranking: Vec<usize> = (0..size).collect();
+        ranking.sort_by(|a, b| {
+            eigen.eigenvalues[*b]
+                .abs()
+                .partial_cmp(&eigen.eigenvalues[*a].abs())
+                .unwrap()
+        });
+
+        Self {
+            values: eigen.eigenvalues,
+            vectors: eigen.eigenvectors,
+            ranking,
+        }
+    }
+
+    // Whether the `k` dominant Ritz pairs have converged, given the norm of the next (un-normalized) basis vector
+    fn converged(&self, k: usize, residual_norm: f64, tolerance: f64) -> bool {
+        let last = self.ranking.len() - 1;
+        self.ranking[..k].iter().all(|i| {
+            let ritz_residual = (residual_norm * self.vectors[(last, *i)]).abs();
+            ritz_residual <= tolerance * self.values[*i].abs()
+        })
+    }
+}
+
+fn scale(x: &[f64], norm: f64) -> Vec<f64> {
+    x.par_iter().map(|x_i| x_i / norm).collect()
+}
+
+#[derive(Debug, Clone)]
+/// Error type for the Lanczos solver
+pub enum LanczosGEPError {
+    /// The shifted matrix `A - σB` could not be factored (the target is likely very close to an Eigenvalue)
+    FailedToFactor(FactorizationError),
+    FailedToConverge,
+    ProblemTooSmall,
+}
+
+impl std::error::Error for LanczosGEPError {}
+
+impl fmt::Display for LanczosGEPError {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        match self {
+            Self::FailedToFactor(err) => write!(f, "Failed to factor A - σB: {}", err),
+            Self::FailedToConverge => write!(
+                f,
+                "Lanczos iteration did not converge within the maximum number of restarts (or its Eigenpairs failed the residual check)!"
+            ),
+            Self::ProblemTooSmall => write!(
+                f,
+                "Problem is too small for the requested number of Eigenpairs; cannot solve!"
+            ),
+        }
+    }
+}
+
+impl From<FactorizationError> for LanczosGEPError {
+    fn from(err: FactorizationError) -> Self {
+        Self::FailedToFactor(err)
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::fem_domain::basis::hierarchical_basis_fns::poly::HierPoly;
+    use crate::fem_domain::domain::{
+        mesh::{p_refinement::PRef, Mesh},
+        ContinuityCondition, Domain,
+    };
+    use crate::fem_problem::galerkin::galerkin_sample_gep_hcurl;
+    use crate::fem_problem::integration::integrals::{curl_curl::CurlCurl, inner::L2Inner};
+
+    #[test]
+    fn lanczos_problem() {
+        let mut mesh = Mesh::from_file("./test_input/test_mesh_a.json").unwrap();
+        mesh.global_p_refinement(PRef::from(2, 2));
+        let domain = Domain::from_mesh(mesh, ContinuityCondition::HCurl);
+
+        let gep = galerkin_sample_gep_hcurl::<HierPoly, CurlCurl, L2Inner>(&domain, Some([8, 8]))
+            .unwrap();
+        for factorization in [
+            ShiftFactorization::Skyline,
+            ShiftFactorization::Multifrontal,
+        ] {
+            let settings = LanczosSettings {
+                factorization,
+                ..Default::default()
+            };
+            let solution = lanczos_solve_gep_with_settings(&gep, 2.64, settings).unwrap();
+
+            // nearest eigenvalue, as computed by a dense solve of the symmetrically reduced problem
+            assert!((solution.value - 3.618045946_f64).abs() < 1e-8);
+            assert!(solution.residual_norm(&gep) < 1e-8);
+        }
+
+        // the true residual is checked independently of the Ritz residual
+        let unattainable = LanczosSettings {
+            residual_tolerance: 0.0,
+            ..Default::default()
+        };
+        assert!(matches!(
+            lanczos_solve_gep_with_settings(&gep, 2.64, unattainable),
+            Err(LanczosGEPError::FailedToConverge)
+        ));
+
+        let solutions = lanczos_solve_gep_k(&gep, 2.64, 3).unwrap();
+        assert_eq!(solutions.len(), 3);
+        for (solution, expected) in solutions
+            .iter()
+            .zip([3.618045946, 1.307666065, 4.399500333])
+        {
+            assert!((solution.value - expected).abs() < 1e-8);
+            assert!(solution.residual_norm(&gep) < 1e-8);
+        }
+    }
+}
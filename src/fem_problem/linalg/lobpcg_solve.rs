@@ -0,0 +1,735 @@
+use super::operator::GEPOperator;
+use super::preconditioner::Preconditioner;
+use super::{axpy, combine, dot, EigenPair};
+use nalgebra::{DMatrix, SymmetricEigen};
+use rayon::prelude::*;
+use std::fmt;
+
+/// Parameters for [lobpcg_solve_gep]
+#[derive(Clone, Copy, Debug)]
+pub struct LobpcgSettings {
+    /// Maximum number of iterations before giving up
+    pub max_iters: usize,
+    /// Convergence tolerance on the residual of each Eigenpair: `|Au - λBu| <= tolerance * (|Au| + |λ||Bu|)`
+    pub tolerance: f64,
+}
+
+impl Default for LobpcgSettings {
+    fn default() -> Self {
+        Self {
+            max_iters: 1000,
+            tolerance: 1e-9,
+        }
+    }
+}
+
+/// Compute the `num_pairs` smallest Eigenpairs of a Generalized Eigenvalue Problem with the Locally Optimal Block Preconditioned Conjugate Gradient method
+///
+/// Each iteration extends the current block of approximate Eigenvectors `X` with the preconditioned residuals `W` and the previous search directions `P`,
+/// and then solves the (small, dense) projected problem over `[X, W, P]` with Nalgebra (Rayleigh–Ritz). Columns whose residuals have converged are no longer extended.
+///
+/// The problem is only accessed through the [GEPOperator] interface, so it can be an assembled [GEP](super::GEP), a [BsrGEP](super::bsr_matrix::BsrGEP),
+/// or a [MatrixFreeGEP](crate::fem_problem::galerkin::matrix_free::MatrixFreeGEP). Besides the operator, only a few blocks of `num_pairs` vectors are stored.
+///
+/// The search is restricted to the B-orthogonal complement of the `constraints` (which may be empty). For curl-curl problems, whose smallest Eigenvalues
+/// belong to a large null-space of gradient fields, use [lobpcg_solve_gep_near_target] instead.
+///
+/// Eigenpairs are returned in ascending order of their Eigenvalues.
+pub fn lobpcg_solve_gep<G: GEPOperator, P: Preconditioner>(
+    gep: &G,
+    preconditioner: &P,
+    num_pairs: usize,
+    constraints: &[Vec<f64>],
+    settings: LobpcgSettings,
+) -> Result<Vec<EigenPair>, LobpcgGEPError> {
+    lobpcg_solve_gep_with_initial_vectors(
+        gep,
+        preconditioner,
+        num_pairs,
+        constraints,
+        &[],
+        settings,
+    )
+}
+
+/// Like [lobpcg_solve_gep], except that the first columns of the initial block are the `initial_vectors` (at most `num_pairs` of them), such as Eigenvectors from a coarser Domain
+/// mapped onto this problem's DoFs with [prolong_eigenvector](crate::fem_problem::galerkin::prolongation::prolong_eigenvector)
+///
+/// Any remaining columns are filled with the default initial guess.
+pub fn lobpcg_solve_gep_with_initial_vectors<G: GEPOperator, P: Preconditioner>(
+    gep: &G,
+    preconditioner: &P,
+    num_pairs: usize,
+    constraints: &[Vec<f64>],
+    initial_vectors: &[Vec<f64>],
+    settings: LobpcgSettings,
+) -> Result<Vec<EigenPair>, LobpcgGEPError> {
+    lobpcg(
+        gep,
+        preconditioner,
+        num_pairs,
+        constraints,
+        initial_vectors,
+        settings,
+        |x, values, residuals, j| {
+            let scale = norm(&x.a_vectors[j]) + values[j].abs() * norm(&x.b_vectors[j]);
+            norm(&residuals[j]) <= settings.tolerance * scale
+        },
+    )
+}
+
+// LOBPCG iteration, where `is_converged(x, values, residuals, j)` decides whether the `j`th column of `x` has converged
+fn lobpcg<G, P, C>(
+    gep: &G,
+    preconditioner: &P,
+    num_pairs: usize,
+    constraints: &[Vec<f64>],
+    initial_vectors: &[Vec<f64>],
+    settings: LobpcgSettings,
+    is_converged: C,
+) -> Result<Vec<EigenPair>, LobpcgGEPError>
+where
+    G: GEPOperator,
+    P: Preconditioner,
+    C: Fn(&Block, &[f64], &[Vec<f64>], usize) -> bool,
+{
+    let dim = gep.dimension();
+    assert!(
+        initial_vectors.len() <= num_pairs && initial_vectors.iter().all(|v| v.len() == dim),
+        "Initial vectors do not match the problem dimension or the number of pairs; cannot solve!"
+    );
+    assert_eq!(
+        preconditioner.dimension(),
+        dim,
+        "Preconditioner dimension does not match the problem; cannot solve!"
+    );
+    if num_pairs == 0 || 3 * num_pairs + constraints.len() > dim {
+        return Err(LobpcgGEPError::TooManyPairs);
+    }
+
+    // B-orthonormal basis of the constraints
+    let constraints = if constraints.is_empty() {
+        Block::default()
+    } else {
+        let mut block = Block::new(gep, constraints.to_vec(), false);
+        block.b_orthonormalize()?;
+        block
+    };
+
+    // initial guess
+    let initial: Vec<Vec<f64>> = (0..num_pairs)
+        .map(|j| match initial_vectors.get(j) {
+            Some(initial_vector) => initial_vector.clone(),
+            None => (0..dim)
+                .map(|i| (((i + 1) * (j + 3) * 7919) % 1013) as f64 / 1013.0 - 0.5)
+                .collect(),
+        })
+        .collect();
+    let mut x = Block::new(gep, constraints.project_out(initial), true);
+    x.b_orthonormalize()?;
+    let (ritz_values, coeffs) = rayleigh_ritz(&[&x])?;
+    x = x.combine_columns(&coeffs, 0..num_pairs);
+    let mut values = ritz_values[..num_pairs].to_vec();
+
+    let mut p: Option<Block> = None;
+
+    for _ in 0..settings.max_iters {
+        // residuals
+        let residuals: Vec<Vec<f64>> = (0..num_pairs)
+            .into_par_iter()
+            .map(|j| {
+                x.a_vectors[j]
+                    .iter()
+                    .zip(x.b_vectors[j].iter())
+                    .map(|(ax, bx)| ax - values[j] * bx)
+                    .collect()
+            })
+            .collect();
+        let active: Vec<usize> = (0..num_pairs)
+            .filter(|j| !is_converged(&x, &values, &residuals, *j))
+            .collect();
+
+        if active.is_empty() {
+            return Ok(x
+                .vectors
+                .into_iter()
+                .zip(values)
+                .map(|(vector, value)| EigenPair { value, vector })
+                .collect());
+        }
+
+        // preconditioned residuals, B-orthogonal to the constraints and the current approximations
+        let w_vectors: Vec<Vec<f64>> = active
+            .iter()
+            .map(|j| preconditioner.apply(&residuals[*j]))
+            .collect();
+        let w_vectors = x.project_out(constraints.project_out(w_vectors));
+        let mut w = Block::new(gep, w_vectors, true);
+        w.b_orthonormalize()?;
+
+        if let Some(p_block) = p.as_mut() {
+            if p_block.b_orthonormalize().is_err() {
+                p = None;
+            }
+        }
+
+        // Rayleigh-Ritz over [X, W, P] (without P if the projected problem is too ill-conditioned)
+        let (ritz_values, coeffs, with_p) = match p.as_ref() {
+            Some(p_block) => match rayleigh_ritz(&[&x, &w, p_block]) {
+                Ok((ritz_values, coeffs)) => (ritz_values, coeffs, true),
+                Err(_) => {
+                    let (ritz_values, coeffs) = rayleigh_ritz(&[&x, &w])?;
+                    (ritz_values, coeffs, false)
+                }
+            },
+            None => {
+                let (ritz_values, coeffs) = rayleigh_ritz(&[&x, &w])?;
+                (ritz_values, coeffs, false)
+            }
+        };
+
+        // new search directions: the components of the new approximations outside of X
+        let num_x = x.len();
+        let mut search_blocks = vec![&w];
+        if with_p {
+            search_blocks.push(p.as_ref().unwrap());
+        }
+        let search = Block::concat(&search_blocks);
+        let search_coeffs =
+            DMatrix::from_fn(search.len(), num_pairs, |r, c| coeffs[(num_x + r, c)]);
+        let new_p = search.combine_columns(&search_coeffs, 0..num_pairs);
+
+        let mut all_blocks = vec![&x];
+        all_blocks.extend(search_blocks);
+        let new_x = Block::concat(&all_blocks).combine_columns(&coeffs, 0..num_pairs);
+
+        x = new_x;
+        values = ritz_values[..num_pairs].to_vec();
+        p = Some(new_p.select(&active));
+    }
+
+    Err(LobpcgGEPError::FailedToConverge)
+}
+
+/// Compute the `num_pairs` Eigenpairs of a Generalized Eigenvalue Problem whose Eigenvalues are nearest to `target_eigenvalue` with LOBPCG
+///
+/// LOBPCG only converges towards the smallest Eigenvalues of a problem, which (for curl-curl problems) belong to a large null-space of gradient fields.
+/// Instead, the spectrum is folded about the target `σ`: the search is done over `(A - σB)B⁻¹(A - σB)u = θBu`, which has the same Eigenvectors with `θ = (λ - σ)²`.
+/// Its smallest Eigenvalues belong to the Eigenvalues nearest to the target, so the null-space is skipped over without having to construct a basis for it.
+/// The converged vectors are then passed through a final Rayleigh–Ritz step over the original problem.
+///
+/// Folding squares the spread of the spectrum, so the folded problem is preconditioned with `(A - σB)⁻¹B(A - σB)⁻¹` (making each iteration similar to a step of inverse iteration).
+/// Products with `(A - σB)⁻¹` are approximated by MINRES solves (to a relative tolerance of [SHIFTED_SOLVE_TOLERANCE]), and products with `B⁻¹` by Conjugate Gradient solves:
+///
+/// * `preconditioner` is used for the `A - σB` solves. It must be positive definite, such as [BlockJacobi::shifted](super::preconditioner::BlockJacobi::shifted) with `-σ` as the shift
+/// * `mass_preconditioner` is used for the `B` solves, such as [BlockJacobi::new](super::preconditioner::BlockJacobi::new) over `B`
+///
+/// Eigenpairs are returned in ascending order of their distance from the target.
+pub fn lobpcg_solve_gep_near_target<G, P, M>(
+    gep: &G,
+    target_eigenvalue: f64,
+    preconditioner: &P,
+    mass_preconditioner: &M,
+    num_pairs: usize,
+    settings: LobpcgSettings,
+) -> Result<Vec<EigenPair>, LobpcgGEPError>
+where
+    G: GEPOperator,
+    P: Preconditioner,
+    M: Preconditioner,
+{
+    assert!(
+        preconditioner.dimension() == gep.dimension()
+            && mass_preconditioner.dimension() == gep.dimension(),
+        "Preconditioner dimension does not match the problem; cannot solve!"
+    );
+    let folded = FoldedGEP {
+        gep,
+        shift: target_eigenvalue,
+        preconditioner,
+        mass_preconditioner,
+        tolerance: settings.tolerance * INNER_TOLERANCE_RATIO,
+    };
+
+    // convergence is judged by the residuals of the original problem, which (unlike the folded residuals) don't stagnate at the scale of `|A|²` round-off
+    let folded_pairs = lobpcg(
+        &folded,
+        &folded,
+        num_pairs,
+        &[],
+        &[],
+        settings,
+        |x, _, _, j| {
+            let [ax, bx] = gep.apply_both(&x.vectors[j]);
+            let value = dot(&x.vectors[j], &ax) / dot(&x.vectors[j], &bx);
+            let residual: Vec<f64> = ax
+                .iter()
+                .zip(bx.iter())
+                .map(|(a, b)| a - value * b)
+                .collect();
+            norm(&residual) <= settings.tolerance * (norm(&ax) + value.abs() * norm(&bx))
+        },
+    )?;
+
+    // Rayleigh-Ritz over the original problem (which also separates any pairs that are equally far above and below the target)
+    let mut x = Block::new(
+        gep,
+        folded_pairs.into_iter().map(|pair| pair.vector).collect(),
+        true,
+    );
+    x.b_orthonormalize()?;
+    let (ritz_values, coeffs) = rayleigh_ritz(&[&x])?;
+    let ritz_vectors = x.combine_columns(&coeffs, 0..num_pairs).vectors;
+
+    let mut pairs: Vec<EigenPair> = ritz_values
+        .into_iter()
+        .zip(ritz_vectors)
+        .map(|(value, vector)| EigenPair { value, vector })
+        .collect();
+    pairs.sort_by(|a, b| {
+        (a.value - target_eigenvalue)
+            .abs()
+            .partial_cmp(&(b.value - target_eigenvalue).abs())
+            .unwrap()
+    });
+    Ok(pairs)
+}
+
+/// Relative tolerance of the MINRES solves with `A - σB` which precondition [lobpcg_solve_gep_near_target]
+pub const SHIFTED_SOLVE_TOLERANCE: f64 = 1e-3;
+
+/// Ratio between the tolerance of the `B⁻¹` solves in the folded operator and the outer tolerance in [lobpcg_solve_gep_near_target]
+const INNER_TOLERANCE_RATIO: f64 = 1e-3;
+
+// The spectrum of a GEP folded about a shift: ((A - σB)B⁻¹(A - σB), B). Also acts as its own preconditioner: (A - σB)⁻¹B(A - σB)⁻¹
+struct FoldedGEP<'g, G: GEPOperator, P: Preconditioner, M: Preconditioner> {
+    gep: &'g G,
+    shift: f64,
+    preconditioner: &'g P,
+    mass_preconditioner: &'g M,
+    tolerance: f64,
+}
+
+impl<'g, G, P, M> FoldedGEP<'g, G, P, M>
+where
+    G: GEPOperator,
+    P: Preconditioner,
+    M: Preconditioner,
+{
+    // (A - σB)x from the pair [Ax, Bx]
+    fn shifted(&self, [ax, bx]: &[Vec<f64>; 2]) -> Vec<f64> {
+        ax.iter()
+            .zip(bx.iter())
+            .map(|(a, b)| a - self.shift * b)
+            .collect()
+    }
+
+    // Solve `By = b` with the Preconditioned Conjugate Gradient method
+    fn b_solve(&self, rhs: &[f64]) -> Vec<f64> {
+        let rhs_norm = norm(rhs);
+        let mut y = vec![0.0; rhs.len()];
+        if rhs_norm == 0.0 {
+            return y;
+        }
+
+        let mut r = rhs.to_vec();
+        let mut z = self.mass_preconditioner.apply(&r);
+        let mut p = z.clone();
+        let mut rz = dot(&r, &z);
+
+        // B is positive definite, so CG terminates within `dimension` iterations (in exact arithmetic)
+        for _ in 0..self.gep.dimension() {
+            let bp = self.gep.apply_b(&p);
+            let alpha = rz / dot(&p, &bp);
+            axpy(alpha, &p, &mut y);
+            axpy(-alpha, &bp, &mut r);
+            if norm(&r) <= self.tolerance * rhs_norm {
+                break;
+            }
+
+            z = self.mass_preconditioner.apply(&r);
+            let rz_next = dot(&r, &z);
+            let beta = rz_next / rz;
+            rz = rz_next;
+            p.par_iter_mut()
+                .zip(z.par_iter())
+                .for_each(|(p_i, z_i)| *p_i = z_i + beta * *p_i);
+        }
+        y
+    }
+
+    // Solve `(A - σB)y = b` with the Preconditioned Minimal Residual method (A - σB is indefinite, but the preconditioner must be positive definite)
+    fn shifted_solve(&self, rhs: &[f64]) -> Vec<f64> {
+        let dim = rhs.len();
+        let mut y = vec![0.0; dim];
+
+        let mut r1 = rhs.to_vec();
+        let mut z = self.preconditioner.apply(&r1);
+        let beta_1 = dot(&r1, &z).sqrt();
+        if beta_1 == 0.0 || !beta_1.is_finite() {
+            return y;
+        }
+        let mut r2 = r1.clone();
+
+        let [mut beta, mut old_beta] = [beta_1, 0.0];
+        let [mut d_bar, mut epsilon, mut phi_bar] = [0.0, 0.0, beta_1];
+        let [mut cs, mut sn] = [-1.0, 0.0];
+        let mut w = vec![0.0; dim];
+        let mut w_prev = vec![0.0; dim];
+
+        for iter in 0..dim {
+            // Lanczos step over the preconditioned operator
+            let v: Vec<f64> = z.iter().map(|z_i| z_i / beta).collect();
+            z = self.shifted(&self.gep.apply_both(&v));
+            if iter > 0 {
+                axpy(-beta / old_beta, &r1, &mut z);
+            }
+            let alpha = dot(&v, &z);
+            axpy(-alpha / beta, &r2, &mut z);
+            r1 = std::mem::replace(&mut r2, z);
+            z = self.preconditioner.apply(&r2);
+            old_beta = beta;
+            beta = dot(&r2, &z).sqrt();
+
+            // apply the previous rotation, and compute the next one
+            let old_epsilon = epsilon;
+            let delta = cs * d_bar + sn * alpha;
+            let g_bar = sn * d_bar - cs * alpha;
+            epsilon = sn * beta;
+            d_bar = -cs * beta;
+            let gamma = g_bar.hypot(beta).max(f64::EPSILON);
+            cs = g_bar / gamma;
+            sn = beta / gamma;
+            let phi = cs * phi_bar;
+            phi_bar *= sn;
+
+            // update the solution
+            let w_next: Vec<f64> = v
+                .iter()
+                .zip(w_prev.iter().zip(w.iter()))
+                .map(|(v_i, (w_1, w_2))| (v_i - old_epsilon * w_1 - delta * w_2) / gamma)
+                .collect();
+            w_prev = std::mem::replace(&mut w, w_next);
+            axpy(phi, &w, &mut y);
+
+            if phi_bar <= SHIFTED_SOLVE_TOLERANCE * beta_1 || beta == 0.0 || !beta.is_finite() {
+                break;
+            }
+        }
+        y
+    }
+}
+
+impl<'g, G, P, M> GEPOperator for FoldedGEP<'g, G, P, M>
+where
+    G: GEPOperator,
+    P: Preconditioner,
+    M: Preconditioner,
+{
+    fn dimension(&self) -> usize {
+        self.gep.dimension()
+    }
+
+    fn apply_a(&self, x: &[f64]) -> Vec<f64> {
+        let [ax, _] = self.apply_both(x);
+        ax
+    }
+
+    fn apply_b(&self, x: &[f64]) -> Vec<f64> {
+        self.gep.apply_b(x)
+    }
+
+    fn apply_both(&self, x: &[f64]) -> [Vec<f64>; 2] {
+        let abx = self.gep.apply_both(x);
+        let y = self.b_solve(&self.shifted(&abx));
+        let [_, bx] = abx;
+        [self.shifted(&self.gep.apply_both(&y)), bx]
+    }
+}
+
+impl<'g, G, P, M> Preconditioner for FoldedGEP<'g, G, P, M>
+where
+    G: GEPOperator,
+    P: Preconditioner,
+    M: Preconditioner,
+{
+    fn dimension(&self) -> usize {
+        self.gep.dimension()
+    }
+
+    fn apply(&self, r: &[f64]) -> Vec<f64> {
+        self.shifted_solve(&self.gep.apply_b(&self.shifted_solve(r)))
+    }
+}
+
+// A block of vectors along with their products with A and B
+#[derive(Default)]
+struct Block {
+    vectors: Vec<Vec<f64>>,
+    a_vectors: Vec<Vec<f64>>,
+    b_vectors: Vec<Vec<f64>>,
+}
+
+impl Block {
+    fn new<G: GEPOperator>(gep: &G, vectors: Vec<Vec<f64>>, with_a: bool) -> Self {
+        let (a_vectors, b_vectors) = if with_a {
+            vectors
+                .iter()
+                .map(|v| {
+                    let [av, bv] = gep.apply_both(v);
+                    (av, bv)
+                })
+                .unzip()
+        } else {
+            (Vec::new(), vectors.iter().map(|v| gep.apply_b(v)).collect())
+        };
+        Self {
+            vectors,
+            a_vectors,
+            b_vectors,
+        }
+    }
+
+    fn len(&self) -> usize {
+        self.vectors.len()
+    }
+
+    fn concat(blocks: &[&Self]) -> Self {
+        let mut concatenated = Self::default();
+        for block in blocks {
+            concatenated.vectors.extend(block.vectors.iter().cloned());
+            concatenated
+                .a_vectors
+                .extend(block.a_vectors.iter().cloned());
+            concatenated
+                .b_vectors
+                .extend(block.b_vectors.iter().cloned());
+        }
+        concatenated
+    }
+
+    fn select(self, columns: &[usize]) -> Self {
+        let pick = |vectors: &Vec<Vec<f64>>| -> Vec<Vec<f64>> {
+            columns.iter().map(|j| vectors[*j].clone()).collect()
+        };
+        Self {
+            vectors: pick(&self.vectors),
+            a_vectors: pick(&self.a_vectors),
+            b_vectors: pick(&self.b_vectors),
+        }
+    }
+
+    // Linear combinations of the vectors (and their products) given by some columns of `coeffs`
+    fn combine_columns(&self, coeffs: &DMatrix<f64>, columns: std::ops::Range<usize>) -> Self {
+        let combine_all = |vectors: &Vec<Vec<f64>>| -> Vec<Vec<f64>> {
+            if vectors.is_empty() {
+                return Vec::new();
+            }
+            columns
+                .clone()
+                .map(|c| combine(vectors, |r| coeffs[(r, c)]))
+                .collect()
+        };
+        Self {
+            vectors: combine_all(&self.vectors),
+            a_vectors: combine_all(&self.a_vectors),
+            b_vectors: combine_all(&self.b_vectors),
+        }
+    }
+
+    // Make the vectors B-orthonormal (Cholesky-QR in the B inner product)
+    fn b_orthonormalize(&mut self) -> Result<(), LobpcgGEPError> {
+        let gram = gram_matrix(&self.vectors, &self.b_vectors);
+        let n = gram.nrows();
+        let l = gram.cholesky().ok_or(LobpcgGEPError::IllConditioned)?.l();
+        let l_inv_t = l
+            .tr_solve_lower_triangular(&DMatrix::identity(n, n))
+            .ok_or(LobpcgGEPError::IllConditioned)?;
+        *self = self.combine_columns(&l_inv_t, 0..n);
+        Ok(())
+    }
+
+    // Remove the components of some vectors that lie in the span of this (B-orthonormal) block
+    fn project_out(&self, mut vectors: Vec<Vec<f64>>) -> Vec<Vec<f64>> {
+        for v in vectors.iter_mut() {
+            for (u, bu) in self.vectors.iter().zip(self.b_vectors.iter()) {
+                let coeff = dot(bu, v);
+                v.par_iter_mut()
+                    .zip(u.par_iter())
+                    .for_each(|(v_i, u_i)| *v_i -= coeff * u_i);
+            }
+        }
+        vectors
+    }
+}
+
+// The matrix of inner products `XᵀY`
+fn gram_matrix(x: &[Vec<f64>], y: &[Vec<f64>]) -> DMatrix<f64> {
+    let n = x.len();
+    let mut gram = DMatrix::zeros(n, n);
+    for r in 0..n {
+        for c in r..n {
+            let value = (dot(&x[r], &y[c]) + dot(&x[c], &y[r])) / 2.0;
+            gram[(r, c)] = value;
+            gram[(c, r)] = value;
+        }
+    }
+    gram
+}
+
+// Solve the projected problem over the union of several blocks. Returns the Ritz values in ascending order, and the coefficients of the corresponding Ritz vectors (as columns)
+fn rayleigh_ritz(blocks: &[&Block]) -> Result<(Vec<f64>, DMatrix<f64>), LobpcgGEPError> {
+    let basis = Block::concat(blocks);
+    let gram_a = gram_matrix(&basis.vectors, &basis.a_vectors);
+    let gram_b = gram_matrix(&basis.vectors, &basis.b_vectors);
+    let n = basis.len();
+
+    // reduce to a standard symmetric problem: L⁻¹ Gₐ L⁻ᵀ
+    let l = gram_b.cholesky().ok_or(LobpcgGEPError::IllConditioned)?.l();
+    let half_reduced = l
+        .solve_lower_triangular(&gram_a)
+        .ok_or(LobpcgGEPError::IllConditioned)?;
+    let reduced = l
+        .solve_lower_triangular(&half_reduced.transpose())
+        .ok_or(LobpcgGEPError::IllConditioned)?;
+
+    let eigen = SymmetricEigen::new(reduced);
+    let mut order: Vec<usize> = (0..n).collect();
+    order.sort_by(|a, b| {
+        eigen.eigenvalues[*a]
+            .partial_cmp(&eigen.eigenvalues[*b])
+            .unwrap()
+    });
+
+    let sorted_vectors = DMatrix::from_fn(n, n, |r, c| eigen.eigenvectors[(r, order[c])]);
+    let coeffs = l
+        .tr_solve_lower_triangular(&sorted_vectors)
+        .ok_or(LobpcgGEPError::IllConditioned)?;
+
+    Ok((
+        order.iter().map(|i| eigen.eigenvalues[*i]).collect(),
+        coeffs,
+    ))
+}
+
+fn norm(x: &[f64]) -> f64 {
+    dot(x, x).sqrt()
+}
+
+#[derive(Debug, Clone)]
+/// Error type for the LOBPCG solver
+pub enum LobpcgGEPError {
+    /// The search space became (numerically) linearly dependent
+    IllConditioned,
+    FailedToConverge,
+    /// The requested number of Eigenpairs (plus constraints) is too large for the problem size
+    TooManyPairs,
+}
+
+impl std::error::Error for LobpcgGEPError {}
+
+impl fmt::Display for LobpcgGEPError {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        match self {
+            Self::IllConditioned => write!(
+                f,
+                "Search space became linearly dependent; cannot continue LOBPCG!"
+            ),
+            Self::FailedToConverge => write!(
+                f,
+                "LOBPCG did not converge within the maximum number of iterations!"
+            ),
+            Self::TooManyPairs => write!(
+                f,
+                "Too many Eigenpairs requested for the problem size; cannot solve!"
+            ),
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::fem_domain::basis::hierarchical_basis_fns::poly::HierPoly;
+    use crate::fem_domain::domain::{
+        mesh::{p_refinement::PRef, Mesh},
+        ContinuityCondition, Domain,
+    };
+    use crate::fem_problem::galerkin::galerkin_sample_gep_hcurl;
+    use crate::fem_problem::integration::integrals::{curl_curl::CurlCurl, inner::L2Inner};
+    use crate::fem_problem::linalg::bsr_matrix::BlockPartition;
+    use crate::fem_problem::linalg::csr_matrix::SparsityPattern;
+    use crate::fem_problem::linalg::preconditioner::BlockJacobi;
+    use crate::fem_problem::linalg::GEP;
+
+    #[test]
+    fn lobpcg_laplacian() {
+        // 1D Laplacian with a lumped mass matrix: λₖ = (2 - 2cos(kπ / (n + 1))) / 2
+        let dim = 60;
+        let pattern = SparsityPattern::from_coordinates(
+            dim,
+            (0..dim).map(|i| [i, i]).chain((1..dim).map(|i| [i - 1, i])),
+        );
+        let mut gep = GEP::new(pattern);
+        for i in 0..dim {
+            gep.a.insert([i, i], 2.0);
+            gep.b.insert([i, i], 2.0);
+            if i > 0 {
+                gep.a.insert([i - 1, i], -1.0);
+            }
+        }
+        let expected = |k: usize| {
+            (2.0 - 2.0 * (k as f64 * std::f64::consts::PI / (dim + 1) as f64).cos()) / 2.0
+        };
+
+        let partition = BlockPartition::from_offsets((0..=dim).step_by(6).collect());
+        let preconditioner = BlockJacobi::shifted(&gep, -0.01, partition);
+
+        let pairs =
+            lobpcg_solve_gep(&gep, &preconditioner, 3, &[], LobpcgSettings::default()).unwrap();
+        for (k, pair) in pairs.iter().enumerate() {
+            assert!((pair.value - expected(k + 1)).abs() < 1e-10);
+            assert!(pair.residual_norm(&gep) < 1e-7);
+        }
+
+        // constraining the search to the complement of the first Eigenvector skips over it
+        let constrained = lobpcg_solve_gep(
+            &gep,
+            &preconditioner,
+            2,
+            &[pairs[0].vector.clone()],
+            LobpcgSettings::default(),
+        )
+        .unwrap();
+        assert!((constrained[0].value - expected(2)).abs() < 1e-10);
+        assert!((constrained[1].value - expected(3)).abs() < 1e-10);
+    }
+
+    #[test]
+    fn lobpcg_near_target_hcurl() {
+        let mut mesh = Mesh::from_file("./test_input/test_mesh_a.json").unwrap();
+        mesh.global_p_refinement(PRef::from(2, 2));
+        let domain = Domain::from_mesh(mesh, ContinuityCondition::HCurl);
+        let gep = galerkin_sample_gep_hcurl::<HierPoly, CurlCurl, L2Inner>(&domain, Some([8, 8]))
+            .unwrap();
+
+        let partition = BlockPartition::from_domain(&domain);
+        let preconditioner = BlockJacobi::shifted(&gep, -2.64, partition.clone());
+        let mass_preconditioner = BlockJacobi::new(&gep.b, partition);
+
+        // the physical modes nearest the target, rather than the gradient null-space
+        let pairs = lobpcg_solve_gep_near_target(
+            &gep,
+            2.64,
+            &preconditioner,
+            &mass_preconditioner,
+            2,
+            LobpcgSettings::default(),
+        )
+        .unwrap();
+        for (pair, expected) in pairs.iter().zip([3.618045946, 1.307666065]) {
+            assert!((pair.value - expected).abs() < 1e-8);
+            assert!(pair.residual_norm(&gep) < 1e-7);
+        }
+    }
+}
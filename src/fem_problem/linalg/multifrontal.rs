@@ -0,0 +1,755 @@
+use super::csr_matrix::{CsrMatrix, SparsityPattern};
+use super::skyline::{FactorizationError, PIVOT_TOLERANCE};
+use super::GEP;
+use crate::fem_domain::domain::renumbering::{graph_ordering, DoFOrdering};
+use rayon::prelude::*;
+use std::ops::Range;
+use std::sync::Arc;
+
+/// The symbolic phase of a sparse LDLᵀ factorization: a fill-reducing ordering, the elimination tree, and the structure of the factor
+///
+/// The analysis only depends on the sparsity patterns of the factored matrices, so one `SymbolicLDL` can be used to factor `A - σB` for any number of shifts `σ` (see: [MultifrontalLDL::shifted]).
+///
+/// Consecutive columns of the factor with nested structures are grouped into (fundamental) supernodes. Each supernode is eliminated as a dense frontal matrix.
+/// Supernodes at the same height in the elimination tree don't depend on one another, so they are eliminated in parallel.
+#[derive(Clone, Debug)]
+pub struct SymbolicLDL {
+    // original index of each permuted row
+    order: Vec<usize>,
+    // permuted index of each original row
+    position: Vec<usize>,
+    supernodes: Vec<Supernode>,
+    // supernode that eliminates each (permuted) column
+    col_supernodes: Vec<usize>,
+    // supernodes grouped by their height in the elimination tree (leaves first)
+    levels: Vec<Vec<usize>>,
+}
+
+#[derive(Clone, Debug)]
+struct Supernode {
+    // (permuted) columns eliminated by this supernode
+    cols: Range<usize>,
+    // rows of the frontal matrix: the supernode's own columns, followed by the rows that they update (sorted)
+    rows: Vec<usize>,
+    children: Vec<usize>,
+    // position of each updated row (i.e. `rows[cols.len()..]`) in the parent's frontal matrix
+    parent_map: Vec<usize>,
+}
+
+impl SymbolicLDL {
+    /// Analyze the union of several [SparsityPattern]s, using the given fill-reducing ordering
+    ///
+    /// [DoFOrdering::NestedDissection] produces much less fill-in than [DoFOrdering::ReverseCuthillMcKee] for all but the smallest problems
+    pub fn new(patterns: &[&SparsityPattern], ordering: DoFOrdering) -> Self {
+        let adjacency = SparsityPattern::union_adjacency(patterns);
+        let dim = adjacency.len();
+
+        let order = graph_ordering(&adjacency, ordering);
+        let mut position = vec![0; dim];
+        for (p, old) in order.iter().enumerate() {
+            position[*old] = p;
+        }
+
+        // (permuted) rows below the diagonal in each (permuted) column
+        let mut lower = vec![Vec::new(); dim];
+        for (old, adj) in adjacency.iter().enumerate() {
+            let p = position[old];
+            lower[p].extend(adj.iter().map(|q| position[*q]).filter(|q| *q > p));
+        }
+        drop(adjacency);
+
+        // structure of each column of L, and the elimination tree (the parent of each column is the first row in its structure)
+        let mut col_structs: Vec<Vec<usize>> = Vec::with_capacity(dim);
+        let mut col_children = vec![Vec::new(); dim];
+        let mut marker = vec![usize::MAX; dim];
+        for j in 0..dim {
+            marker[j] = j;
+            let mut col_struct = Vec::with_capacity(lower[j].len());
+            for &i in lower[j].iter().chain(
+                col_children[j]
+                    .iter()
+                    .flat_map(|c: &usize| col_structs[*c].iter()),
+            ) {
+                if marker[i] != j {
+                    marker[i] = j;
+                    col_struct.push(i);
+                }
+            }
+            col_struct.sort_unstable();
+
+            if let Some(&parent) = col_struct.first() {
+                col_children[parent].push(j);
+            }
+            col_structs.push(col_struct);
+        }
+
+        // fundamental supernodes
+        let mut supernodes: Vec<Supernode> = Vec::new();
+        let mut col_supernodes = vec![0; dim];
+        for j in 0..dim {
+            let extends_previous = j > 0
+                && col_structs[j - 1].first() == Some(&j)
+                && col_children[j].len() == 1
+                && col_structs[j - 1].len() == col_structs[j].len() + 1;
+
+            if extends_previous {
+                supernodes.last_mut().unwrap().cols.end = j + 1;
+            } else {
+                supernodes.push(Supernode {
+                    cols: j..j + 1,
+                    rows: Vec::new(),
+                    children: Vec::new(),
+                    parent_map: Vec::new(),
+                });
+            }
+            col_supernodes[j] = supernodes.len() - 1;
+        }
+
+        // supernodal tree
+        let mut heights = vec![0; supernodes.len()];
+        let mut levels: Vec<Vec<usize>> = Vec::new();
+        for s in 0..supernodes.len() {
+            let last_col = supernodes[s].cols.end - 1;
+            supernodes[s].rows = supernodes[s]
+                .cols
+                .clone()
+                .chain(col_structs[last_col].iter().copied())
+                .collect();
+
+            let height = supernodes[s]
+                .children
+                .iter()
+                .map(|c| heights[*c] + 1)
+                .max()
+                .unwrap_or(0);
+            heights[s] = height;
+            if levels.len() <= height {
+                levels.push(Vec::new());
+            }
+            levels[height].push(s);
+
+            // the first updated row is the first column of the parent
+            if let Some(&parent_col) = col_structs[last_col].first() {
+                let parent = col_supernodes[parent_col];
+                supernodes[parent].children.push(s);
+            }
+        }
+        for s in 0..supernodes.len() {
+            for c in 0..supernodes[s].children.len() {
+                let child = supernodes[s].children[c];
+                let num_cols = supernodes[child].cols.len();
+                let parent_map = supernodes[child].rows[num_cols..]
+                    .iter()
+                    .map(|r| {
+                        supernodes[s]
+                            .rows
+                            .binary_search(r)
+                            .expect("Supernode update rows are not nested in the parent's rows!")
+                    })
+                    .collect();
+                supernodes[child].parent_map = parent_map;
+            }
+        }
+
+        Self {
+            order,
+            position,
+            supernodes,
+            col_supernodes,
+            levels,
+        }
+    }
+
+    /// Analyze the union of the A and B matrices' [SparsityPattern]s with a Nested Dissection ordering
+    pub fn from_gep(gep: &GEP) -> Self {
+        Self::new(
+            &[gep.a.pattern(), gep.b.pattern()],
+            DoFOrdering::NestedDissection,
+        )
+    }
+
+    /// Size of the analyzed matrices
+    pub fn dimension(&self) -> usize {
+        self.order.len()
+    }
+
+    /// Number of entries in the strictly lower triangle of the factor
+    pub fn factor_size(&self) -> usize {
+        self.supernodes
+            .iter()
+            .map(|sn| {
+                let (m, k) = (sn.rows.len(), sn.cols.len());
+                k * m - k * (k + 1) / 2
+            })
+            .sum()
+    }
+
+    /// Number of supernodes
+    pub fn num_supernodes(&self) -> usize {
+        self.supernodes.len()
+    }
+}
+
+/// A sparse LDLᵀ factorization computed with the multifrontal method over a [SymbolicLDL] analysis
+///
+/// Shifted matrices `A - σB` are generally indefinite, so `D` is block diagonal with 1x1 and 2x2 pivots. Within each frontal matrix, pivots are chosen with threshold
+/// partial pivoting (as in Duff and Reid's MA27/MA57): a pivot is only accepted if it bounds the entries of `L` by `1 / PIVOT_THRESHOLD`. Columns for which no stable pivot can be found
+/// are delayed to the parent's frontal matrix (where they have been updated by more of the matrix), so the structure of the factor can grow beyond the symbolic analysis.
+/// Factorization fails if columns are still left over at a root of the elimination tree (i.e. if the matrix is numerically singular).
+///
+/// Once computed, the factorization can be used to solve any number of right-hand sides (in parallel, with [MultifrontalLDL::solve_many]).
+#[derive(Clone, Debug)]
+pub struct MultifrontalLDL {
+    symbolic: Arc<SymbolicLDL>,
+    fronts: Vec<FactoredFront>,
+}
+
+/// Threshold for accepting a pivot: every entry of `L` is bounded by its reciprocal
+const PIVOT_THRESHOLD: f64 = 0.1;
+
+// The eliminated part of a supernode's frontal matrix
+#[derive(Clone, Debug)]
+struct FactoredFront {
+    // (permuted) rows of the front: the eliminated columns (in pivot order), followed by the rows that they update
+    rows: Vec<usize>,
+    // entries of L in the eliminated columns (column-major, with `rows.len()` rows). The diagonal entries are implied to be 1,
+    // and the sub-diagonal entry of each 2x2 pivot's first column is 0
+    factors: Vec<f64>,
+    pivots: Vec<Pivot>,
+}
+
+// A diagonal block of D
+#[derive(Clone, Copy, Debug)]
+enum Pivot {
+    One(f64),
+    // lower triangle of a symmetric 2x2 block: [d11, d21, d22]
+    Two([f64; 3]),
+}
+
+// The Schur complement of a frontal matrix, to be added into the parent's frontal matrix
+struct Contribution {
+    // (permuted) columns that could not be eliminated. These are the first rows of the update
+    delayed: Vec<usize>,
+    // lower triangle of the update matrix (column-major)
+    update: Vec<f64>,
+}
+
+impl MultifrontalLDL {
+    /// Factor a symmetric matrix whose pattern was included in the `symbolic` analysis
+    pub fn new(
+        symbolic: &Arc<SymbolicLDL>,
+        matrix: &CsrMatrix,
+    ) -> Result<Self, FactorizationError> {
+        Self::factor(symbolic, &[(matrix, 1.0)])
+    }
+
+    /// Factor the shifted matrix `A - σB` of a [GEP] (whose patterns were included in the `symbolic` analysis) without assembling it
+    pub fn shifted(
+        symbolic: &Arc<SymbolicLDL>,
+        gep: &GEP,
+        shift: f64,
+    ) -> Result<Self, FactorizationError> {
+        Self::factor(symbolic, &[(&gep.a, 1.0), (&gep.b, -shift)])
+    }
+
+    /// The analysis that this factorization was computed over
+    pub fn symbolic(&self) -> &Arc<SymbolicLDL> {
+        &self.symbolic
+    }
+
+    /// Size of the factored matrix
+    pub fn dimension(&self) -> usize {
+        self.symbolic.dimension()
+    }
+
+    /// Number of negative eigenvalues of D (counting both eigenvalues of each 2x2 pivot)
+    ///
+    /// By Sylvester's law of inertia, this is the number of negative eigenvalues of the factored matrix (i.e. the number of Eigenvalues of a GEP below the shift `σ`)
+    pub fn num_negative_pivots(&self) -> usize {
+        self.fronts
+            .iter()
+            .flat_map(|front| front.pivots.iter())
+            .map(|pivot| match pivot {
+                Pivot::One(d) => (*d < 0.0) as usize,
+                Pivot::Two([d11, d21, d22]) => {
+                    let det = d11 * d22 - d21 * d21;
+                    if det < 0.0 {
+                        1
+                    } else if d11 + d22 < 0.0 {
+                        2
+                    } else {
+                        0
+                    }
+                }
+            })
+            .sum()
+    }
+
+    /// Number of 2x2 pivots in D
+    pub fn num_2x2_pivots(&self) -> usize {
+        self.fronts
+            .iter()
+            .flat_map(|front| front.pivots.iter())
+            .filter(|pivot| matches!(pivot, Pivot::Two(_)))
+            .count()
+    }
+
+    /// Solve `Mx = b` for `x`, where `M` is the factored matrix
+    pub fn solve(&self, rhs: &[f64]) -> Vec<f64> {
+        assert_eq!(
+            rhs.len(),
+            self.dimension(),
+            "Vector length does not match the matrix dimension; cannot solve!"
+        );
+        let symbolic = &self.symbolic;
+        let mut y: Vec<f64> = symbolic.order.iter().map(|old| rhs[*old]).collect();
+
+        // L z = b
+        for front in self.fronts.iter() {
+            let (rows, l) = (&front.rows, &front.factors);
+            let m = rows.len();
+            for j in 0..l.len() / m {
+                let z_j = y[rows[j]];
+                if z_j != 0.0 {
+                    for i in j + 1..m {
+                        y[rows[i]] -= l[j * m + i] * z_j;
+                    }
+                }
+            }
+        }
+
+        // D w = z
+        for front in self.fronts.iter() {
+            let mut j = 0;
+            for pivot in front.pivots.iter() {
+                match pivot {
+                    Pivot::One(d) => {
+                        y[front.rows[j]] /= d;
+                        j += 1;
+                    }
+                    Pivot::Two([d11, d21, d22]) => {
+                        let det = d11 * d22 - d21 * d21;
+                        let (r1, r2) = (front.rows[j], front.rows[j + 1]);
+                        let (z1, z2) = (y[r1], y[r2]);
+                        y[r1] = (d22 * z1 - d21 * z2) / det;
+                        y[r2] = (d11 * z2 - d21 * z1) / det;
+                        j += 2;
+                    }
+                }
+            }
+        }
+
+        // Lᵀ y = w
+        for front in self.fronts.iter().rev() {
+            let (rows, l) = (&front.rows, &front.factors);
+            let m = rows.len();
+            for j in (0..l.len() / m).rev() {
+                let update: f64 = (j + 1..m).map(|i| l[j * m + i] * y[rows[i]]).sum();
+                y[rows[j]] -= update;
+            }
+        }
+
+        let mut x = vec![0.0; y.len()];
+        for (y_p, old) in y.into_iter().zip(symbolic.order.iter()) {
+            x[*old] = y_p;
+        }
+        x
+    }
+
+    /// Solve `Mx = b` for several right-hand sides in parallel
+    pub fn solve_many(&self, rhs: &[Vec<f64>]) -> Vec<Vec<f64>> {
+        rhs.par_iter().map(|b| self.solve(b)).collect()
+    }
+
+    // Factor a linear combination of matrices
+    fn factor(
+        symbolic: &Arc<SymbolicLDL>,
+        terms: &[(&CsrMatrix, f64)],
+    ) -> Result<Self, FactorizationError> {
+        let dim = symbolic.dimension();
+        assert!(
+            terms.iter().all(|(matrix, _)| matrix.dimension() == dim),
+            "Matrix dimension does not match the symbolic analysis; cannot factor!"
+        );
+
+        // sort the original entries by the supernode that eliminates them: (local row, local col, value)
+        let mut entries: Vec<Vec<(usize, usize, f64)>> =
+            vec![Vec::new(); symbolic.supernodes.len()];
+        let mut scale = 0.0_f64;
+        for (matrix, coeff) in terms {
+            for ([r, c], value) in matrix.iter_upper_tri() {
+                let [p, q] = [symbolic.position[r], symbolic.position[c]];
+                let (row, col) = if p > q { (p, q) } else { (q, p) };
+                let s = symbolic.col_supernodes[col];
+                let sn = &symbolic.supernodes[s];
+
+                let local_row = sn
+                    .rows
+                    .binary_search(&row)
+                    .expect("Matrix entry is not part of the symbolic analysis; cannot factor!");
+                entries[s].push((local_row, col - sn.cols.start, coeff * value));
+                scale = scale.max((coeff * value).abs());
+            }
+        }
+        // the diagonal can be small relative to the rest of an indefinite matrix, so the tolerance is relative to the largest entry
+        let pivot_tolerance = PIVOT_TOLERANCE * scale;
+
+        let mut fronts = Vec::with_capacity(symbolic.supernodes.len());
+        fronts.resize_with(symbolic.supernodes.len(), || None);
+        let mut updates: Vec<Option<Contribution>> = Vec::with_capacity(symbolic.supernodes.len());
+        updates.resize_with(symbolic.supernodes.len(), || None);
+
+        for level in symbolic.levels.iter() {
+            let level_fronts: Vec<(usize, Vec<Contribution>)> = level
+                .iter()
+                .map(|s| {
+                    let child_updates = symbolic.supernodes[*s]
+                        .children
+                        .iter()
+                        .map(|c| updates[*c].take().unwrap())
+                        .collect();
+                    (*s, child_updates)
+                })
+                .collect();
+
+            let eliminated: Vec<Result<_, FactorizationError>> = level_fronts
+                .into_par_iter()
+                .map(|(s, child_updates)| {
+                    symbolic
+                        .eliminate(s, &entries[s], child_updates, pivot_tolerance)
+                        .map(|(front, update)| (s, front, update))
+                })
+                .collect();
+
+            for result in eliminated {
+                let (s, front, update) = result?;
+                fronts[s] = Some(front);
+                updates[s] = Some(update);
+            }
+        }
+
+        Ok(Self {
+            symbolic: symbolic.clone(),
+            fronts: fronts.into_iter().map(Option::unwrap).collect(),
+        })
+    }
+}
+
+impl SymbolicLDL {
+    // Assemble a supernode's frontal matrix (including any columns delayed by its children) and eliminate as many of its columns as possible.
+    // Returns the eliminated part of the front, and the Schur complement of the remaining rows
+    //
+    // All dense matrices are column-major, and only their lower triangles are used
+    fn eliminate(
+        &self,
+        s: usize,
+        entries: &[(usize, usize, f64)],
+        child_updates: Vec<Contribution>,
+        pivot_tolerance: f64,
+    ) -> Result<(FactoredFront, Contribution), FactorizationError> {
+        let sn = &self.supernodes[s];
+
+        // delayed columns come first, followed by the supernode's own rows
+        let mut rows: Vec<usize> = child_updates
+            .iter()
+            .flat_map(|contribution| contribution.delayed.iter().copied())
+            .chain(sn.rows.iter().copied())
+            .collect();
+        let nd = rows.len() - sn.rows.len();
+        let m = rows.len();
+        // columns that can be eliminated in this front
+        let num_candidates = nd + sn.cols.len();
+
+        let mut front = vec![0.0; m * m];
+        for (r, c, value) in entries {
+            front[(nd + c) * m + nd + r] += value;
+        }
+        let mut delayed_offset = 0;
+        for (child, contribution) in sn.children.iter().zip(child_updates) {
+            let parent_map = &self.supernodes[*child].parent_map;
+            let num_delayed = contribution.delayed.len();
+            let map: Vec<usize> = (delayed_offset..delayed_offset + num_delayed)
+                .chain(parent_map.iter().map(|r| nd + r))
+                .collect();
+            delayed_offset += num_delayed;
+
+            let mc = map.len();
+            for c in 0..mc {
+                for r in c..mc {
+                    front[map[c] * m + map[r]] += contribution.update[c * mc + r];
+                }
+            }
+        }
+
+        let mut pivots = Vec::new();
+        let mut j = 0;
+        while j < num_candidates {
+            match find_pivot(&front, m, j, num_candidates, pivot_tolerance) {
+                Some(PivotChoice::One(c)) => {
+                    swap_symmetric(&mut front, &mut rows, m, j, c);
+                    pivots.push(eliminate_1x1(&mut front, m, j));
+                    j += 1;
+                }
+                Some(PivotChoice::Two(c, r)) => {
+                    swap_symmetric(&mut front, &mut rows, m, j, c);
+                    let r = if r == j { c } else { r };
+                    swap_symmetric(&mut front, &mut rows, m, j + 1, r);
+                    pivots.push(eliminate_2x2(&mut front, m, j));
+                    j += 2;
+                }
+                None => break,
+            }
+        }
+
+        // columns left over at a root can't be delayed any further
+        if j < num_candidates && sn.rows.len() == sn.cols.len() {
+            return Err(FactorizationError::ZeroPivot(self.order[rows[j]]));
+        }
+
+        let mu = m - j;
+        let mut update = vec![0.0; mu * mu];
+        for c in 0..mu {
+            update[c * mu + c..(c + 1) * mu]
+                .copy_from_slice(&front[(j + c) * m + j + c..(j + c + 1) * m]);
+        }
+        let delayed = rows[j..num_candidates].to_vec();
+        front.truncate(j * m);
+
+        Ok((
+            FactoredFront {
+                rows,
+                factors: front,
+                pivots,
+            },
+            Contribution { delayed, update },
+        ))
+    }
+}
+
+enum PivotChoice {
+    One(usize),
+    Two(usize, usize),
+}
+
+// Entry (r, c) of a symmetric matrix whose lower triangle is stored column-major
+fn sym_entry(front: &[f64], m: usize, r: usize, c: usize) -> f64 {
+    if r >= c {
+        front[c * m + r]
+    } else {
+        front[r * m + c]
+    }
+}
+
+// Find a stable pivot among the candidate columns `j..num_candidates` of a partially eliminated front (threshold partial pivoting)
+//
+// A 1x1 pivot `a_cc` is accepted if `|a_cc| >= u max |a_ic|`. Otherwise, a 2x2 pivot is formed with the candidate `r` that has the largest `|a_rc|`,
+// and accepted if `|D⁻¹| [γ_c, γ_r]ᵀ <= 1 / u` (where `γ` are the largest entries of each column outside of the block)
+fn find_pivot(
+    front: &[f64],
+    m: usize,
+    j: usize,
+    num_candidates: usize,
+    pivot_tolerance: f64,
+) -> Option<PivotChoice> {
+    let entry = |r: usize, c: usize| sym_entry(front, m, r, c);
+    let column_max = |c: usize, skip: usize| {
+        (j..m)
+            .filter(|i| *i != c && *i != skip)
+            .fold(0.0_f64, |max, i| max.max(entry(i, c).abs()))
+    };
+
+    for c in j..num_candidates {
+        let a_cc = entry(c, c);
+        if a_cc.abs() > pivot_tolerance && a_cc.abs() >= PIVOT_THRESHOLD * column_max(c, c) {
+            return Some(PivotChoice::One(c));
+        }
+
+        let r = match (j..num_candidates)
+            .filter(|i| *i != c)
+            .max_by(|a, b| entry(*a, c).abs().total_cmp(&entry(*b, c).abs()))
+        {
+            Some(r) => r,
+            None => continue,
+        };
+        let (a_rc, a_rr) = (entry(r, c), entry(r, r));
+        let det = a_cc * a_rr - a_rc * a_rc;
+        if !(det.abs() > pivot_tolerance * a_rc.abs()) {
+            continue;
+        }
+
+        let (gamma_c, gamma_r) = (column_max(c, r), column_max(r, c));
+        let bound = det.abs() / PIVOT_THRESHOLD;
+        if a_rr.abs() * gamma_c + a_rc.abs() * gamma_r <= bound
+            && a_rc.abs() * gamma_c + a_cc.abs() * gamma_r <= bound
+        {
+            return Some(PivotChoice::Two(c, r));
+        }
+    }
+    None
+}
+
+// Symmetrically swap rows/columns `a` and `b` of a front (including the rows of its eliminated columns)
+fn swap_symmetric(front: &mut [f64], rows: &mut [usize], m: usize, a: usize, b: usize) {
+    if a == b {
+        return;
+    }
+    let (a, b) = if a < b { (a, b) } else { (b, a) };
+    rows.swap(a, b);
+
+    front.swap(a * m + a, b * m + b);
+    for i in 0..a {
+        front.swap(i * m + a, i * m + b);
+    }
+    for i in a + 1..b {
+        front.swap(a * m + i, i * m + b);
+    }
+    for i in b + 1..m {
+        front.swap(a * m + i, b * m + i);
+    }
+}
+
+// Eliminate column `j` of a front with a 1x1 pivot
+fn eliminate_1x1(front: &mut [f64], m: usize, j: usize) -> Pivot {
+    let pivot = front[j * m + j];
+    let (eliminated, trailing) = front.split_at_mut((j + 1) * m);
+    let col_j = &mut eliminated[j * m..];
+    for c in j + 1..m {
+        let l_cj = col_j[c] / pivot;
+        if l_cj != 0.0 {
+            let col_c = &mut trailing[(c - j - 1) * m..(c - j) * m];
+            for r in c..m {
+                col_c[r] -= col_j[r] * l_cj;
+            }
+        }
+    }
+    for l_rj in col_j[j + 1..].iter_mut() {
+        *l_rj /= pivot;
+    }
+    Pivot::One(pivot)
+}
+
+// Eliminate columns `j` and `j + 1` of a front with a 2x2 pivot
+fn eliminate_2x2(front: &mut [f64], m: usize, j: usize) -> Pivot {
+    let (d11, d21, d22) = (
+        front[j * m + j],
+        front[j * m + j + 1],
+        front[(j + 1) * m + j + 1],
+    );
+    let det = d11 * d22 - d21 * d21;
+
+    // columns of the block (below the block), and the corresponding columns of L = [w1 w2] D⁻¹
+    let w1 = front[j * m + j + 2..(j + 1) * m].to_vec();
+    let w2 = front[(j + 1) * m + j + 2..(j + 2) * m].to_vec();
+    let l1: Vec<f64> = w1
+        .iter()
+        .zip(w2.iter())
+        .map(|(a, b)| (d22 * a - d21 * b) / det)
+        .collect();
+    let l2: Vec<f64> = w1
+        .iter()
+        .zip(w2.iter())
+        .map(|(a, b)| (d11 * b - d21 * a) / det)
+        .collect();
+
+    for c in j + 2..m {
+        let (w1_c, w2_c) = (w1[c - j - 2], w2[c - j - 2]);
+        if w1_c != 0.0 || w2_c != 0.0 {
+            let col_c = &mut front[c * m..(c + 1) * m];
+            for r in c..m {
+                col_c[r] -= l1[r - j - 2] * w1_c + l2[r - j - 2] * w2_c;
+            }
+        }
+    }
+
+    front[j * m + j + 1] = 0.0;
+    front[j * m + j + 2..(j + 1) * m].copy_from_slice(&l1);
+    front[(j + 1) * m + j + 2..(j + 2) * m].copy_from_slice(&l2);
+    Pivot::Two([d11, d21, d22])
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::fem_domain::basis::hierarchical_basis_fns::poly::HierPoly;
+    use crate::fem_domain::domain::{
+        mesh::{h_refinement::HRef, p_refinement::PRef, Mesh},
+        ContinuityCondition, Domain,
+    };
+    use crate::fem_problem::galerkin::galerkin_sample_gep_hcurl;
+    use crate::fem_problem::integration::integrals::{curl_curl::CurlCurl, inner::L2Inner};
+    use crate::fem_problem::linalg::skyline::SkylineLDL;
+
+    #[test]
+    fn multifrontal_solve() {
+        let mut mesh = Mesh::from_file("./test_input/test_mesh_b.json").unwrap();
+        mesh.global_p_refinement(PRef::from(2, 2));
+        mesh.global_h_refinement(HRef::T);
+        mesh.h_refine_elems(vec![6, 9, 12], HRef::T).unwrap();
+        let domain = Domain::from_mesh(mesh, ContinuityCondition::HCurl);
+        let gep = galerkin_sample_gep_hcurl::<HierPoly, CurlCurl, L2Inner>(&domain, Some([8, 8]))
+            .unwrap();
+
+        let symbolic = Arc::new(SymbolicLDL::from_gep(&gep));
+        let x: Vec<f64> = (0..gep.dimension()).map(|i| (i as f64).sin()).collect();
+        let [ax, bx] = gep.mul_vec(&x);
+
+        // one analysis, several shifts
+        for shift in [0.5, 1.3, 2.7] {
+            let ldl = MultifrontalLDL::shifted(&symbolic, &gep, shift).unwrap();
+            let rhs: Vec<f64> = ax
+                .iter()
+                .zip(bx.iter())
+                .map(|(a, b)| a - shift * b)
+                .collect();
+
+            for solution in ldl.solve_many(&[rhs.clone(), rhs]) {
+                for (expected, computed) in x.iter().zip(solution) {
+                    assert!((expected - computed).abs() < 1e-8);
+                }
+            }
+
+            let skyline_ldl = SkylineLDL::shifted(&gep, shift).unwrap();
+            assert_eq!(ldl.num_negative_pivots(), skyline_ldl.num_negative_pivots());
+        }
+    }
+
+    #[test]
+    fn indefinite_2x2_pivots() {
+        // an SPD tridiagonal matrix with an embedded [[0, 1], [1, 0]] block (which has no stable 1x1 pivot), and a tridiagonal matrix with a zero diagonal
+        let embedded_block: Vec<([usize; 2], f64)> = (0..8)
+            .filter(|i| *i != 3 && *i != 4)
+            .map(|i| ([i, i], 4.0))
+            .chain([0, 1, 5, 6].iter().map(|i| ([*i, i + 1], 1.0)))
+            .chain(std::iter::once(([3, 4], 1.0)))
+            .collect();
+        let zero_diagonal: Vec<([usize; 2], f64)> = (0..19).map(|i| ([i, i + 1], 1.0)).collect();
+
+        for (dim, entries, expected_negative) in [(8, embedded_block, 1), (20, zero_diagonal, 10)] {
+            let pattern = SparsityPattern::from_coordinates(
+                dim,
+                entries
+                    .iter()
+                    .map(|(rc, _)| *rc)
+                    .chain((0..dim).map(|i| [i, i])),
+            );
+            let mut matrix = CsrMatrix::new(pattern);
+            matrix.insert_group(&entries);
+
+            // unpivoted elimination breaks down
+            assert!(SkylineLDL::new(&matrix).is_err());
+
+            let symbolic = Arc::new(SymbolicLDL::new(
+                &[matrix.pattern()],
+                DoFOrdering::NestedDissection,
+            ));
+            let ldl = MultifrontalLDL::new(&symbolic, &matrix).unwrap();
+            assert!(ldl.num_2x2_pivots() > 0);
+            assert_eq!(ldl.num_negative_pivots(), expected_negative);
+
+            let x: Vec<f64> = (0..dim).map(|i| (i as f64 + 1.0).cos()).collect();
+            for (expected, computed) in x.iter().zip(ldl.solve(&matrix.mul_vec(&x))) {
+                assert!((expected - computed).abs() < 1e-12);
+            }
+        }
+    }
+}
@@ -2,53 +2,101 @@ use super::{EigenPair, GEP};
 use nalgebra::SymmetricEigen;
 use std::fmt;
 
-// TODO: use Nalgebra's Sparse crate
-const MAX_DENSE_SIZE: usize = 1000;
+// number of dense n×n matrices alive at once during a solve (A, B, L⁻¹A, L⁻¹AL⁻ᵀ, and the eigenvectors)
+const NUM_DENSE_MATRICES: usize = 5;
+// size limit used when the available memory cannot be determined
+const FALLBACK_MAX_DENSE_SIZE: usize = 1000;
 
 /// This function is only recommended in scenarios where the problem size is small and the B-matrix is known to be very well conditioned
 ///
-/// This function directly inverts the B-matrix using Nalgebra's Cholesky Decomposition which does not work well when B is ill-conditioned.
-/// It also casts the sparse-matrices as dense matrix objects which uses a very large amount of memory when the matrices are large.
+/// The B-matrix is Cholesky factored (`B = LLᵀ`) using Nalgebra, which does not work well when B is ill-conditioned.
+/// The problem is then reduced to the standard symmetric problem `L⁻¹AL⁻ᵀy = λy` with triangular solves, and the Eigenvectors are recovered as `u = L⁻ᵀy`.
+/// The sparse-matrices are cast as dense matrix objects, which uses a very large amount of memory when the matrices are large;
+/// problems whose dense matrices would not fit in the available memory are rejected.
 ///
 /// For larger or more difficult problems the SLEPC Solver is recommended.
 pub fn nalgebra_solve_gep(gep: GEP, target_eigenvalue: f64) -> Result<EigenPair, NalgebraGEPError> {
-    if gep.a.dimension > MAX_DENSE_SIZE {
+    let mut pairs = nalgebra_solve_gep_k(gep, target_eigenvalue, 1)?;
+    Ok(pairs.remove(0))
+}
+
+/// Like [nalgebra_solve_gep], except that the `k` Eigenpairs whose Eigenvalues are closest to `target_eigenvalue` are returned (sorted by their distance from the target)
+///
+/// All Eigenpairs are computed by the dense decomposition anyway, so this costs the same as finding a single pair.
+pub fn nalgebra_solve_gep_k(
+    gep: GEP,
+    target_eigenvalue: f64,
+    k: usize,
+) -> Result<Vec<EigenPair>, NalgebraGEPError> {
+    if !fits_in_memory(gep.dimension()) {
         return Err(NalgebraGEPError::ProblemTooLarge);
     }
     let [a_mat, b_mat] = gep.to_nalgebra_dense_mats();
-    if let Some(cholesky_decomp) = b_mat.cholesky() {
-        let b_inverse = cholesky_decomp.inverse();
-        let ba_product = b_inverse * a_mat;
-        let ba_se_decomp = SymmetricEigen::new(ba_product);
+    let l = match b_mat.cholesky() {
+        Some(cholesky_decomp) => cholesky_decomp.l(),
+        None => return Err(NalgebraGEPError::FailedToInvertB),
+    };
 
-        if ba_se_decomp.eigenvalues.iter().all(|e| e.abs() < 1e-12) {
-            return Err(NalgebraGEPError::SpuriouslyConverged);
-        }
+    // C = L⁻¹AL⁻ᵀ = L⁻¹(L⁻¹A)ᵀ, since A is symmetric
+    let l_inv_a = l
+        .solve_lower_triangular(&a_mat)
+        .ok_or(NalgebraGEPError::FailedToInvertB)?;
+    drop(a_mat);
+    let reduced = l
+        .solve_lower_triangular(&l_inv_a.transpose())
+        .ok_or(NalgebraGEPError::FailedToInvertB)?;
+    drop(l_inv_a);
+    let se_decomp = SymmetricEigen::new(reduced);
 
-        let mut delta_min = f64::MAX;
-        let mut delta_min_idx = 0;
-        for (eval_idx, eval) in ba_se_decomp.eigenvalues.iter().enumerate() {
-            let delta = (eval - target_eigenvalue).abs();
-            if delta < delta_min {
-                delta_min_idx = eval_idx;
-                delta_min = delta;
-            }
-        }
+    if se_decomp.eigenvalues.iter().all(|e| e.abs() < 1e-12) {
+        return Err(NalgebraGEPError::SpuriouslyConverged);
+    }
+
+    // u = L⁻ᵀy
+    let eigenvectors = l
+        .tr_solve_lower_triangular(&se_decomp.eigenvectors)
+        .ok_or(NalgebraGEPError::FailedToInvertB)?;
 
-        Ok(EigenPair {
-            value: *ba_se_decomp.eigenvalues.get(delta_min_idx).unwrap(),
-            vector: ba_se_decomp
-                .eigenvectors
-                .column(delta_min_idx)
-                .iter()
-                .cloned()
-                .collect(),
+    let mut eval_indices: Vec<usize> = (0..se_decomp.eigenvalues.len()).collect();
+    eval_indices.sort_by(|a, b| {
+        let delta_a = (se_decomp.eigenvalues[*a] - target_eigenvalue).abs();
+        let delta_b = (se_decomp.eigenvalues[*b] - target_eigenvalue).abs();
+        delta_a.partial_cmp(&delta_b).unwrap()
+    });
+
+    Ok(eval_indices
+        .into_iter()
+        .take(k)
+        .map(|eval_idx| EigenPair {
+            value: se_decomp.eigenvalues[eval_idx],
+            vector: eigenvectors.column(eval_idx).iter().cloned().collect(),
         })
-    } else {
-        Err(NalgebraGEPError::FailedToInvertB)
+        .collect())
+}
+
+// Check whether the dense matrices for a problem of the given size fit in the available memory
+fn fits_in_memory(dimension: usize) -> bool {
+    let required_bytes = NUM_DENSE_MATRICES
+        .saturating_mul(dimension)
+        .saturating_mul(dimension)
+        .saturating_mul(std::mem::size_of::<f64>());
+
+    match available_memory() {
+        Some(available_bytes) => required_bytes <= available_bytes,
+        None => dimension <= FALLBACK_MAX_DENSE_SIZE,
     }
 }
 
+// Available memory in bytes, as reported by `/proc/meminfo` (Linux only)
+fn available_memory() -> Option<usize> {
+    let meminfo = std::fs::read_to_string("/proc/meminfo").ok()?;
+    let line = meminfo
+        .lines()
+        .find(|line| line.starts_with("MemAvailable:"))?;
+    let kib: usize = line.split_whitespace().nth(1)?.parse().ok()?;
+    Some(kib.saturating_mul(1024))
+}
+
 #[derive(Debug, Clone)]
 /// Error type for the SlepcGEP solver
 pub enum NalgebraGEPError {
@@ -69,8 +117,7 @@ impl std::fmt::Display for NalgebraGEPError {
             Self::SpuriouslyConverged => write!(f, "Only spurious modes were found!"),
             Self::ProblemTooLarge => write!(
                 f,
-                "Matrices Exceeded Maximum Size ({}x{}); Cannot Solve!",
-                MAX_DENSE_SIZE, MAX_DENSE_SIZE
+                "Dense Matrices would Exceed the Available Memory; Cannot Solve!"
             ),
         }
     }
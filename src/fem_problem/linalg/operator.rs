@@ -0,0 +1,57 @@
+use super::{csr_matrix::CsrMatrix, GEP};
+
+/// A square-symmetric linear operator which can be applied to vectors
+///
+/// This is the interface used by iterative solvers, such that they work with assembled matrices and matrix-free operators alike
+pub trait LinearOperator: Sync {
+    /// Size of the operator
+    fn dimension(&self) -> usize;
+
+    /// Compute `y = Mx`
+    fn apply(&self, x: &[f64]) -> Vec<f64>;
+}
+
+impl LinearOperator for CsrMatrix {
+    fn dimension(&self) -> usize {
+        self.dimension()
+    }
+
+    fn apply(&self, x: &[f64]) -> Vec<f64> {
+        self.mul_vec(x)
+    }
+}
+
+/// The pair of operators `A` and `B` in a Generalized Eigenvalue Problem: `Au = λBu`
+pub trait GEPOperator: Sync {
+    /// Size of the operators
+    fn dimension(&self) -> usize;
+
+    /// Compute `Ax`
+    fn apply_a(&self, x: &[f64]) -> Vec<f64>;
+
+    /// Compute `Bx`
+    fn apply_b(&self, x: &[f64]) -> Vec<f64>;
+
+    /// Compute `[Ax, Bx]`. Implementors should override this if both products can be computed together more cheaply
+    fn apply_both(&self, x: &[f64]) -> [Vec<f64>; 2] {
+        [self.apply_a(x), self.apply_b(x)]
+    }
+}
+
+impl GEPOperator for GEP {
+    fn dimension(&self) -> usize {
+        self.dimension()
+    }
+
+    fn apply_a(&self, x: &[f64]) -> Vec<f64> {
+        self.a.mul_vec(x)
+    }
+
+    fn apply_b(&self, x: &[f64]) -> Vec<f64> {
+        self.b.mul_vec(x)
+    }
+
+    fn apply_both(&self, x: &[f64]) -> [Vec<f64>; 2] {
+        self.mul_vec(x)
+    }
+}
@@ -0,0 +1,146 @@
+use super::bsr_matrix::BlockPartition;
+use super::csr_matrix::CsrMatrix;
+use super::GEP;
+use nalgebra::DMatrix;
+use rayon::prelude::*;
+
+/// An approximation of the inverse of a (shifted) system matrix, used to accelerate iterative solvers
+pub trait Preconditioner: Sync {
+    /// Size of the preconditioner
+    fn dimension(&self) -> usize;
+
+    /// Apply the preconditioner to a (residual) vector
+    fn apply(&self, r: &[f64]) -> Vec<f64>;
+}
+
+/// A preconditioner that does nothing
+pub struct IdentityPreconditioner(pub usize);
+
+impl Preconditioner for IdentityPreconditioner {
+    fn dimension(&self) -> usize {
+        self.0
+    }
+
+    fn apply(&self, r: &[f64]) -> Vec<f64> {
+        r.to_vec()
+    }
+}
+
+/// Block-Jacobi preconditioner: the inverses of the diagonal blocks of a symmetric matrix over a [BlockPartition]
+///
+/// With [BlockPartition::from_domain], each block couples all of the expansion orders on a single `Elem`, `Edge`, or `Node`, which captures most of the
+/// ill-conditioning introduced by high-order hierarchical basis functions.
+///
+/// Each block is inverted through a dense Cholesky decomposition. Blocks that are not positive definite fall back to the inverse of their diagonal.
+pub struct BlockJacobi {
+    partition: BlockPartition,
+    // inverse of each diagonal block
+    inverses: Vec<DMatrix<f64>>,
+}
+
+impl BlockJacobi {
+    /// Invert the diagonal blocks of a matrix
+    pub fn new(matrix: &CsrMatrix, partition: BlockPartition) -> Self {
+        Self::from_terms(&[(matrix, 1.0)], partition)
+    }
+
+    /// Invert the diagonal blocks of the shifted matrix `A - σB` of a [GEP]
+    ///
+    /// For Eigenvalues above `σ`, a shift below the lowest wanted Eigenvalue (but not so far below that `A` dominates) tends to work well
+    pub fn shifted(gep: &GEP, shift: f64, partition: BlockPartition) -> Self {
+        Self::from_terms(&[(&gep.a, 1.0), (&gep.b, -shift)], partition)
+    }
+
+    // Invert the diagonal blocks of a linear combination of matrices
+    fn from_terms(terms: &[(&CsrMatrix, f64)], partition: BlockPartition) -> Self {
+        assert!(
+            terms
+                .iter()
+                .all(|(matrix, _)| matrix.dimension() == partition.dimension()),
+            "Matrix dimension does not match the BlockPartition; cannot construct BlockJacobi!"
+        );
+
+        let inverses = (0..partition.num_blocks())
+            .into_par_iter()
+            .map(|block_idx| {
+                let range = partition.range(block_idx);
+                let size = range.len();
+                let mut block = DMatrix::zeros(size, size);
+
+                for (matrix, coeff) in terms {
+                    let pattern = matrix.pattern();
+                    for r in range.clone() {
+                        let row_start = pattern.row_offsets()[r];
+                        for (offset, c) in pattern.row(r).iter().enumerate() {
+                            let c = *c as usize;
+                            if c >= range.end {
+                                break;
+                            }
+                            let value = coeff * matrix.values()[row_start + offset];
+                            block[(r - range.start, c - range.start)] += value;
+                            if c != r {
+                                block[(c - range.start, r - range.start)] += value;
+                            }
+                        }
+                    }
+                }
+
+                let diagonal: Vec<f64> = (0..size).map(|i| block[(i, i)]).collect();
+                match block.cholesky() {
+                    Some(cholesky) => cholesky.inverse(),
+                    None => DMatrix::from_fn(size, size, |r, c| {
+                        if r == c && diagonal[r] != 0.0 {
+                            1.0 / diagonal[r]
+                        } else {
+                            0.0
+                        }
+                    }),
+                }
+            })
+            .collect();
+
+        Self {
+            partition,
+            inverses,
+        }
+    }
+}
+
+impl Preconditioner for BlockJacobi {
+    fn dimension(&self) -> usize {
+        self.partition.dimension()
+    }
+
+    fn apply(&self, r: &[f64]) -> Vec<f64> {
+        assert_eq!(
+            r.len(),
+            self.dimension(),
+            "Vector length does not match the preconditioner dimension; cannot apply BlockJacobi!"
+        );
+
+        let mut z = vec![0.0; r.len()];
+        let mut blocks = Vec::with_capacity(self.inverses.len());
+        let mut rest = z.as_mut_slice();
+        for block_idx in 0..self.partition.num_blocks() {
+            let (block, tail) = rest.split_at_mut(self.partition.block_size(block_idx));
+            blocks.push(block);
+            rest = tail;
+        }
+
+        blocks
+            .into_par_iter()
+            .enumerate()
+            .for_each(|(block_idx, z_block)| {
+                let range = self.partition.range(block_idx);
+                let inverse = &self.inverses[block_idx];
+                for (i, z_i) in z_block.iter_mut().enumerate() {
+                    *z_i = range
+                        .clone()
+                        .enumerate()
+                        .map(|(j, r_idx)| inverse[(i, j)] * r[r_idx])
+                        .sum();
+                }
+            });
+        z
+    }
+}
@@ -0,0 +1,269 @@
+use super::csr_matrix::{CsrMatrix, SparsityPattern};
+use super::GEP;
+use crate::fem_domain::domain::renumbering::{graph_ordering, DoFOrdering};
+use std::fmt;
+
+/// Pivots whose magnitude is smaller than this fraction of the largest diagonal entry are treated as zero
+pub(super) const PIVOT_TOLERANCE: f64 = 1e-14;
+
+/// An LDLᵀ factorization of a sparse symmetric matrix, stored in profile (skyline) form
+///
+/// Rows and columns are first permuted into Reverse Cuthill–McKee order, which keeps the non-zero entries of each row close to the diagonal.
+/// Only the entries between the first non-zero entry of each row and the diagonal (the row's profile) are stored, since fill-in can only occur within the profile.
+///
+/// No pivoting is done, so factorization fails if a (nearly) zero pivot is encountered. Shifted system matrices `A - σB` can generally be factored unless `σ` is very close to an eigenvalue,
+/// but the factor can be inaccurate for strongly indefinite matrices (see: [MultifrontalLDL](super::multifrontal::MultifrontalLDL), which pivots).
+#[derive(Clone, Debug)]
+pub struct SkylineLDL {
+    // original index of each permuted row
+    order: Vec<usize>,
+    // first column in the profile of each (permuted) row
+    first_cols: Vec<usize>,
+    // position of the first entry of each row's profile in `lower` (with one extra entry marking the end of the last row)
+    row_offsets: Vec<usize>,
+    // strictly lower entries of L
+    lower: Vec<f64>,
+    // entries of D
+    diagonal: Vec<f64>,
+}
+
+impl SkylineLDL {
+    /// Factor a symmetric matrix
+    pub fn new(matrix: &CsrMatrix) -> Result<Self, FactorizationError> {
+        Self::factor(&[(matrix, 1.0)])
+    }
+
+    /// Factor the shifted matrix `A - σB` of a [GEP] without assembling it
+    pub fn shifted(gep: &GEP, shift: f64) -> Result<Self, FactorizationError> {
+        Self::factor(&[(&gep.a, 1.0), (&gep.b, -shift)])
+    }
+
+    /// Size of the factored matrix
+    pub fn dimension(&self) -> usize {
+        self.diagonal.len()
+    }
+
+    /// Number of stored entries in the strictly lower triangle of L
+    pub fn profile_size(&self) -> usize {
+        self.lower.len()
+    }
+
+    /// Number of negative entries in D (i.e. the number of negative eigenvalues of the factored matrix)
+    pub fn num_negative_pivots(&self) -> usize {
+        self.diagonal.iter().filter(|d| **d < 0.0).count()
+    }
+
+    /// Solve `Mx = b` for `x`, where `M` is the factored matrix
+    pub fn solve(&self, rhs: &[f64]) -> Vec<f64> {
+        assert_eq!(
+            rhs.len(),
+            self.dimension(),
+            "Vector length does not match the matrix dimension; cannot solve!"
+        );
+        let mut y: Vec<f64> = self.order.iter().map(|old| rhs[*old]).collect();
+
+        // L z = b
+        for i in 0..y.len() {
+            let row = self.row(i);
+            let first = self.first_cols[i];
+            y[i] -= row
+                .iter()
+                .zip(y[first..i].iter())
+                .map(|(l, z)| l * z)
+                .sum::<f64>();
+        }
+
+        // D w = z
+        for (w, d) in y.iter_mut().zip(self.diagonal.iter()) {
+            *w /= d;
+        }
+
+        // Lᵀ y = w
+        for i in (0..y.len()).rev() {
+            let y_i = y[i];
+            let first = self.first_cols[i];
+            for (y_k, l) in y[first..i].iter_mut().zip(self.row(i)) {
+                *y_k -= l * y_i;
+            }
+        }
+
+        let mut x = vec![0.0; y.len()];
+        for (y_p, old) in y.into_iter().zip(self.order.iter()) {
+            x[*old] = y_p;
+        }
+        x
+    }
+
+    // Factor a linear combination of matrices
+    fn factor(terms: &[(&CsrMatrix, f64)]) -> Result<Self, FactorizationError> {
+        let dim = terms[0].0.dimension();
+        assert!(
+            terms.iter().all(|(matrix, _)| matrix.dimension() == dim),
+            "Matrices have different dimensions; cannot factor!"
+        );
+
+        // ordering
+        let patterns: Vec<&SparsityPattern> =
+            terms.iter().map(|(matrix, _)| matrix.pattern()).collect();
+        let adjacency = SparsityPattern::union_adjacency(&patterns);
+        let order = graph_ordering(&adjacency, DoFOrdering::ReverseCuthillMcKee);
+        let mut position = vec![0; dim];
+        for (p, old) in order.iter().enumerate() {
+            position[*old] = p;
+        }
+
+        // profile
+        let first_cols: Vec<usize> = order
+            .iter()
+            .enumerate()
+            .map(|(p, old)| {
+                adjacency[*old]
+                    .iter()
+                    .map(|q| position[*q])
+                    .fold(p, |first, q| first.min(q))
+            })
+            .collect();
+        let mut row_offsets = Vec::with_capacity(dim + 1);
+        row_offsets.push(0);
+        for (p, first) in first_cols.iter().enumerate() {
+            row_offsets.push(row_offsets[p] + p - first);
+        }
+        drop(adjacency);
+
+        // values
+        let mut lower = vec![0.0; row_offsets[dim]];
+        let mut diagonal = vec![0.0; dim];
+        for (matrix, coeff) in terms {
+            for ([r, c], value) in matrix.iter_upper_tri() {
+                let [p, q] = [position[r], position[c]];
+                if p == q {
+                    diagonal[p] += coeff * value;
+                } else {
+                    let (row, col) = if p > q { (p, q) } else { (q, p) };
+                    lower[row_offsets[row] + col - first_cols[row]] += coeff * value;
+                }
+            }
+        }
+
+        let mut factorization = Self {
+            order,
+            first_cols,
+            row_offsets,
+            lower,
+            diagonal,
+        };
+        factorization.factor_in_place()?;
+        Ok(factorization)
+    }
+
+    // Overwrite the stored matrix with its LDLᵀ factorization (row-oriented Crout elimination)
+    fn factor_in_place(&mut self) -> Result<(), FactorizationError> {
+        let pivot_tolerance = PIVOT_TOLERANCE
+            * self
+                .diagonal
+                .iter()
+                .fold(0.0_f64, |max, d| max.max(d.abs()));
+
+        for i in 0..self.dimension() {
+            let first_i = self.first_cols[i];
+            let (previous_rows, rest) = self.lower.split_at_mut(self.row_offsets[i]);
+            let row_i = &mut rest[..i - first_i];
+
+            // row_i[j] = l_ij * d_j (for now)
+            for j in first_i..i {
+                let first_j = self.first_cols[j];
+                let row_j = &previous_rows[self.row_offsets[j]..self.row_offsets[j + 1]];
+                let start = first_i.max(first_j);
+
+                let update: f64 = row_i[start - first_i..j - first_i]
+                    .iter()
+                    .zip(row_j[start - first_j..].iter())
+                    .map(|(w_ik, l_jk)| w_ik * l_jk)
+                    .sum();
+                row_i[j - first_i] -= update;
+            }
+
+            let mut d_i = self.diagonal[i];
+            for (w_ij, d_j) in row_i.iter_mut().zip(self.diagonal[first_i..i].iter()) {
+                let l_ij = *w_ij / d_j;
+                d_i -= *w_ij * l_ij;
+                *w_ij = l_ij;
+            }
+
+            if d_i.abs() <= pivot_tolerance || !d_i.is_finite() {
+                return Err(FactorizationError::ZeroPivot(self.order[i]));
+            }
+            self.diagonal[i] = d_i;
+        }
+
+        Ok(())
+    }
+
+    fn row(&self, i: usize) -> &[f64] {
+        &self.lower[self.row_offsets[i]..self.row_offsets[i + 1]]
+    }
+}
+
+#[derive(Debug, Clone)]
+/// Error type for sparse factorizations
+pub enum FactorizationError {
+    /// A (nearly) zero pivot was encountered while eliminating the given row
+    ZeroPivot(usize),
+}
+
+impl std::error::Error for FactorizationError {}
+
+impl fmt::Display for FactorizationError {
+    fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
+        match self {
+            Self::ZeroPivot(row) => write!(
+                f,
+                "Encountered a zero pivot at row {}; matrix is singular or requires pivoting!",
+                row
+            ),
+        }
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+
+    #[test]
+    fn skyline_solve() {
+        // indefinite: a 1D Laplacian shifted past its smallest eigenvalues
+        let dim = 12;
+        let pattern = SparsityPattern::from_coordinates(
+            dim,
+            (0..dim)
+                .map(|i| [i, i])
+                .chain((1..dim).map(|i| [i - 1, i]))
+                .chain([[0, dim - 1], [3, 8]]),
+        );
+        let mut gep = GEP::new(pattern);
+        for i in 0..dim {
+            gep.a.insert([i, i], 2.0);
+            gep.b.insert([i, i], 1.0);
+            if i > 0 {
+                gep.a.insert([i - 1, i], -1.0);
+            }
+        }
+        gep.a.insert([0, dim - 1], 0.5);
+        gep.a.insert([3, 8], -0.25);
+
+        let shift = 1.3;
+        let ldl = SkylineLDL::shifted(&gep, shift).unwrap();
+
+        let x: Vec<f64> = (0..dim).map(|i| (i as f64).sin()).collect();
+        let [ax, bx] = gep.mul_vec(&x);
+        let rhs: Vec<f64> = ax
+            .iter()
+            .zip(bx.iter())
+            .map(|(a, b)| a - shift * b)
+            .collect();
+
+        for (expected, computed) in x.iter().zip(ldl.solve(&rhs)) {
+            assert!((expected - computed).abs() < 1e-12);
+        }
+    }
+}
@@ -1,26 +1,213 @@
+use super::sparse_matrix::{invalid_data, read_stream_section, AIJMatrixBinary};
 use super::{EigenPair, GEP};
+use crate::fem_problem::galerkin::out_of_core::OutOfCoreGEP;
 use std::fmt;
 
 use std::collections::hash_map::DefaultHasher;
 use std::hash::{Hash, Hasher};
 use std::time::SystemTime;
 
-use bytes::{Buf, BytesMut};
+use bytes::{Buf, BufMut, BytesMut};
 use std::env::var_os;
 use std::fs::File;
-use std::io::Read;
-use std::process::Command;
+use std::io::{BufReader, BufWriter, Read, Write};
+use std::process::{Command, Stdio};
 
+/// A long-lived external solver process, which receives matrices and returns Eigenpairs over a Unix socket
+///
+/// Starting `mpiexec` and initializing SLEPc for every solve can cost more than the solve itself, particularly in adaptive loops where many small problems are solved in sequence.
+/// A [SlepcWorker](worker::SlepcWorker) starts the solver once (as `./solve_gep -worker {socket}`) and then exchanges problems and solutions with it over the socket, without touching the `/tmp/` directory.
+///
+/// # Protocol:
+///
+/// All values are big-endian (as in PETSc's binary format). Each request is one of:
+///
+/// * **Solve**: `u32` = 1, the target Eigenvalue (`f64`), the number of wanted Eigenpairs (`u32`), the number of initial vectors (`u32`, 0 or 1) followed by each of them
+///   in PETSc's binary vector format, then the A and B matrices in PETSc's binary AIJ format
+/// * **Shutdown**: `u32` = 0, after which the worker exits
+///
+/// Each Solve request is answered with a `u32` status (0 on success, otherwise one of the `solve_gep` exit codes), the number of Eigenpairs returned (`u32`),
+/// and then each Eigenvalue (`f64`) followed by its Eigenvector in PETSc's binary vector format.
+///
+/// A [LocalWorker](worker::LocalWorker) implements the same protocol in-process (using the Lanczos solver), so that code built on a worker can be tested without SLEPc.
+#[cfg(unix)]
+pub mod worker;
+
+/// A Generalized Eigenvalue Problem that can be handed to the external solver as a pair of PETSc binary matrix files
+pub trait PetscBinaryGEP {
+    /// Size of the square A and B matrices
+    fn dimension(&self) -> usize;
+
+    /// Place the A and B matrices at `{dir}/tmp/{prefix}_a.dat` and `{dir}/tmp/{prefix}_b.dat`
+    fn write_petsc_binary_files(self, dir: &str, prefix: &str) -> std::io::Result<()>;
+
+    /// Write the A and B matrices to a stream (in that order), without touching the solver's directory
+    fn write_petsc_binary_stream<W: Write>(self, writer: &mut W) -> std::io::Result<()>;
+}
+
+impl PetscBinaryGEP for GEP {
+    fn dimension(&self) -> usize {
+        GEP::dimension(self)
+    }
+
+    fn write_petsc_binary_files(self, dir: &str, prefix: &str) -> std::io::Result<()> {
+        self.print_to_petsc_binary_files(dir, prefix)
+    }
+
+    fn write_petsc_binary_stream<W: Write>(self, writer: &mut W) -> std::io::Result<()> {
+        AIJMatrixBinary::from(self.a).write_petsc_binary(writer)?;
+        AIJMatrixBinary::from(self.b).write_petsc_binary(writer)
+    }
+}
+
+impl PetscBinaryGEP for OutOfCoreGEP {
+    fn dimension(&self) -> usize {
+        self.dimension
+    }
+
+    /// The files are moved into the solver's directory (or copied, if they are on a different file system)
+    fn write_petsc_binary_files(self, dir: &str, prefix: &str) -> std::io::Result<()> {
+        for (from, name) in [(&self.a_path, "a"), (&self.b_path, "b")] {
+            let to = format!("{}/tmp/{}_{}.dat", dir, prefix, name);
+            if std::fs::rename(from, &to).is_err() {
+                std::fs::copy(from, &to)?;
+                std::fs::remove_file(from)?;
+            }
+        }
+        Ok(())
+    }
+
+    /// The files are copied onto the stream and then removed
+    fn write_petsc_binary_stream<W: Write>(self, writer: &mut W) -> std::io::Result<()> {
+        for path in [&self.a_path, &self.b_path] {
+            std::io::copy(&mut File::open(path)?, writer)?;
+        }
+        for path in [&self.a_path, &self.b_path] {
+            std::fs::remove_file(path)?;
+        }
+        Ok(())
+    }
+}
+
+/// Solve a Generalized Eigenvalue Problem with the external SLEPc solver, returning the Eigenpair whose Eigenvalue is closest to `target_eigenvalue`
+///
+/// The problem can be an assembled [GEP], or an [OutOfCoreGEP] whose matrices are already on disk
 pub fn slepc_solve_gep(
-    gep: GEP,
+    gep: impl PetscBinaryGEP,
     target_eigenvalue: f64,
 ) -> Result<EigenPair, Box<dyn std::error::Error>> {
+    let mut pairs = run_solver(gep, target_eigenvalue, None, None)?;
+    Ok(pairs.remove(0))
+}
+
+/// Solve a Generalized Eigenvalue Problem with the external SLEPc solver, returning the `k` Eigenpairs whose Eigenvalues are closest to `target_eigenvalue` (sorted by their distance from the target)
+///
+/// All pairs are computed in a single invocation of the solver, which is passed `-nev k`. It returns the Eigenvalues together in `{prefix}_eval.dat`, and each Eigenvector in `{prefix}_evec_{i}.dat`.
+/// If the solver converges on fewer than `k` pairs, only those are returned.
+pub fn slepc_solve_gep_k(
+    gep: impl PetscBinaryGEP,
+    target_eigenvalue: f64,
+    k: usize,
+) -> Result<Vec<EigenPair>, Box<dyn std::error::Error>> {
+    slepc_solve_gep_k_with_transport(gep, target_eigenvalue, k, SlepcTransport::Files)
+}
+
+/// How problems and solutions are exchanged with the external solver
+#[derive(Clone, Copy, Debug, PartialEq, Eq)]
+pub enum SlepcTransport {
+    /// Matrices and solutions are written to the `/tmp/` directory under `GEP_SOLVE_DIR` (see [slepc_solve_gep_k])
+    Files,
+    /// Matrices are streamed to the solver's stdin, and the Eigenpairs are read back from its stdout, without touching the file system
+    ///
+    /// The solver is run as `./solve_gep -pipe`, and exchanges a single Solve request and its response using the [worker] protocol.
+    /// This requires a version of the solver that supports the `-pipe` option (and that writes nothing else to stdout).
+    Pipes,
+}
+
+impl Default for SlepcTransport {
+    fn default() -> Self {
+        Self::Files
+    }
+}
+
+/// Like [slepc_solve_gep_k], with a choice of how the problem and solutions are exchanged with the solver
+pub fn slepc_solve_gep_k_with_transport(
+    gep: impl PetscBinaryGEP,
+    target_eigenvalue: f64,
+    k: usize,
+    transport: SlepcTransport,
+) -> Result<Vec<EigenPair>, Box<dyn std::error::Error>> {
+    if k == 0 {
+        return Ok(Vec::new());
+    }
+    let pairs = match transport {
+        SlepcTransport::Files => run_solver(gep, target_eigenvalue, Some(k), None)?,
+        SlepcTransport::Pipes => run_solver_piped(gep, target_eigenvalue, k, None)?,
+    };
+    Ok(nearest_pairs(pairs, target_eigenvalue, k)?)
+}
+
+/// Like [slepc_solve_gep_k_with_transport], except that the solver's subspace is started from `initial_vector` (such as an Eigenvector from a coarser Domain,
+/// mapped onto this problem's DoFs with [prolong_eigenvector](crate::fem_problem::galerkin::prolongation::prolong_eigenvector))
+///
+/// With [SlepcTransport::Files], the vector is written to `{prefix}_init.dat` and the solver is passed `-init`. With [SlepcTransport::Pipes], it is sent along with the matrices.
+/// Either way, this requires a version of the solver that accepts initial vectors.
+pub fn slepc_solve_gep_k_with_initial_vector(
+    gep: impl PetscBinaryGEP,
+    target_eigenvalue: f64,
+    k: usize,
+    initial_vector: &[f64],
+    transport: SlepcTransport,
+) -> Result<Vec<EigenPair>, Box<dyn std::error::Error>> {
+    if k == 0 {
+        return Ok(Vec::new());
+    }
+    let pairs = match transport {
+        SlepcTransport::Files => run_solver(gep, target_eigenvalue, Some(k), Some(initial_vector))?,
+        SlepcTransport::Pipes => run_solver_piped(gep, target_eigenvalue, k, Some(initial_vector))?,
+    };
+    Ok(nearest_pairs(pairs, target_eigenvalue, k)?)
+}
+
+// Sort Eigenpairs by the distance of their Eigenvalues from the target, keeping at most `k`
+//
+// The pairs come from another process, so non-finite Eigenvalues are reported as an error rather than trusted
+fn nearest_pairs(
+    mut pairs: Vec<EigenPair>,
+    target_eigenvalue: f64,
+    k: usize,
+) -> Result<Vec<EigenPair>, SlepcGEPError> {
+    if pairs.iter().any(|pair| !pair.value.is_finite()) {
+        return Err(SlepcGEPError::FailedToReturnSolution);
+    }
+    pairs.sort_by(|a, b| {
+        let delta_a = (a.value - target_eigenvalue).abs();
+        let delta_b = (b.value - target_eigenvalue).abs();
+        delta_a.total_cmp(&delta_b)
+    });
+    pairs.truncate(k);
+    Ok(pairs)
+}
+
+// Run the external solver, requesting a single Eigenpair (num_pairs = None) or several
+fn run_solver(
+    gep: impl PetscBinaryGEP,
+    target_eigenvalue: f64,
+    num_pairs: Option<usize>,
+    initial_vector: Option<&[f64]>,
+) -> Result<Vec<EigenPair>, Box<dyn std::error::Error>> {
     if let Some(esolve_dir) = var_os("GEP_SOLVE_DIR") {
         let dir = esolve_dir.to_str().unwrap();
         let prefix = unique_prefix();
 
-        // Write the matrices to files
-        gep.print_to_petsc_binary_files(&dir, &prefix)?;
+        // Write the matrices (and initial vector) to files
+        gep.write_petsc_binary_files(dir, &prefix)?;
+        if let Some(initial_vector) = initial_vector {
+            let mut init_file =
+                BufWriter::new(File::create(format!("{}/tmp/{}_init.dat", dir, prefix))?);
+            write_petsc_vector(&mut init_file, initial_vector)?;
+            init_file.flush()?;
+        }
 
         // Run the solver
         let esolve_exit_status = Command::new("mpiexec")
@@ -32,27 +219,27 @@ pub fn slepc_solve_gep(
             .arg(&format!("{:.10}", target_eigenvalue))
             .arg("-fp")
             .arg(&prefix)
+            .args(
+                num_pairs
+                    .map(|k| vec!["-nev".to_string(), k.to_string()])
+                    .unwrap_or_default(),
+            )
+            .args(initial_vector.map(|_| "-init"))
             .current_dir(dir)
             .status();
 
         match esolve_exit_status {
             Ok(status) => {
                 if status.success() {
-                    let solution = retrieve_solution(&dir, &prefix)?;
+                    let solution = match num_pairs {
+                        None => vec![retrieve_solution(&dir, &prefix)?],
+                        Some(_) => retrieve_solutions(&dir, &prefix)?,
+                    };
                     clean_directory(&dir, &prefix)?;
                     Ok(solution)
                 } else {
                     clean_directory(&dir, &prefix)?;
-
-                    match status.code() {
-                        Some(1) => Err(Box::new(SlepcGEPError::FailedToInitializeSlepc)),
-                        Some(2) => Err(Box::new(SlepcGEPError::BadArguments)),
-                        Some(3) => Err(Box::new(SlepcGEPError::FailedToInitializeMatrices)),
-                        Some(4 | 5 | 6) => Err(Box::new(SlepcGEPError::FailedToInitializeEPS)),
-                        Some(7) => Err(Box::new(SlepcGEPError::FailedToConverge)),
-                        Some(8) => Err(Box::new(SlepcGEPError::FailedToReturnSolution)),
-                        _ => Err(Box::new(SlepcGEPError::UnknownError)),
-                    }
+                    Err(Box::new(SlepcGEPError::from_status_code(status.code())))
                 }
             }
             Err(_) => {
@@ -67,6 +254,66 @@ pub fn slepc_solve_gep(
     }
 }
 
+// Run the external solver, streaming the problem to its stdin and reading the solutions from its stdout
+fn run_solver_piped(
+    gep: impl PetscBinaryGEP,
+    target_eigenvalue: f64,
+    num_pairs: usize,
+    initial_vector: Option<&[f64]>,
+) -> Result<Vec<EigenPair>, Box<dyn std::error::Error>> {
+    let esolve_dir = match var_os("GEP_SOLVE_DIR") {
+        Some(esolve_dir) => esolve_dir,
+        None => {
+            println!("Solver not found; please set the GEP_SOLVE_DIR environment variable to the directory containing the solver executable!");
+            return Err(Box::new(SlepcGEPError::SolverNotFound));
+        }
+    };
+
+    let mut child = Command::new("mpiexec")
+        .arg("-np")
+        .arg("1")
+        .arg("-q")
+        .arg("./solve_gep")
+        .arg("-pipe")
+        .current_dir(esolve_dir)
+        .stdin(Stdio::piped())
+        .stdout(Stdio::piped())
+        .spawn()
+        .map_err(|_| SlepcGEPError::FailedToExecute)?;
+
+    // the whole request is sent (and stdin is closed) before the solver writes its response
+    let dimension = gep.dimension();
+    let mut writer = BufWriter::with_capacity(STREAM_BUFFER_SIZE, child.stdin.take().unwrap());
+    let sent = write_request(
+        &mut writer,
+        gep,
+        target_eigenvalue,
+        num_pairs,
+        initial_vector,
+    )
+    .and_then(|_| writer.flush());
+    drop(writer);
+
+    let response = match sent {
+        Ok(_) => read_response(
+            &mut BufReader::new(child.stdout.take().unwrap()),
+            dimension,
+            num_pairs,
+        ),
+        Err(err) => Err(err.into()),
+    };
+    let status = child.wait()?;
+
+    match response {
+        Ok(pairs) => Ok(pairs),
+        // prefer the solver's own explanation of a broken exchange
+        Err(_) if !status.success() => {
+            Err(Box::new(SlepcGEPError::from_status_code(status.code())))
+        }
+        Err(err) => Err(err),
+    }
+}
+
 #[derive(Debug, Clone)]
 /// Error type for the SlepcGEP solver
 pub enum SlepcGEPError {
@@ -81,6 +328,21 @@ pub enum SlepcGEPError {
     UnknownError,
 }
 
+impl SlepcGEPError {
+    /// Interpret an (unsuccessful) exit or status code from the solver
+    pub(crate) fn from_status_code(code: Option<i32>) -> Self {
+        match code {
+            Some(1) => Self::FailedToInitializeSlepc,
+            Some(2) => Self::BadArguments,
+            Some(3) => Self::FailedToInitializeMatrices,
+            Some(4 | 5 | 6) => Self::FailedToInitializeEPS,
+            Some(7) => Self::FailedToConverge,
+            Some(8) => Self::FailedToReturnSolution,
+            _ => Self::UnknownError,
+        }
+    }
+}
+
 impl std::fmt::Display for SlepcGEPError {
     fn fmt(&self, f: &mut fmt::Formatter) -> fmt::Result {
         match self {
@@ -99,6 +361,78 @@ impl std::fmt::Display for SlepcGEPError {
 
 impl std::error::Error for SlepcGEPError {}
 
+// request and status codes of the streaming protocol (see [worker])
+const REQUEST_SOLVE: u32 = 1;
+const STATUS_SUCCESS: u32 = 0;
+
+/// Size of the buffer used to stream matrices to the solver
+const STREAM_BUFFER_SIZE: usize = 1 << 16;
+
+// Write a Solve request: the target, the number of wanted pairs, the initial vector (if any), and the matrices
+fn write_request(
+    writer: &mut impl Write,
+    gep: impl PetscBinaryGEP,
+    target_eigenvalue: f64,
+    num_pairs: usize,
+    initial_vector: Option<&[f64]>,
+) -> std::io::Result<()> {
+    let mut header = BytesMut::with_capacity(20);
+    header.put_u32(REQUEST_SOLVE);
+    header.put_f64(target_eigenvalue);
+    header.put_u32(num_pairs as u32);
+    header.put_u32(initial_vector.iter().count() as u32);
+    writer.write_all(header.as_ref())?;
+    if let Some(initial_vector) = initial_vector {
+        write_petsc_vector(writer, initial_vector)?;
+    }
+
+    gep.write_petsc_binary_stream(writer)
+}
+
+// Read the response to a Solve request for at most `max_pairs` Eigenpairs of a problem of size `dimension`
+//
+// The response comes from another process, so an `InvalidData` error is returned if it holds too many pairs, or vectors of the wrong length
+fn read_response(
+    reader: &mut impl Read,
+    dimension: usize,
+    max_pairs: usize,
+) -> Result<Vec<EigenPair>, Box<dyn std::error::Error>> {
+    let mut header = BytesMut::new();
+    header.resize(8, 0);
+    reader.read_exact(&mut header)?;
+    let status = header.get_u32();
+    let num_pairs = header.get_u32() as usize;
+
+    if status != STATUS_SUCCESS {
+        return Err(Box::new(SlepcGEPError::from_status_code(Some(
+            status as i32,
+        ))));
+    }
+    if num_pairs > max_pairs {
+        return Err(Box::new(invalid_data(
+            "Solver returned more Eigenpairs than were requested",
+        )));
+    }
+
+    (0..num_pairs)
+        .map(|_| {
+            let mut value = [0; 8];
+            reader.read_exact(&mut value)?;
+            let vector = read_petsc_vector(reader)?;
+            if vector.len() != dimension {
+                return Err(invalid_data(
+                    "Solver returned an Eigenvector whose length does not match the problem dimension",
+                )
+                .into());
+            }
+            Ok(EigenPair {
+                value: f64::from_be_bytes(value),
+                vector,
+            })
+        })
+        .collect()
+}
+
 fn retrieve_solution(dir: impl AsRef<str>, prefix: impl AsRef<str>) -> std::io::Result<EigenPair> {
     let evec = retrieve_eigenvector(format!("{}/tmp/{}_evec.dat", dir.as_ref(), prefix.as_ref()))?;
     let eval = retrieve_eigenvalue(format!("{}/tmp/{}_eval.dat", dir.as_ref(), prefix.as_ref()))?;
@@ -109,26 +443,65 @@ fn retrieve_solution(dir: impl AsRef<str>, prefix: impl AsRef<str>) -> std::io::
     })
 }
 
+fn retrieve_solutions(
+    dir: impl AsRef<str>,
+    prefix: impl AsRef<str>,
+) -> std::io::Result<Vec<EigenPair>> {
+    let evals = retrieve_eigenvalues(format!("{}/tmp/{}_eval.dat", dir.as_ref(), prefix.as_ref()))?;
+
+    evals
+        .into_iter()
+        .enumerate()
+        .map(|(i, eval)| {
+            Ok(EigenPair {
+                value: eval,
+                vector: retrieve_eigenvector(format!(
+                    "{}/tmp/{}_evec_{}.dat",
+                    dir.as_ref(),
+                    prefix.as_ref(),
+                    i
+                ))?,
+            })
+        })
+        .collect()
+}
+
 fn retrieve_eigenvector(path: String) -> std::io::Result<Vec<f64>> {
-    let mut vec_file = File::open(path)?;
+    read_petsc_vector(&mut File::open(path)?)
+}
+
+/// PETSc's class-id for binary vector files
+const PETSC_VEC_FILE_CLASSID: i32 = 1211214;
 
+// Read a vector in PETSc's binary format
+fn read_petsc_vector(reader: &mut impl Read) -> std::io::Result<Vec<f64>> {
     let mut header_bytes = BytesMut::new();
     header_bytes.resize(8, 0);
-    vec_file.read_exact(&mut header_bytes)?;
+    reader.read_exact(&mut header_bytes)?;
 
-    assert_eq!(header_bytes.get_i32(), 1211214_i32); // ensure this is a PETSC vector file
-    let m = header_bytes.get_i32() as usize;
+    // ensure this is a PETSC vector file
+    if header_bytes.get_i32() != PETSC_VEC_FILE_CLASSID {
+        return Err(invalid_data("Not a PETSc binary vector"));
+    }
+    let m = header_bytes.get_i32();
+    if m < 0 {
+        return Err(invalid_data("Negative PETSc binary vector length"));
+    }
 
-    let mut value_bytes = BytesMut::new();
-    value_bytes.resize(m * 8, 0);
-    vec_file.read_exact(&mut value_bytes)?;
+    read_stream_section(reader, m as usize, 8, |b| {
+        f64::from_be_bytes(b.try_into().unwrap())
+    })
+}
 
-    let mut values = Vec::with_capacity(m);
-    for _ in 0..m {
-        values.push(value_bytes.get_f64());
+// Write a vector in PETSc's binary format
+fn write_petsc_vector(writer: &mut impl Write, values: &[f64]) -> std::io::Result<()> {
+    let mut bytes = BytesMut::with_capacity(8 + values.len() * 8);
+    bytes.put_i32(PETSC_VEC_FILE_CLASSID);
+    bytes.put_i32(values.len() as i32);
+    for value in values {
+        bytes.put_f64(*value);
     }
-
-    Ok(values)
+    writer.write_all(bytes.as_ref())
 }
 
 fn retrieve_eigenvalue(path: String) -> std::io::Result<f64> {
@@ -143,6 +516,21 @@ fn retrieve_eigenvalue(path: String) -> std::io::Result<f64> {
     Ok(value)
 }
 
+fn retrieve_eigenvalues(path: String) -> std::io::Result<Vec<f64>> {
+    let mut eval_file = File::open(path)?;
+
+    let mut file_bytes = Vec::new();
+    eval_file.read_to_end(&mut file_bytes)?;
+    let mut file_bytes = &file_bytes[..];
+
+    let mut values = Vec::with_capacity(file_bytes.len() / 8);
+    while file_bytes.remaining() >= 8 {
+        values.push(file_bytes.get_f64());
+    }
+
+    Ok(values)
+}
+
 fn unique_prefix() -> String {
     let t_now = SystemTime::now()
         .duration_since(SystemTime::UNIX_EPOCH)
@@ -0,0 +1,640 @@
+use super::super::csr_matrix::SparsityPattern;
+use super::super::lanczos_solve::{
+    lanczos_solve_gep_k, lanczos_solve_gep_k_with_initial_vector, LanczosGEPError, LanczosSettings,
+};
+use super::super::sparse_matrix::AIJMatrixBinary;
+use super::super::{EigenPair, GEP};
+use super::{
+    nearest_pairs, read_petsc_vector, read_response, unique_prefix, write_petsc_vector,
+    write_request, PetscBinaryGEP, SlepcGEPError, REQUEST_SOLVE, STATUS_SUCCESS,
+    STREAM_BUFFER_SIZE,
+};
+
+use bytes::{Buf, BytesMut};
+use std::env::var_os;
+use std::io::{BufReader, BufWriter, Read, Write};
+use std::net::Shutdown;
+use std::os::unix::net::{UnixListener, UnixStream};
+use std::path::{Path, PathBuf};
+use std::process::{Child, Command};
+use std::sync::atomic::{AtomicBool, Ordering};
+use std::sync::{Arc, Mutex};
+use std::thread::JoinHandle;
+use std::time::{Duration, Instant};
+
+const REQUEST_SHUTDOWN: u32 = 0;
+
+/// How long to wait for a newly started worker to open its socket
+const WORKER_STARTUP_TIMEOUT: Duration = Duration::from_secs(60);
+
+/// How long to wait for a spawned worker to exit after it is asked to shut down (before it is killed)
+const WORKER_SHUTDOWN_TIMEOUT: Duration = Duration::from_secs(10);
+
+/// A connection to a long-lived solver process
+///
+/// The connection is kept open between solves. When a worker started by [SlepcWorker::spawn] is dropped, it is asked to shut down,
+/// the process is waited on (and killed if it does not exit within a few seconds), and its socket is removed.
+/// Dropping a worker obtained from [SlepcWorker::connect] only closes the connection, so that other clients can still use the worker (see: [SlepcWorker::shutdown]).
+pub struct SlepcWorker {
+    stream: UnixStream,
+    process: Option<(Child, PathBuf)>,
+}
+
+impl SlepcWorker {
+    /// Start the external solver in worker mode and connect to it
+    ///
+    /// > The environment variable `GEP_SOLVE_DIR` must be set to the location of the solver executable, which must support the `-worker` option
+    pub fn spawn() -> Result<Self, Box<dyn std::error::Error>> {
+        let esolve_dir = match var_os("GEP_SOLVE_DIR") {
+            Some(esolve_dir) => esolve_dir,
+            None => {
+                println!("Solver not found; please set the GEP_SOLVE_DIR environment variable to the directory containing the solver executable!");
+                return Err(Box::new(SlepcGEPError::SolverNotFound));
+            }
+        };
+        let dir = esolve_dir.to_str().unwrap();
+        let socket_path = PathBuf::from(format!("{}/tmp/{}.sock", dir, unique_prefix()));
+
+        let mut child = Command::new("mpiexec")
+            .arg("-np")
+            .arg("1")
+            .arg("-q")
+            .arg("./solve_gep")
+            .arg("-worker")
+            .arg(&socket_path)
+            .current_dir(dir)
+            .spawn()
+            .map_err(|_| SlepcGEPError::FailedToExecute)?;
+
+        let start = Instant::now();
+        loop {
+            if let Ok(stream) = UnixStream::connect(&socket_path) {
+                return Ok(Self {
+                    stream,
+                    process: Some((child, socket_path)),
+                });
+            }
+
+            if let Some(status) = child.try_wait()? {
+                return Err(Box::new(SlepcGEPError::from_status_code(status.code())));
+            }
+            if start.elapsed() > WORKER_STARTUP_TIMEOUT {
+                child.kill()?;
+                child.wait()?;
+                return Err(Box::new(SlepcGEPError::FailedToExecute));
+            }
+            std::thread::sleep(Duration::from_millis(10));
+        }
+    }
+
+    /// Connect to a worker that is already listening on a socket (such as a [LocalWorker])
+    pub fn connect(socket_path: impl AsRef<Path>) -> std::io::Result<Self> {
+        Ok(Self {
+            stream: UnixStream::connect(socket_path)?,
+            process: None,
+        })
+    }
+
+    /// Solve a Generalized Eigenvalue Problem, returning the Eigenpair whose Eigenvalue is closest to `target_eigenvalue`
+    pub fn solve(
+        &mut self,
+        gep: impl PetscBinaryGEP,
+        target_eigenvalue: f64,
+    ) -> Result<EigenPair, Box<dyn std::error::Error>> {
+        match self.solve_k(gep, target_eigenvalue, 1)?.pop() {
+            Some(pair) => Ok(pair),
+            None => Err(Box::new(SlepcGEPError::FailedToReturnSolution)),
+        }
+    }
+
+    /// Solve a Generalized Eigenvalue Problem, returning the `k` Eigenpairs whose Eigenvalues are closest to `target_eigenvalue` (sorted by their distance from the target)
+    pub fn solve_k(
+        &mut self,
+        gep: impl PetscBinaryGEP,
+        target_eigenvalue: f64,
+        k: usize,
+    ) -> Result<Vec<EigenPair>, Box<dyn std::error::Error>> {
+        self.request(gep, target_eigenvalue, k, None)
+    }
+
+    /// Like [SlepcWorker::solve_k], except that the solver's subspace is started from `initial_vector` (see: [slepc_solve_gep_k_with_initial_vector](super::slepc_solve_gep_k_with_initial_vector))
+    pub fn solve_k_with_initial_vector(
+        &mut self,
+        gep: impl PetscBinaryGEP,
+        target_eigenvalue: f64,
+        k: usize,
+        initial_vector: &[f64],
+    ) -> Result<Vec<EigenPair>, Box<dyn std::error::Error>> {
+        self.request(gep, target_eigenvalue, k, Some(initial_vector))
+    }
+
+    /// Ask the worker to exit (even if this handle did not start it), and wait for it if it was started by [SlepcWorker::spawn]
+    pub fn shutdown(mut self) -> std::io::Result<()> {
+        (&self.stream).write_all(&REQUEST_SHUTDOWN.to_be_bytes())?;
+        self.wait_for_process()
+    }
+
+    fn request(
+        &mut self,
+        gep: impl PetscBinaryGEP,
+        target_eigenvalue: f64,
+        k: usize,
+        initial_vector: Option<&[f64]>,
+    ) -> Result<Vec<EigenPair>, Box<dyn std::error::Error>> {
+        if k == 0 {
+            return Ok(Vec::new());
+        }
+
+        let dimension = gep.dimension();
+        let mut writer = BufWriter::with_capacity(STREAM_BUFFER_SIZE, &self.stream);
+        write_request(&mut writer, gep, target_eigenvalue, k, initial_vector)?;
+        writer.flush()?;
+        drop(writer);
+
+        let pairs = read_response(&mut BufReader::new(&self.stream), dimension, k)?;
+        Ok(nearest_pairs(pairs, target_eigenvalue, k)?)
+    }
+
+    // Wait for a spawned process to exit (killing it after a timeout) and remove its socket
+    fn wait_for_process(&mut self) -> std::io::Result<()> {
+        let (mut child, socket_path) = match self.process.take() {
+            Some(process) => process,
+            None => return Ok(()),
+        };
+
+        let start = Instant::now();
+        let result = loop {
+            match child.try_wait() {
+                Ok(Some(_)) => break Ok(()),
+                Ok(None) if start.elapsed() < WORKER_SHUTDOWN_TIMEOUT => {
+                    std::thread::sleep(Duration::from_millis(10))
+                }
+                _ => {
+                    let _ = child.kill();
+                    break child.wait().map(|_| ());
+                }
+            }
+        };
+        let _ = std::fs::remove_file(socket_path);
+        result
+    }
+}
+
+impl Drop for SlepcWorker {
+    fn drop(&mut self) {
+        if self.process.is_some() {
+            let _ = (&self.stream).write_all(&REQUEST_SHUTDOWN.to_be_bytes());
+            let _ = self.wait_for_process();
+        }
+    }
+}
+
+/// An in-process stand-in for the external solver's worker mode, which answers requests on a Unix socket using [lanczos_solve_gep_k]
+///
+/// Clients are served one at a time (on a background thread) until one of them sends a Shutdown request (see: [SlepcWorker::shutdown]), or the `LocalWorker` is dropped.
+/// A malformed request is answered with an error status, after which its connection is closed.
+/// Dropping the `LocalWorker` disconnects the client that is currently being served (if any).
+pub struct LocalWorker {
+    socket_path: PathBuf,
+    handle: Option<JoinHandle<std::io::Result<()>>>,
+    state: Arc<ServerState>,
+}
+
+// Shared between a LocalWorker and its serving thread, so that the worker can be stopped while a client is connected
+#[derive(Default)]
+struct ServerState {
+    stopped: AtomicBool,
+    // a handle to the connection that is currently being served
+    client: Mutex<Option<UnixStream>>,
+}
+
+impl LocalWorker {
+    /// Start listening on a new socket at `socket_path`
+    pub fn bind(socket_path: impl AsRef<Path>) -> std::io::Result<Self> {
+        let socket_path = socket_path.as_ref().to_path_buf();
+        let listener = UnixListener::bind(&socket_path)?;
+        let state = Arc::new(ServerState::default());
+        let server_state = state.clone();
+        let handle = std::thread::spawn(move || serve(listener, &server_state));
+
+        Ok(Self {
+            socket_path,
+            handle: Some(handle),
+            state,
+        })
+    }
+
+    /// Location of the worker's socket
+    pub fn socket_path(&self) -> &Path {
+        &self.socket_path
+    }
+
+    /// Wait for a client to shut the worker down
+    pub fn join(mut self) -> std::io::Result<()> {
+        self.wait()
+    }
+
+    fn wait(&mut self) -> std::io::Result<()> {
+        let result = match self.handle.take() {
+            Some(handle) => handle.join().unwrap_or_else(|_| {
+                Err(std::io::Error::new(
+                    std::io::ErrorKind::Other,
+                    "LocalWorker thread panicked",
+                ))
+            }),
+            None => Ok(()),
+        };
+        let _ = std::fs::remove_file(&self.socket_path);
+        result
+    }
+}
+
+impl Drop for LocalWorker {
+    fn drop(&mut self) {
+        if self.handle.is_some() {
+            // disconnect the current client, then wake the serving thread if it is waiting for the next one
+            self.state.stopped.store(true, Ordering::SeqCst);
+            if let Some(client) = self.state.client.lock().unwrap().as_ref() {
+                let _ = client.shutdown(Shutdown::Both);
+            }
+            let _ = UnixStream::connect(&self.socket_path);
+            let _ = self.wait();
+        }
+    }
+}
+
+// Answer requests from each client in turn until a Shutdown request is received (or the LocalWorker is stopped)
+fn serve(listener: UnixListener, state: &ServerState) -> std::io::Result<()> {
+    for stream in listener.incoming() {
+        let stream = stream?;
+        {
+            // the flag is checked under the lock, so a stopping LocalWorker either sees this client or it is never served
+            let mut client = state.client.lock().unwrap();
+            if state.stopped.load(Ordering::SeqCst) {
+                return Ok(());
+            }
+            *client = Some(stream.try_clone()?);
+        }
+        let mut reader = BufReader::with_capacity(STREAM_BUFFER_SIZE, &stream);
+
+        loop {
+            let request = match read_request(&mut reader) {
+                Ok(Some(request)) => request,
+                Ok(None) => return Ok(()),
+                // the request can't be decoded, so the rest of the stream can't be trusted either; report it and drop the client
+                Err(err) if err.kind() == std::io::ErrorKind::InvalidData => {
+                    let mut writer = BufWriter::new(&stream);
+                    let _ = write_response(&mut writer, Err(2)).and_then(|_| writer.flush());
+                    break;
+                }
+                // the client disconnected; wait for the next one
+                Err(_) => break,
+            };
+
+            let response = if !request.target_eigenvalue.is_finite() {
+                Err(2)
+            } else {
+                match gep_from_aij_matrices(request.matrices) {
+                    Some(gep) => match request.initial_vector {
+                        Some(initial_vector) if initial_vector.len() != gep.dimension() => Err(2),
+                        Some(initial_vector) => lanczos_solve_gep_k_with_initial_vector(
+                            &gep,
+                            request.target_eigenvalue,
+                            request.num_pairs,
+                            &initial_vector,
+                            LanczosSettings::default(),
+                        )
+                        .map_err(|err| status_code(&err)),
+                        None => {
+                            lanczos_solve_gep_k(&gep, request.target_eigenvalue, request.num_pairs)
+                                .map_err(|err| status_code(&err))
+                        }
+                    },
+                    None => Err(3),
+                }
+            };
+
+            let mut writer = BufWriter::with_capacity(STREAM_BUFFER_SIZE, &stream);
+            if write_response(&mut writer, response)
+                .and_then(|_| writer.flush())
+                .is_err()
+            {
+                break;
+            }
+        }
+        *state.client.lock().unwrap() = None;
+    }
+    Ok(())
+}
+
+// The `solve_gep` exit code closest in meaning to a Lanczos solver error
+fn status_code(err: &LanczosGEPError) -> i32 {
+    match err {
+        LanczosGEPError::ProblemTooSmall => 2,
+        LanczosGEPError::FailedToFactor(_) => 4,
+        LanczosGEPError::FailedToConverge => 7,
+    }
+}
+
+// Read a Solve request (or None if a Shutdown request is received)
+struct SolveRequest {
+    target_eigenvalue: f64,
+    num_pairs: usize,
+    initial_vector: Option<Vec<f64>>,
+    matrices: [AIJMatrixBinary; 2],
+}
+
+fn read_request(reader: &mut impl Read) -> std::io::Result<Option<SolveRequest>> {
+    let mut request_type = [0; 4];
+    reader.read_exact(&mut request_type)?;
+    match u32::from_be_bytes(request_type) {
+        REQUEST_SHUTDOWN => Ok(None),
+        REQUEST_SOLVE => {
+            let mut header = BytesMut::new();
+            header.resize(16, 0);
+            reader.read_exact(&mut header)?;
+            let target_eigenvalue = header.get_f64();
+            let num_pairs = header.get_u32() as usize;
+            let num_initial_vectors = header.get_u32();
+
+            // only a single initial vector is used
+            let mut initial_vector = None;
+            for _ in 0..num_initial_vectors {
+                initial_vector.get_or_insert(read_petsc_vector(reader)?);
+            }
+
+            let a = AIJMatrixBinary::read_petsc_binary(reader)?;
+            let b = AIJMatrixBinary::read_petsc_binary(reader)?;
+            Ok(Some(SolveRequest {
+                target_eigenvalue,
+                num_pairs,
+                initial_vector,
+                matrices: [a, b],
+            }))
+        }
+        _ => Err(std::io::Error::new(
+            std::io::ErrorKind::InvalidData,
+            "Unknown worker request",
+        )),
+    }
+}
+
+fn write_response(
+    writer: &mut impl Write,
+    response: Result<Vec<EigenPair>, i32>,
+) -> std::io::Result<()> {
+    match response {
+        Ok(pairs) => {
+            writer.write_all(&STATUS_SUCCESS.to_be_bytes())?;
+            writer.write_all(&(pairs.len() as u32).to_be_bytes())?;
+            for pair in pairs {
+                writer.write_all(&pair.value.to_be_bytes())?;
+                write_petsc_vector(writer, &pair.vector)?;
+            }
+            Ok(())
+        }
+        Err(code) => {
+            writer.write_all(&(code as u32).to_be_bytes())?;
+            writer.write_all(&0_u32.to_be_bytes())
+        }
+    }
+}
+
+// Collect a pair of full-row PETSc matrices into a GEP over the union of their upper triangles
+//
+// None is returned if the matrices have different sizes, are inconsistent, or have non-finite entries
+fn gep_from_aij_matrices([a, b]: [AIJMatrixBinary; 2]) -> Option<GEP> {
+    if a.dim != b.dim {
+        return None;
+    }
+
+    let upper_entries = |matrix: &AIJMatrixBinary| {
+        if matrix.i.len() != matrix.dim || matrix.j.len() != matrix.a.len() {
+            return None;
+        }
+        let mut entries = Vec::new();
+        let mut idx = 0;
+        for (r, count) in matrix.i.iter().enumerate() {
+            for _ in 0..usize::try_from(*count).ok()? {
+                let c = usize::try_from(*matrix.j.get(idx)?).ok()?;
+                let value = matrix.a[idx];
+                if c >= matrix.dim || !value.is_finite() {
+                    return None;
+                }
+                if c >= r {
+                    entries.push(([r, c], value));
+                }
+                idx += 1;
+            }
+        }
+        (idx == matrix.j.len()).then(|| entries)
+    };
+    let [a_entries, b_entries] = [upper_entries(&a)?, upper_entries(&b)?];
+
+    let pattern = SparsityPattern::from_coordinates(
+        a.dim,
+        a_entries
+            .iter()
+            .chain(b_entries.iter())
+            .map(|(coordinates, _)| *coordinates),
+    );
+    let mut gep = GEP::new(pattern);
+    gep.a.insert_group(&a_entries);
+    gep.b.insert_group(&b_entries);
+    Some(gep)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use crate::fem_domain::basis::hierarchical_basis_fns::poly::HierPoly;
+    use crate::fem_domain::domain::{
+        mesh::{p_refinement::PRef, Mesh},
+        ContinuityCondition, Domain,
+    };
+    use crate::fem_problem::galerkin::galerkin_sample_gep_hcurl;
+    use crate::fem_problem::integration::integrals::{curl_curl::CurlCurl, inner::L2Inner};
+
+    #[test]
+    fn local_worker_round_trip() {
+        let mut mesh = Mesh::from_file("./test_input/test_mesh_a.json").unwrap();
+        mesh.global_p_refinement(PRef::from(2, 2));
+        let domain = Domain::from_mesh(mesh, ContinuityCondition::HCurl);
+        let gep = galerkin_sample_gep_hcurl::<HierPoly, CurlCurl, L2Inner>(&domain, Some([8, 8]))
+            .unwrap();
+
+        let socket_path =
+            std::env::temp_dir().join(format!("fem_2d_worker_{}.sock", std::process::id()));
+        let _ = std::fs::remove_file(&socket_path);
+        let local_worker = LocalWorker::bind(&socket_path).unwrap();
+
+        {
+            let mut worker = SlepcWorker::connect(local_worker.socket_path()).unwrap();
+
+            // several problems over the same connection
+            let solution = worker.solve(gep.clone(), 2.64).unwrap();
+            assert!((solution.value - 3.618045946).abs() < 1e-8);
+            assert!(solution.residual_norm(&gep) < 1e-8);
+
+            let solutions = worker.solve_k(gep.clone(), 2.64, 2).unwrap();
+            assert_eq!(solutions.len(), 2);
+            assert!((solutions[1].value - 1.307666065).abs() < 1e-8);
+
+            let warm_solutions = worker
+                .solve_k_with_initial_vector(gep.clone(), 2.64, 1, &solution.vector)
+                .unwrap();
+            assert!((warm_solutions[0].value - solution.value).abs() < 1e-8);
+        }
+
+        // dropping a connected handle leaves the worker running for the next client
+        let mut worker = SlepcWorker::connect(local_worker.socket_path()).unwrap();
+        let solution = worker.solve(gep.clone(), 2.64).unwrap();
+        assert!((solution.value - 3.618045946).abs() < 1e-8);
+        worker.shutdown().unwrap();
+
+        local_worker.join().unwrap();
+        assert!(!socket_path.exists());
+    }
+
+    #[test]
+    fn read_response_rejects_mismatched_solutions() {
+        let response = |pairs: Vec<EigenPair>| {
+            let mut bytes = Vec::new();
+            write_response(&mut bytes, Ok(pairs)).unwrap();
+            bytes
+        };
+        let pair = |dim: usize| EigenPair {
+            value: 1.0,
+            vector: vec![1.0; dim],
+        };
+
+        let valid = response(vec![pair(3), pair(3)]);
+        assert_eq!(read_response(&mut valid.as_slice(), 3, 2).unwrap().len(), 2);
+
+        // too many pairs
+        let is_invalid_data = |result: Result<Vec<EigenPair>, Box<dyn std::error::Error>>| {
+            result.err().map_or(false, |err| {
+                err.downcast_ref::<std::io::Error>()
+                    .map_or(false, |err| err.kind() == std::io::ErrorKind::InvalidData)
+            })
+        };
+        assert!(is_invalid_data(read_response(&mut valid.as_slice(), 3, 1)));
+
+        // a vector of the wrong length
+        let short = response(vec![pair(3), pair(2)]);
+        assert!(is_invalid_data(read_response(&mut short.as_slice(), 3, 2)));
+    }
+
+    #[test]
+    fn nearest_pairs_rejects_nan() {
+        let pair = |value: f64| EigenPair {
+            value,
+            vector: vec![1.0],
+        };
+
+        let pairs = nearest_pairs(vec![pair(3.0), pair(1.5), pair(-2.0)], 1.0, 2).unwrap();
+        assert_eq!(pairs.len(), 2);
+        assert_eq!(pairs[0].value, 1.5);
+        assert_eq!(pairs[1].value, 3.0);
+
+        assert!(matches!(
+            nearest_pairs(vec![pair(1.5), pair(f64::NAN)], 1.0, 1),
+            Err(SlepcGEPError::FailedToReturnSolution)
+        ));
+    }
+
+    #[test]
+    fn drop_local_worker_with_connected_client() {
+        let socket_path = std::env::temp_dir().join(format!(
+            "fem_2d_worker_connected_{}.sock",
+            std::process::id()
+        ));
+        let _ = std::fs::remove_file(&socket_path);
+        let local_worker = LocalWorker::bind(&socket_path).unwrap();
+        let mut worker = SlepcWorker::connect(local_worker.socket_path()).unwrap();
+
+        let (done_sender, done_receiver) = std::sync::mpsc::channel();
+        std::thread::spawn(move || {
+            drop(local_worker);
+            done_sender.send(()).unwrap();
+        });
+        assert!(
+            done_receiver.recv_timeout(Duration::from_secs(10)).is_ok(),
+            "LocalWorker did not stop while a client was connected!"
+        );
+        assert!(!socket_path.exists());
+
+        // the client's connection was closed
+        let gep = GEP::new(SparsityPattern::from_coordinates(
+            2,
+            [[0, 0], [1, 1]].into_iter(),
+        ));
+        assert!(worker.solve(gep, 1.0).is_err());
+    }
+
+    #[test]
+    fn local_worker_rejects_malformed_requests() {
+        let socket_path = std::env::temp_dir().join(format!(
+            "fem_2d_worker_malformed_{}.sock",
+            std::process::id()
+        ));
+        let _ = std::fs::remove_file(&socket_path);
+        let local_worker = LocalWorker::bind(&socket_path).unwrap();
+
+        let solve_header = |num_initial_vectors: u32| {
+            let mut bytes = Vec::new();
+            bytes.extend_from_slice(&REQUEST_SOLVE.to_be_bytes());
+            bytes.extend_from_slice(&1.0_f64.to_be_bytes());
+            bytes.extend_from_slice(&1_u32.to_be_bytes());
+            bytes.extend_from_slice(&num_initial_vectors.to_be_bytes());
+            bytes
+        };
+        let matrix_header = |dim: i32, nnz: i32| {
+            let mut bytes = Vec::new();
+            for field in [1211216, dim, dim, nnz] {
+                bytes.extend_from_slice(&field.to_be_bytes());
+            }
+            bytes
+        };
+        let be_bytes =
+            |values: &[i32]| -> Vec<u8> { values.iter().flat_map(|v| v.to_be_bytes()).collect() };
+
+        // wrong vector class-id
+        let mut bad_vector = solve_header(1);
+        bad_vector.extend(be_bytes(&[1234, 1]));
+        // negative vector length
+        let mut negative_vector = solve_header(1);
+        negative_vector.extend(be_bytes(&[1211214, -1]));
+        // negative matrix size
+        let mut negative_matrix = solve_header(0);
+        negative_matrix.extend(matrix_header(-4, 0));
+        // row counts that don't sum to the number of non-zeros
+        let mut bad_row_counts = solve_header(0);
+        bad_row_counts.extend(matrix_header(2, 1));
+        bad_row_counts.extend(be_bytes(&[1, 1]));
+        // column index outside the matrix
+        let mut bad_column = solve_header(0);
+        bad_column.extend(matrix_header(2, 2));
+        bad_column.extend(be_bytes(&[1, 1, 0, 7]));
+        bad_column.extend([1.0_f64, 1.0].iter().flat_map(|v| v.to_be_bytes()));
+
+        for request in [
+            bad_vector,
+            negative_vector,
+            negative_matrix,
+            bad_row_counts,
+            bad_column,
+        ] {
+            let mut stream = UnixStream::connect(local_worker.socket_path()).unwrap();
+            stream.write_all(&request).unwrap();
+            let mut status = [0; 4];
+            stream.read_exact(&mut status).unwrap();
+            assert_ne!(u32::from_be_bytes(status), STATUS_SUCCESS);
+        }
+
+        // the worker is still serving
+        let worker = SlepcWorker::connect(local_worker.socket_path()).unwrap();
+        worker.shutdown().unwrap();
+        local_worker.join().unwrap();
+    }
+}
@@ -1,13 +1,14 @@
 use std::collections::BTreeMap;
 use std::fs::File;
-use std::io::{BufWriter, Write};
+use std::io::{Read, Write};
 
 use bytes::{BufMut, BytesMut};
 use nalgebra::DMatrix;
-
-//TODO: switch to something more efficient than a BTreeMap (preallocate with know num zeros)
+use rayon::prelude::*;
 
 /// Wrapper around a BTreeMap to store square-symmetric matrices in a sparse data structure
+///
+/// This structure can grow to accommodate any entry. When the locations of the entries are known ahead of time, a [CsrMatrix](super::csr_matrix::CsrMatrix) should be used instead
 #[derive(Clone)]
 pub struct SparseMatrix {
     /// Size of the square matrix
@@ -126,42 +127,10 @@ impl SparseMatrix {
             .map(|(coords, value)| ([coords[0] as usize, coords[1] as usize], *value))
     }
 
+    /// Write the matrix to a file in PETSc's binary AIJ format (see: [AIJMatrixBinary::print_to_petsc_binary_file])
     pub fn write_to_petsc_binary_format(&self, path: impl AsRef<str>) -> std::io::Result<()> {
-        let file = File::create(path.as_ref())?;
-        let mut writer = BufWriter::new(file);
-
-        let mut full_sparse: BTreeMap<[u32; 2], f64> = self
-            .entries
-            .iter()
-            .map(|([r, c], v)| ([*c, *r], *v))
-            .collect();
-        full_sparse.append(&mut self.entries.clone());
-
-        let nnz = full_sparse.len();
-        let mut i = Vec::with_capacity(nnz);
-        let mut j = Vec::with_capacity(nnz);
-        let mut v = Vec::with_capacity(nnz);
-
-        for ([r, c], value) in full_sparse {
-            i.push(r);
-            j.push(c);
-            v.push(value);
-        }
-        let nnz = v.len();
-
-        // Write the header
-        writer.write_all(
-            format!("1211216 {} {} {}\n", self.dimension, self.dimension, nnz).as_bytes(),
-        )?;
-        let mut row_nnz = vec![0; self.dimension];
-        for (coordinates, _) in self.iter_upper_tri() {
-            row_nnz[coordinates[0]] += 1;
-        }
-        for rnz in row_nnz.iter() {
-            writer.write_all(format!("{} ", rnz).as_bytes())?;
-        }
-
-        Ok(())
+        AIJMatrixBinary::from_upper_tri(self.dimension, || self.iter_upper_tri())
+            .print_to_petsc_binary_file(path)
     }
 }
 
@@ -182,86 +151,372 @@ impl From<SparseMatrix> for DMatrix<f64> {
 }
 
 impl From<SparseMatrix> for AIJMatrixBinary {
-    fn from(mut sm: SparseMatrix) -> Self {
-        // number of entries in each row
-        let mut row_counts = vec![0; sm.dimension];
+    fn from(sm: SparseMatrix) -> Self {
+        AIJMatrixBinary::from_upper_tri(sm.dimension, || sm.iter_upper_tri())
+    }
+}
 
-        for [r, c] in sm.entries.keys() {
-            if r == c {
-                row_counts[*r as usize] += 1;
-            } else {
-                row_counts[*r as usize] += 1;
-                row_counts[*c as usize] += 1;
+/// Petsc/Slepc Sparse Matrix Format
+pub struct AIJMatrixBinary {
+    pub a: Vec<f64>,
+    pub i: Vec<i32>, // Number of entries on each row (compute a prefix sum to get canonical form)
+    pub j: Vec<i32>,
+    pub dim: usize,
+}
+
+impl AIJMatrixBinary {
+    /// Expand the upper triangle of a square-symmetric matrix into full-row form
+    ///
+    /// `upper_tri` must produce an iterator over the upper triangle's entries sorted by row, then by column (as [SparseMatrix::iter_upper_tri] does).
+    /// It is traversed twice: once to count the entries on each row, and once to place each entry (and its transpose) directly into the preallocated output arrays.
+    pub fn from_upper_tri<I, F>(dim: usize, upper_tri: F) -> Self
+    where
+        F: Fn() -> I,
+        I: Iterator<Item = ([usize; 2], f64)>,
+    {
+        // number of entries in each row
+        let mut row_counts = vec![0; dim];
+        for ([r, c], _) in upper_tri() {
+            row_counts[r] += 1;
+            if r != c {
+                row_counts[c] += 1;
             }
         }
 
-        // upper and lower triangles of matrix; sorted by row then column
-        let mut full_matrix: BTreeMap<[u32; 2], f64> = sm
-            .entries
-            .iter()
-            .map(|([r, c], v)| ([*c, *r], *v))
-            .collect();
-        full_matrix.append(&mut sm.entries);
+        // position of the next entry on each row
+        let mut next_entry = Vec::with_capacity(dim);
+        let mut nnz = 0;
+        for &count in row_counts.iter() {
+            next_entry.push(nnz);
+            nnz += count as usize;
+        }
 
-        // matrix entries and their associated columns
-        let (j, a) = full_matrix
-            .iter()
-            .map(|([_, c], v)| (*c as i32, *v))
-            .unzip();
+        // entries from lower triangle of each row are all placed before those from the upper triangle,
+        // such that each row remains sorted by column
+        let mut a = vec![0.0; nnz];
+        let mut j = vec![0; nnz];
+        for ([r, c], v) in upper_tri() {
+            a[next_entry[r]] = v;
+            j[next_entry[r]] = c as i32;
+            next_entry[r] += 1;
+
+            if r != c {
+                a[next_entry[c]] = v;
+                j[next_entry[c]] = r as i32;
+                next_entry[c] += 1;
+            }
+        }
 
         AIJMatrixBinary {
             a,
             i: row_counts,
             j,
-            dim: sm.dimension,
+            dim,
         }
     }
-}
 
-/// Petsc/Slepc Sparse Matrix Format
-pub struct AIJMatrixBinary {
-    pub a: Vec<f64>,
-    pub i: Vec<i32>, // Number of entries on each row (compute a prefix sum to get canonical form)
-    pub j: Vec<i32>,
-    pub dim: usize,
-}
+    /// Read a matrix from a file in PETSc's binary AIJ format (as written by [AIJMatrixBinary::print_to_petsc_binary_file])
+    pub fn read_from_petsc_binary_file(path: impl AsRef<std::path::Path>) -> std::io::Result<Self> {
+        let file = File::open(path.as_ref())?;
+        let invalid =
+            |msg: &str| std::io::Error::new(std::io::ErrorKind::InvalidData, msg.to_string());
+
+        let mut header = [0; PETSC_HEADER_SIZE as usize];
+        read_exact_at(&file, &mut header, 0)?;
+        let header_field =
+            |idx: usize| u32::from_be_bytes(header[4 * idx..4 * (idx + 1)].try_into().unwrap());
+        if header_field(0) != PETSC_MAT_FILE_CLASSID || header_field(1) != header_field(2) {
+            return Err(invalid("Not a square PETSc binary matrix file"));
+        }
+        let dim = header_field(1) as usize;
+        let nnz = header_field(3) as usize;
+
+        let i_offset = PETSC_HEADER_SIZE;
+        let j_offset = i_offset + 4 * dim as u64;
+        let a_offset = j_offset + 4 * nnz as u64;
+        if file.metadata()?.len() != a_offset + 8 * nnz as u64 {
+            return Err(invalid("PETSc binary matrix file has the wrong length"));
+        }
 
-impl AIJMatrixBinary {
+        let mut i = vec![0; dim];
+        let mut j = vec![0; nnz];
+        let mut a = vec![0.0; nnz];
+        read_section(&file, &mut i, i_offset, 4, |b| {
+            i32::from_be_bytes(b.try_into().unwrap())
+        })?;
+        read_section(&file, &mut j, j_offset, 4, |b| {
+            i32::from_be_bytes(b.try_into().unwrap())
+        })?;
+        read_section(&file, &mut a, a_offset, 8, |b| {
+            f64::from_be_bytes(b.try_into().unwrap())
+        })?;
+
+        Ok(Self { a, i, j, dim })
+    }
+
+    /// Write the matrix to a file in PETSc's binary AIJ format
+    ///
+    /// The byte offset of each section (header, row counts, column indices, and values) is known ahead of time, so the file is allocated up front.
+    /// Each section is then encoded in parallel chunks, which are written directly into their regions of the file.
     pub fn print_to_petsc_binary_file(&self, path: impl AsRef<str>) -> std::io::Result<()> {
+        let nnz = self.a.len();
+        let header = petsc_matrix_header(self.dim, nnz)?;
         let file = File::create(path.as_ref())?;
-        let mut writer = BufWriter::new(file);
+
+        let i_offset = PETSC_HEADER_SIZE;
+        let j_offset = i_offset + 4 * self.i.len() as u64;
+        let a_offset = j_offset + 4 * nnz as u64;
+        file.set_len(a_offset + 8 * nnz as u64)?;
 
         // header
-        let mut header_buf = BytesMut::with_capacity(32);
-        header_buf.put(&b"\0{P"[..]);
-        header_buf.put_u32(self.dim as u32);
-        header_buf.put_u32(self.dim as u32);
-        header_buf.put_u32(self.a.len() as u32);
-        writer.write_all(header_buf.as_ref())?;
+        write_all_at(&file, header.as_ref(), 0)?;
 
         // num-non-zero entries on each row
-        let mut rnnz_buf = BytesMut::with_capacity(self.i.len() * 4);
-        for &rnz in self.i.iter() {
-            rnnz_buf.put_u32(rnz as u32);
-        }
-        writer.write_all(rnnz_buf.as_ref())?;
+        write_section(&file, &self.i, i_offset, 4, |buf, rnz| {
+            buf.put_u32(*rnz as u32)
+        })?;
 
         // column indices of non-zero entries
-        let mut j_buf = BytesMut::with_capacity(self.j.len() * 4);
-        for &j in self.j.iter() {
-            j_buf.put_u32(j as u32);
-        }
-        writer.write_all(j_buf.as_ref())?;
+        write_section(&file, &self.j, j_offset, 4, |buf, j| buf.put_u32(*j as u32))?;
 
         // non-zero entries
-        let mut a_buf = BytesMut::with_capacity(self.a.len() * 8);
-        for &a in self.a.iter() {
-            a_buf.put_f64(a);
-        }
-        writer.write_all(a_buf.as_ref())?;
+        write_section(&file, &self.a, a_offset, 8, |buf, a| buf.put_f64(*a))?;
 
         Ok(())
     }
+
+    /// Write the matrix to a stream (e.g. a socket or pipe) in PETSc's binary AIJ format
+    ///
+    /// The format is self-delimiting, so several matrices can be written to the same stream back to back
+    pub fn write_petsc_binary(&self, writer: &mut impl Write) -> std::io::Result<()> {
+        writer.write_all(petsc_matrix_header(self.dim, self.a.len())?.as_ref())?;
+        write_stream_section(writer, &self.i, 4, |buf, rnz| buf.put_u32(*rnz as u32))?;
+        write_stream_section(writer, &self.j, 4, |buf, j| buf.put_u32(*j as u32))?;
+        write_stream_section(writer, &self.a, 8, |buf, a| buf.put_f64(*a))
+    }
+
+    /// Read a single matrix in PETSc's binary AIJ format from a stream (as written by [AIJMatrixBinary::write_petsc_binary])
+    ///
+    /// The stream is not trusted: an `InvalidData` error is returned if the header, row counts, or column indices do not describe a valid square matrix
+    pub fn read_petsc_binary(reader: &mut impl Read) -> std::io::Result<Self> {
+        let mut header = [0; PETSC_HEADER_SIZE as usize];
+        reader.read_exact(&mut header)?;
+        let header_field =
+            |idx: usize| i32::from_be_bytes(header[4 * idx..4 * (idx + 1)].try_into().unwrap());
+        if header_field(0) as u32 != PETSC_MAT_FILE_CLASSID || header_field(1) != header_field(2) {
+            return Err(invalid_data("Not a square PETSc binary matrix"));
+        }
+        let [dim, nnz] = [header_field(1), header_field(3)];
+        if dim < 0 || nnz < 0 {
+            return Err(invalid_data("Negative PETSc binary matrix size"));
+        }
+        let [dim, nnz] = [dim as usize, nnz as usize];
+
+        let i = read_stream_section(reader, dim, 4, |b| {
+            i32::from_be_bytes(b.try_into().unwrap())
+        })?;
+        if i.iter().any(|rnz| *rnz < 0) || i.iter().map(|rnz| *rnz as usize).sum::<usize>() != nnz {
+            return Err(invalid_data(
+                "PETSc binary matrix row counts do not sum to the number of non-zeros",
+            ));
+        }
+
+        let j = read_stream_section(reader, nnz, 4, |b| {
+            i32::from_be_bytes(b.try_into().unwrap())
+        })?;
+        if j.iter().any(|c| *c < 0 || *c as usize >= dim) {
+            return Err(invalid_data(
+                "PETSc binary matrix column index out of range",
+            ));
+        }
+
+        let a = read_stream_section(reader, nnz, 8, |b| {
+            f64::from_be_bytes(b.try_into().unwrap())
+        })?;
+
+        Ok(Self { a, i, j, dim })
+    }
+}
+
+/// Size of a PETSc binary matrix header in bytes: class-id, number of rows, number of columns, and number of non-zeros
+pub(crate) const PETSC_HEADER_SIZE: u64 = 16;
+
+/// PETSc's class-id for binary matrix files
+const PETSC_MAT_FILE_CLASSID: u32 = 1211216;
+
+// Encode the header of a PETSc binary matrix file
+//
+// PETSc stores the dimension and number of non-zeros as 32-bit signed integers, so larger matrices can't be represented
+pub(crate) fn petsc_matrix_header(dim: usize, nnz: usize) -> std::io::Result<BytesMut> {
+    if dim > i32::MAX as usize || nnz > i32::MAX as usize {
+        return Err(std::io::Error::new(
+            std::io::ErrorKind::InvalidInput,
+            format!(
+                "Matrix with dimension {} and {} non-zeros exceeds PETSc's 32-bit index limit",
+                dim, nnz
+            ),
+        ));
+    }
+
+    let mut header_buf = BytesMut::with_capacity(PETSC_HEADER_SIZE as usize);
+    header_buf.put_u32(PETSC_MAT_FILE_CLASSID);
+    header_buf.put_u32(dim as u32);
+    header_buf.put_u32(dim as u32);
+    header_buf.put_u32(nnz as u32);
+    Ok(header_buf)
+}
+
+/// Number of values encoded or decoded by each task when binary files are written or read in parallel (e.g. [AIJMatrixBinary::print_to_petsc_binary_file])
+const PETSC_WRITE_CHUNK_SIZE: usize = 1 << 16;
+
+// Encode a section of a binary file in parallel chunks, writing each chunk to its position in the file
+pub(crate) fn write_section<T: Sync>(
+    file: &File,
+    values: &[T],
+    section_offset: u64,
+    value_size: usize,
+    encode: impl Fn(&mut BytesMut, &T) + Sync + Send,
+) -> std::io::Result<()> {
+    values
+        .par_chunks(PETSC_WRITE_CHUNK_SIZE)
+        .enumerate()
+        .try_for_each(|(chunk_idx, chunk)| {
+            let mut buf = BytesMut::with_capacity(chunk.len() * value_size);
+            for value in chunk {
+                encode(&mut buf, value);
+            }
+
+            let chunk_offset = (chunk_idx * PETSC_WRITE_CHUNK_SIZE * value_size) as u64;
+            write_all_at(file, buf.as_ref(), section_offset + chunk_offset)
+        })
+}
+
+// Decode a section of a binary file into `values` in parallel chunks, reading each chunk from its position in the file
+pub(crate) fn read_section<T: Send>(
+    file: &File,
+    values: &mut [T],
+    section_offset: u64,
+    value_size: usize,
+    decode: impl Fn(&[u8]) -> T + Sync + Send,
+) -> std::io::Result<()> {
+    values
+        .par_chunks_mut(PETSC_WRITE_CHUNK_SIZE)
+        .enumerate()
+        .try_for_each(|(chunk_idx, chunk)| {
+            let mut buf = vec![0; chunk.len() * value_size];
+            let chunk_offset = (chunk_idx * PETSC_WRITE_CHUNK_SIZE * value_size) as u64;
+            read_exact_at(file, &mut buf, section_offset + chunk_offset)?;
+
+            for (value, bytes) in chunk.iter_mut().zip(buf.chunks_exact(value_size)) {
+                *value = decode(bytes);
+            }
+            Ok(())
+        })
+}
+
+// Encode a section of a binary stream one chunk at a time
+fn write_stream_section<T>(
+    writer: &mut impl Write,
+    values: &[T],
+    value_size: usize,
+    encode: impl Fn(&mut BytesMut, &T),
+) -> std::io::Result<()> {
+    let mut buf = BytesMut::with_capacity(PETSC_WRITE_CHUNK_SIZE * value_size);
+    for chunk in values.chunks(PETSC_WRITE_CHUNK_SIZE) {
+        buf.clear();
+        for value in chunk {
+            encode(&mut buf, value);
+        }
+        writer.write_all(buf.as_ref())?;
+    }
+    Ok(())
+}
+
+// Decode `len` values from a section of a binary stream one chunk at a time
+//
+// The length usually comes from an untrusted header, so an `InvalidData` error is returned if the values can't be allocated,
+// and the memory is only filled in as values actually arrive (such that a truncated stream fails with `UnexpectedEof`)
+pub(crate) fn read_stream_section<T>(
+    reader: &mut impl Read,
+    len: usize,
+    value_size: usize,
+    decode: impl Fn(&[u8]) -> T,
+) -> std::io::Result<Vec<T>> {
+    let mut values = Vec::new();
+    values
+        .try_reserve_exact(len)
+        .map_err(|_| invalid_data("Binary section is too large to fit in memory"))?;
+
+    let mut buf = vec![0; PETSC_WRITE_CHUNK_SIZE.min(len) * value_size];
+    let mut remaining = len;
+    while remaining > 0 {
+        let chunk_len = remaining.min(PETSC_WRITE_CHUNK_SIZE);
+        let buf = &mut buf[..chunk_len * value_size];
+        reader.read_exact(buf)?;
+        values.extend(buf.chunks_exact(value_size).map(&decode));
+        remaining -= chunk_len;
+    }
+    Ok(values)
+}
+
+pub(crate) fn invalid_data(msg: &str) -> std::io::Error {
+    std::io::Error::new(std::io::ErrorKind::InvalidData, msg)
+}
+
+#[cfg(unix)]
+pub(crate) fn write_all_at(file: &File, buf: &[u8], offset: u64) -> std::io::Result<()> {
+    use std::os::unix::fs::FileExt;
+    file.write_all_at(buf, offset)
+}
+
+#[cfg(windows)]
+pub(crate) fn write_all_at(file: &File, mut buf: &[u8], mut offset: u64) -> std::io::Result<()> {
+    use std::os::windows::fs::FileExt;
+    while !buf.is_empty() {
+        match file.seek_write(buf, offset)? {
+            0 => {
+                return Err(std::io::Error::new(
+                    std::io::ErrorKind::WriteZero,
+                    "failed to write whole buffer",
+                ))
+            }
+            n => {
+                buf = &buf[n..];
+                offset += n as u64;
+            }
+        }
+    }
+    Ok(())
+}
+
+#[cfg(unix)]
+pub(crate) fn read_exact_at(file: &File, buf: &mut [u8], offset: u64) -> std::io::Result<()> {
+    use std::os::unix::fs::FileExt;
+    file.read_exact_at(buf, offset)
+}
+
+#[cfg(windows)]
+pub(crate) fn read_exact_at(
+    file: &File,
+    mut buf: &mut [u8],
+    mut offset: u64,
+) -> std::io::Result<()> {
+    use std::os::windows::fs::FileExt;
+    while !buf.is_empty() {
+        match file.seek_read(buf, offset)? {
+            0 => {
+                return Err(std::io::Error::new(
+                    std::io::ErrorKind::UnexpectedEof,
+                    "failed to fill whole buffer",
+                ))
+            }
+            n => {
+                buf = &mut buf[n..];
+                offset += n as u64;
+            }
+        }
+    }
+    Ok(())
 }
 
 #[cfg(test)]
@@ -286,6 +541,76 @@ mod tests {
             .unwrap();
     }
 
+    #[test]
+    fn chunked_petsc_binary_file() {
+        let dim = PETSC_WRITE_CHUNK_SIZE + 100;
+        let mut sm = SparseMatrix::new(dim);
+        for i in 0..dim {
+            sm.insert([i, i], i as f64);
+        }
+        sm.insert([0, dim - 1], 0.5);
+
+        sm.write_to_petsc_binary_format("./test_output/test_chunked.bin")
+            .unwrap();
+
+        let bytes = std::fs::read("./test_output/test_chunked.bin").unwrap();
+        let nnz = dim + 2;
+        assert_eq!(bytes.len(), 16 + 4 * dim + 4 * nnz + 8 * nnz);
+
+        let read_u32 =
+            |offset: usize| u32::from_be_bytes(bytes[offset..offset + 4].try_into().unwrap());
+        let read_f64 =
+            |offset: usize| f64::from_be_bytes(bytes[offset..offset + 8].try_into().unwrap());
+
+        assert_eq!(read_u32(0), 1211216);
+        assert_eq!(read_u32(12) as usize, nnz);
+
+        // row counts, column indices and values on either side of a chunk boundary
+        let [i_offset, j_offset] = [16, 16 + 4 * dim];
+        let a_offset = j_offset + 4 * nnz;
+        for row in [PETSC_WRITE_CHUNK_SIZE - 1, PETSC_WRITE_CHUNK_SIZE] {
+            // the first row has one extra entry
+            let entry = row + 1;
+            assert_eq!(read_u32(i_offset + 4 * row), 1);
+            assert_eq!(read_u32(j_offset + 4 * entry) as usize, row);
+            assert_eq!(read_f64(a_offset + 8 * entry), row as f64);
+        }
+        assert_eq!(read_f64(a_offset + 8 * (nnz - 2)), 0.5);
+    }
+
+    #[test]
+    fn oversized_petsc_header() {
+        let limit = i32::MAX as usize;
+        assert!(petsc_matrix_header(limit, limit).is_ok());
+        for [dim, nnz] in [[10, limit + 1], [limit + 1, 10]] {
+            assert_eq!(
+                petsc_matrix_header(dim, nnz).unwrap_err().kind(),
+                std::io::ErrorKind::InvalidInput
+            );
+        }
+    }
+
+    #[test]
+    fn aij_conversion() {
+        let mut sm = SparseMatrix::new(5);
+
+        sm.insert([0, 0], 1.0);
+        sm.insert([3, 0], 0.5);
+        sm.insert([1, 1], 2.0);
+        sm.insert([4, 1], 0.25);
+        sm.insert([1, 3], 0.75);
+        sm.insert([4, 4], 3.0);
+
+        let sm_bin: AIJMatrixBinary = sm.into();
+
+        assert_eq!(sm_bin.i, vec![2, 3, 0, 2, 2]);
+        assert_eq!(sm_bin.j, vec![0, 3, 1, 3, 4, 0, 1, 1, 4]);
+        assert_eq!(
+            sm_bin.a,
+            vec![1.0, 0.5, 2.0, 0.75, 0.25, 0.5, 0.75, 0.25, 3.0]
+        );
+    }
+
     #[test]
     fn value_insertion() {
         let mut sm = SparseMatrix::new(10);
@@ -27,13 +27,45 @@ pub mod prelude {
             p_refinement::{PRef, PRefError},
             Mesh,
         },
+        renumbering::{DoFOrdering, DoFPermutation},
         ContinuityCondition, Domain,
     };
-    pub use crate::fem_problem::galerkin::{galerkin_sample_gep_hcurl, GalerkinSamplingError};
+    pub use crate::fem_problem::galerkin::{
+        assembly_plan::AssemblyPlan,
+        galerkin_sample_gep_hcurl, galerkin_sample_gep_hcurl_coo, galerkin_sample_gep_hcurl_pruned,
+        galerkin_sample_gep_hcurl_with_plan,
+        gep_cache::{GEPCache, GEPCacheError, GEPCacheKey},
+        matrix_free::MatrixFreeGEP,
+        out_of_core::{galerkin_sample_gep_hcurl_out_of_core, OutOfCoreGEP, OutOfCoreSettings},
+        prolongation::{
+            prolong_eigenvector, prolong_eigenvector_with_factorization, ProlongationError,
+        },
+        AssemblyMode, GalerkinSamplingError,
+    };
     pub use crate::fem_problem::integration::integrals::{curl_curl::CurlCurl, inner::L2Inner};
+    #[cfg(unix)]
+    pub use crate::fem_problem::linalg::slepc_solve::worker::{LocalWorker, SlepcWorker};
     pub use crate::fem_problem::linalg::{
-        nalgebra_solve::{nalgebra_solve_gep, NalgebraGEPError},
-        slepc_solve::{slepc_solve_gep, SlepcGEPError},
+        bsr_matrix::{BlockPartition, BsrGEP},
+        coo_matrix::{DropReport, DropTolerance},
+        lanczos_solve::{
+            lanczos_solve_gep, lanczos_solve_gep_k, lanczos_solve_gep_k_with_initial_vector,
+            lanczos_solve_gep_k_with_settings, lanczos_solve_gep_k_with_stats,
+            lanczos_solve_gep_with_settings, LanczosGEPError, LanczosSettings, LanczosStats,
+            ShiftFactorization,
+        },
+        lobpcg_solve::{
+            lobpcg_solve_gep, lobpcg_solve_gep_near_target, lobpcg_solve_gep_with_initial_vectors,
+            LobpcgGEPError, LobpcgSettings,
+        },
+        multifrontal::{MultifrontalLDL, SymbolicLDL},
+        nalgebra_solve::{nalgebra_solve_gep, nalgebra_solve_gep_k, NalgebraGEPError},
+        operator::{GEPOperator, LinearOperator},
+        preconditioner::{BlockJacobi, IdentityPreconditioner, Preconditioner},
+        slepc_solve::{
+            slepc_solve_gep, slepc_solve_gep_k, slepc_solve_gep_k_with_initial_vector,
+            slepc_solve_gep_k_with_transport, SlepcGEPError, SlepcTransport,
+        },
         EigenPair, GEP,
     };
 }
@@ -62,7 +94,7 @@ mod tests {
         let solution = nalgebra_solve_gep(eigenproblem, 2.64).unwrap();
         println!("Found eigenvalue: {:.15}", solution.value);
 
-        assert!((solution.value - 2.6479657_f64).abs() < 1e-6);
+        assert!((solution.value - 3.618045946_f64).abs() < 1e-6);
         assert_eq!(solution.vector.len(), ndofs);
 
         let mut field_space = UniformFieldSpace::new(&domain, [8, 8]);